@@ -35,6 +35,7 @@ static void IRAM_ATTR gpio_isr_handler(void* arg);
 static gpio_num_t * btnGpios;
 static xQueueHandle gpio_evt_queue = NULL;
 static uint32_t buttonStates = 0;
+static TaskHandle_t notifyTask = NULL;
 
 //==============================================================================
 // Functions
@@ -122,8 +123,28 @@ static void IRAM_ATTR gpio_isr_handler(void* arg)
         gpio_evt |= GPIO_HIGH_BIT;
     }
 
-    // Queue up this event
+    // Queue up this event, and wake the task waiting for it
+    BaseType_t task_awoken = pdFALSE;
     xQueueSendFromISR(gpio_evt_queue, &gpio_evt, NULL);
+    if(NULL != notifyTask)
+    {
+        vTaskNotifyGiveFromISR(notifyTask, &task_awoken);
+    }
+    if(pdTRUE == task_awoken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+/**
+ * @brief Set a task to notify whenever a button event is queued, so it can
+ * block instead of polling checkButtonQueue()
+ *
+ * @param task The task to notify, or NULL to stop notifying
+ */
+void setButtonNotifyTask(TaskHandle_t task)
+{
+    notifyTask = task;
 }
 
 /**
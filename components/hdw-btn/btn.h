@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
 typedef enum
 {
     UP     = 0x01,
@@ -26,5 +29,6 @@ typedef struct
 void initButtons(uint8_t numButtons, ...);
 void deinitButtons(void);
 bool checkButtonQueue(buttonEvt_t*);
+void setButtonNotifyTask(TaskHandle_t task);
 
 #endif
\ No newline at end of file
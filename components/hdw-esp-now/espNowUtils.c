@@ -37,6 +37,7 @@ hostEspNowRecvCb_t hostEspNowRecvCb = NULL;
 hostEspNowSendCb_t hostEspNowSendCb = NULL;
 
 static xQueueHandle esp_now_queue = NULL;
+static TaskHandle_t notifyTask = NULL;
 
 //==============================================================================
 // Prototypes
@@ -240,18 +241,33 @@ void espNowRecvCb(const uint8_t* mac_addr, const uint8_t* data, int data_len)
     // Copy the RSSI
     packet.rssi = pkt->rssi;
 
-    // Queue this packet
+    // Queue this packet, and wake the task waiting for it
     xQueueSendFromISR(esp_now_queue, &packet, NULL);
+    if(NULL != notifyTask)
+    {
+        xTaskNotifyGive(notifyTask);
+    }
+}
+
+/**
+ * @brief Set a task to notify whenever a packet is received, so it can block
+ * instead of polling checkEspNowRxQueue()
+ *
+ * @param task The task to notify, or NULL to stop notifying
+ */
+void setEspNowNotifyTask(TaskHandle_t task)
+{
+    notifyTask = task;
 }
 
 /**
- * Check the ESP NOW receive queue. If there are any received packets, send
- * them to hostEspNowRecvCb()
+ * Check the ESP NOW receive queue. All received packets are sent to
+ * hostEspNowRecvCb()
  */
 void checkEspNowRxQueue(void)
 {
     p2pPacket_t packet;
-    if (xQueueReceive(esp_now_queue, &packet, 0))
+    while (xQueueReceive(esp_now_queue, &packet, 0))
     {
         // Debug print the received payload
         // char dbg[256] = {0};
@@ -335,4 +351,11 @@ void espNowDeinit(void)
     esp_now_unregister_recv_cb();
     esp_now_unregister_send_cb();
     esp_now_deinit();
+
+    // Turn the radio off, so it's initialized from scratch next time
+    esp_wifi_stop();
+    esp_wifi_deinit();
+
+    vQueueDelete(esp_now_queue);
+    esp_now_queue = NULL;
 }
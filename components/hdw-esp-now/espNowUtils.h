@@ -14,6 +14,8 @@
 
 #include <stdint.h>
 #include <esp_now.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 //==============================================================================
 // Structs
@@ -45,5 +47,6 @@ void espNowDeinit(void);
 
 void espNowSend(const char* data, uint8_t len);
 void checkEspNowRxQueue(void);
+void setEspNowNotifyTask(TaskHandle_t task);
 
 #endif /* USER_ESPNOWUTILS_H_ */
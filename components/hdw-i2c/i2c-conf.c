@@ -27,3 +27,11 @@ void i2c_master_init(gpio_num_t sda, gpio_num_t scl, gpio_pullup_t pullup, uint3
     ESP_ERROR_CHECK(i2c_param_config(i2c_master_port, &conf));
     ESP_ERROR_CHECK(i2c_driver_install(i2c_master_port, conf.mode, 0, 0, 0));
 }
+
+/**
+ * @brief Uninstall the I2C bus driver
+ */
+void i2c_master_deinit(void)
+{
+    ESP_ERROR_CHECK(i2c_driver_delete(I2C_MASTER_NUM));
+}
@@ -467,6 +467,10 @@ bool initOLED(display_t * disp, bool reset, gpio_num_t rst_gpio)
     disp->getPx = getPxOled;
     disp->clearPx = clearPxOled;
     disp->drawDisplay = drawDisplayOled;
+    // The OLED packs pixels into bits, so there is no framebuffer to span into
+    disp->pxFb = NULL;
+    disp->pxStride = 0;
+    disp->dirtyRows = NULL;
 
     // Clear the RAM
     clearPxOled();
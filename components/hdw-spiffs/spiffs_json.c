@@ -2,9 +2,11 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "esp_log.h"
 #include "spiffs_manager.h"
+#include "spiffs_pack.h"
 #include "heatshrink_decoder.h"
 #include "spiffs_json.h"
 
@@ -18,7 +20,24 @@
  */
 char * loadJson(char * name)
 {
-    // Read JSON from file
+#ifndef JSON_COMPRESSION
+    // A JSON in the pack is viewed in place, so copy it out with a null terminator
+    const uint8_t * packData;
+    size_t packSize;
+    if(spiffsPackView(name, &packData, &packSize))
+    {
+        char * jsonStr = malloc(packSize + 1);
+        if(NULL == jsonStr)
+        {
+            ESP_LOGE("JSON", "Failed to allocate memory for %s", name);
+            return NULL;
+        }
+        memcpy(jsonStr, packData, packSize);
+        jsonStr[packSize] = 0;
+        return jsonStr;
+    }
+
+    // Anything else is read into a null terminated buffer, return that as is
     uint8_t * buf = NULL;
     size_t sz;
     if(!spiffsReadFile(name, &buf, &sz))
@@ -26,10 +45,19 @@ char * loadJson(char * name)
         ESP_LOGE("JSON", "Failed to read %s", name);
         return NULL;
     }
-
-#ifndef JSON_COMPRESSION
-    return (char*)buf;    
+    return (char *)buf;
 #else
+    // Map the JSON, it is only read once so there's no need to copy it first
+    spiffsMap_t map;
+    if(!spiffsMapFile(name, &map))
+    {
+        ESP_LOGE("JSON", "Failed to read %s", name);
+        return NULL;
+    }
+
+    const uint8_t * buf = map.data;
+    size_t sz = map.size;
+
     // Pick out the decompresed size and create a space for it
     uint16_t decompressedSize = (buf[0] << 8) | buf[1];
     uint8_t * decompressedBuf = calloc(sizeof(char) * (decompressedSize + 1));
@@ -66,7 +94,7 @@ char * loadJson(char * name)
     // All done decoding
     heatshrink_decoder_finish(hsd);
     heatshrink_decoder_free(hsd);
-    free(buf);
+    spiffsUnmapFile(&map);
 
     // Add null terminator
     decompressedBuf[decompressedSize] = 0;
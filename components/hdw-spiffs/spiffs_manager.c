@@ -3,15 +3,26 @@
 //==============================================================================
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_err.h"
 #include "esp_spiffs.h"
 #include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
 
 #include "spiffs_manager.h"
+#include "spiffs_pack.h"
 #include "spiffs_config.h"
 
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* The raw partition which the asset pack is flashed to, see partitions.csv */
+#define ASSET_PARTITION_LABEL "assets"
+
 //==============================================================================
 // Variables
 //==============================================================================
@@ -24,6 +35,10 @@ static const esp_vfs_spiffs_conf_t conf = {
     .format_if_mount_failed = false
 };
 
+/* The mapping of the asset partition into the data address space */
+static spi_flash_mmap_handle_t assetMapHandle;
+static bool assetsMapped = false;
+
 //==============================================================================
 // Functions
 //==============================================================================
@@ -47,6 +62,32 @@ bool initSpiffs(void)
     ESP_ERROR_CHECK(esp_spiffs_info(NULL, &total, &used));
     ESP_LOGI("SPIFFS", "Partition size: total: %d, used: %d", total, used);
 
+    /* SPIFFS files are scattered across flash pages, so they can't be mapped.
+     * The asset pack is also flashed to its own raw partition, which can be.
+     * Map it once and attach it so assets are read straight from flash
+     */
+    const esp_partition_t * assetPart = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSET_PARTITION_LABEL);
+    const void * assetPtr = NULL;
+    if((NULL != assetPart) &&
+        (ESP_OK == esp_partition_mmap(assetPart, 0, assetPart->size, SPI_FLASH_MMAP_DATA,
+                                      &assetPtr, &assetMapHandle)))
+    {
+        // The partition is larger than the pack, the pack's index bounds it
+        if(spiffsAttachPack(assetPtr, assetPart->size))
+        {
+            assetsMapped = true;
+        }
+        else
+        {
+            spi_flash_munmap(assetMapHandle);
+        }
+    }
+    else
+    {
+        ESP_LOGW("SPIFFS", "Asset partition not mapped, reading assets from SPIFFS");
+    }
+
     return true;
 }
 
@@ -57,6 +98,12 @@ bool initSpiffs(void)
  */
 bool deinitSpiffs(void)
 {
+    if(assetsMapped)
+    {
+        spiffsDetachPack();
+        spi_flash_munmap(assetMapHandle);
+        assetsMapped = false;
+    }
     return (ESP_OK == esp_vfs_spiffs_unregister(conf.partition_label));
 }
 
@@ -110,3 +157,45 @@ bool spiffsReadFile(const char * fname, uint8_t ** output, size_t * outsize)
     ESP_LOGI("SPIFFS", "Read from %s: %u bytes", fname, *outsize);
     return true;
 }
+
+/**
+ * @brief Get a read-only view of a whole file without copying it, if possible.
+ * Files in the mapped asset partition, or in any open pack, are returned in
+ * place. Anything else is read from SPIFFS into RAM
+ *
+ * @param fname The name of the file to map
+ * @param map   Returns the view of the file. Must be released with
+ *              spiffsUnmapFile()
+ * @return true if the file was mapped, false if it wasn't found
+ */
+bool spiffsMapFile(const char * fname, spiffsMap_t * map)
+{
+    map->priv = NULL;
+    if(spiffsPackView(fname, &map->data, &map->size))
+    {
+        return true;
+    }
+
+    uint8_t * buf = NULL;
+    if(!spiffsReadFile(fname, &buf, &map->size))
+    {
+        return false;
+    }
+    map->data = buf;
+    map->priv = buf;
+    return true;
+}
+
+/**
+ * @brief Release a view of a file returned by spiffsMapFile()
+ *
+ * @param map The view to release
+ */
+void spiffsUnmapFile(spiffsMap_t * map)
+{
+    // Only files which were read into RAM have anything to free
+    free(map->priv);
+    map->priv = NULL;
+    map->data = NULL;
+    map->size = 0;
+}
@@ -3,10 +3,25 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A read-only view of a whole file, returned by spiffsMapFile(). The data
+ * may point into flash, a memory mapped file, or a pack, so it must not be
+ * written to and must not be used after spiffsUnmapFile()
+ */
+typedef struct
+{
+    const uint8_t * data; ///< The file's contents
+    size_t size;          ///< The size of the file's contents
+    void * priv;          ///< What spiffsUnmapFile() needs to release, if anything
+} spiffsMap_t;
 
 bool initSpiffs(void);
 bool deinitSpiffs(void);
 
 bool spiffsReadFile(const char * fname, uint8_t ** output, size_t * outsize);
+bool spiffsMapFile(const char * fname, spiffsMap_t * map);
+void spiffsUnmapFile(spiffsMap_t * map);
 
 #endif
@@ -0,0 +1,224 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "spiffs_manager.h"
+#include "spiffs_pack.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define READ_U16(p) (((p)[0] << 8) | (p)[1])
+#define READ_U32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+                     ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static const uint8_t * packBuf = NULL;
+static size_t packSize = 0;
+static uint16_t packEntries = 0;
+static uint32_t packRefs = 0;
+// Set if the pack was read into RAM and must be freed, NULL if it's attached
+static uint8_t * packOwnedBuf = NULL;
+
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+static bool validatePack(const uint8_t * buf, size_t size, const char * name);
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Validate an asset pack's header and index, so lookups don't need to
+ *
+ * @param buf The pack's data
+ * @param size The size of the pack's data
+ * @param name The name of the pack, for logging
+ * @return true if the pack is valid, false if it isn't
+ */
+static bool validatePack(const uint8_t * buf, size_t size, const char * name)
+{
+    // Validate the header
+    if((size < PACK_HEADER_LEN) ||
+        (0 != memcmp(buf, PACK_MAGIC, 4)) ||
+        (PACK_VERSION != READ_U16(&buf[4])))
+    {
+        ESP_LOGE("PACK", "%s is not a valid asset pack", name);
+        return false;
+    }
+
+    // Validate the index
+    uint16_t entries = READ_U16(&buf[6]);
+    bool valid = ((size_t)(PACK_HEADER_LEN + (entries * PACK_ENTRY_LEN)) <= size);
+    for(uint16_t i = 0; valid && i < entries; i++)
+    {
+        const uint8_t * entry = &buf[PACK_HEADER_LEN + (i * PACK_ENTRY_LEN)];
+        uint32_t offset = READ_U32(&entry[PACK_NAME_LEN]);
+        uint32_t len = READ_U32(&entry[PACK_NAME_LEN + 4]);
+        valid = ('\0' == entry[PACK_NAME_LEN - 1]) && (offset <= size) &&
+            (len <= size - offset);
+    }
+    if(!valid)
+    {
+        ESP_LOGE("PACK", "%s has a corrupt index", name);
+        return false;
+    }
+
+    ESP_LOGI("PACK", "Opened %s: %d files, %u bytes", name, entries, (unsigned int)size);
+    return true;
+}
+
+/**
+ * @brief Open an asset pack by reading it from SPIFFS in a single read. While
+ * a pack is open, spiffsPackView() returns files from it without touching the
+ * file system. Calls may be nested, and each must be matched by a call to
+ * spiffsClosePack(). If a pack is attached already, this just uses that one
+ *
+ * @param packName The filename of the pack to open, usually ASSET_PACK_NAME
+ * @return true if the pack was opened, false if it wasn't
+ */
+bool spiffsOpenPack(const char * packName)
+{
+    // If the pack is already open, just note another user
+    if(0 < packRefs)
+    {
+        packRefs++;
+        return true;
+    }
+
+    // Read the whole pack at once
+    uint8_t * buf = NULL;
+    size_t size = 0;
+    if(!spiffsReadFile(packName, &buf, &size))
+    {
+        return false;
+    }
+
+    if(!validatePack(buf, size, packName))
+    {
+        free(buf);
+        return false;
+    }
+
+    packOwnedBuf = buf;
+    packBuf = buf;
+    packSize = size;
+    packEntries = READ_U16(&buf[6]);
+    packRefs = 1;
+    return true;
+}
+
+/**
+ * @brief Close an asset pack opened with spiffsOpenPack(). The pack's memory is
+ * freed when the last user closes it, so views into it must not be used after
+ */
+void spiffsClosePack(void)
+{
+    if(0 == packRefs)
+    {
+        return;
+    }
+
+    packRefs--;
+    if(0 == packRefs)
+    {
+        free(packOwnedBuf);
+        packOwnedBuf = NULL;
+        packBuf = NULL;
+        packSize = 0;
+        packEntries = 0;
+    }
+}
+
+/**
+ * @brief Attach an asset pack which is already in memory, like one mapped from
+ * flash, and hold it open until spiffsDetachPack(). The memory is not copied
+ * and is never freed by this module
+ *
+ * @param buf The pack's data, which must stay valid while attached
+ * @param size The size of the pack's data
+ * @return true if the pack was attached, false if it was invalid or another
+ *         pack is already open
+ */
+bool spiffsAttachPack(const uint8_t * buf, size_t size)
+{
+    if((0 < packRefs) || !validatePack(buf, size, "attached pack"))
+    {
+        return false;
+    }
+
+    packOwnedBuf = NULL;
+    packBuf = buf;
+    packSize = size;
+    packEntries = READ_U16(&buf[6]);
+    packRefs = 1;
+    return true;
+}
+
+/**
+ * @brief Detach an asset pack attached with spiffsAttachPack(). Views into it
+ * must not be used after
+ */
+void spiffsDetachPack(void)
+{
+    if((0 < packRefs) && (NULL == packOwnedBuf))
+    {
+        packRefs = 0;
+        packBuf = NULL;
+        packSize = 0;
+        packEntries = 0;
+    }
+}
+
+/**
+ * @brief Find a file in the open asset pack and return a view of its data. No
+ * memory is allocated or copied, the view points into the pack
+ *
+ * @param fname The name of the file to find
+ * @param data A pointer to return the file's data through
+ * @param size A pointer to return the file's size through
+ * @return true if the file was found, false if it wasn't or no pack is open
+ */
+bool spiffsPackView(const char * fname, const uint8_t ** data, size_t * size)
+{
+    if(0 == packRefs)
+    {
+        return false;
+    }
+
+    // The index is sorted, so binary search it
+    int32_t lo = 0;
+    int32_t hi = packEntries - 1;
+    while(lo <= hi)
+    {
+        int32_t mid = (lo + hi) / 2;
+        const uint8_t * entry = &packBuf[PACK_HEADER_LEN + (mid * PACK_ENTRY_LEN)];
+        int cmp = strncmp(fname, (const char *)entry, PACK_NAME_LEN);
+        if(0 == cmp)
+        {
+            *data = &packBuf[READ_U32(&entry[PACK_NAME_LEN])];
+            *size = READ_U32(&entry[PACK_NAME_LEN + 4]);
+            return true;
+        }
+        else if(cmp < 0)
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    return false;
+}
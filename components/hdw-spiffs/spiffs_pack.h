@@ -0,0 +1,37 @@
+#ifndef _SPIFFS_PACK_H_
+#define _SPIFFS_PACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An asset pack is every file in the spiffs_image folder concatenated together
+ * with a sorted index at the front, so a mode can load all of its assets with
+ * one file read. All integers are big-endian:
+ *
+ *   [4]  PACK_MAGIC
+ *   [2]  PACK_VERSION
+ *   [2]  The number of entries
+ *   Then for each entry, sorted by name with strcmp():
+ *     [PACK_NAME_LEN] The file name, NUL padded
+ *     [4]             The offset of the file's data from the start of the pack
+ *     [4]             The length of the file's data
+ *   Then each file's data, starting on a four byte boundary
+ *
+ * These must match spiffs_file_preprocessor/pack_processor.c
+ */
+#define ASSET_PACK_NAME  "assets.pak"
+#define PACK_MAGIC       "SWPK"
+#define PACK_VERSION     1
+#define PACK_NAME_LEN    32
+#define PACK_HEADER_LEN  8
+#define PACK_ENTRY_LEN   (PACK_NAME_LEN + 8)
+
+bool spiffsOpenPack(const char * packName);
+void spiffsClosePack(void);
+bool spiffsAttachPack(const uint8_t * buf, size_t size);
+void spiffsDetachPack(void);
+bool spiffsPackView(const char * fname, const uint8_t ** data, size_t * size);
+
+#endif
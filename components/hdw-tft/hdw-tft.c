@@ -6,6 +6,7 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_panel_ops.h"
@@ -15,6 +16,7 @@
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 #include "hdw-tft.h"
+#include "tft_convert.h"
 #include "esp_lcd_panel_interface.h"
 
 //==============================================================================
@@ -322,6 +324,10 @@ void setPxTft(int16_t x, int16_t y, paletteColor_t px);
 paletteColor_t getPxTft(int16_t x, int16_t y);
 void clearPxTft(void);
 void drawDisplayTft(bool drawDiff);
+static uint16_t findChangedRows(bool drawDiff);
+static void sendRows(const paletteColor_t * src, uint16_t y0, uint16_t y1);
+static void sendChangedRows(const paletteColor_t * src);
+static void tftFlushTask(void * arg);
 
 //==============================================================================
 // Variables
@@ -330,6 +336,26 @@ void drawDisplayTft(bool drawDiff);
 esp_lcd_panel_handle_t panel_handle = NULL;
 static paletteColor_t * pixels = NULL;
 static uint16_t *s_lines[2] = {0};
+// The send buffer to convert into next. It keeps alternating across flushes,
+// as the last band of the previous flush may still be on the SPI bus
+static uint8_t calcLine = 0;
+
+// Rows written since the last frame, and a copy of every row as last sent. A
+// row is only sent if it was written and differs from its copy. Every row is
+// sent the first time, as the panel's contents are unknown
+static uint8_t dirtyRows[TFT_HEIGHT] = {0};
+static paletteColor_t * sentPixels = NULL;
+static bool forceFullDraw = true;
+// The rows to send in the current flush
+static uint8_t changedRows[TFT_HEIGHT] = {0};
+
+// Asynchronous flushing. The mode draws to pixels, the back buffer, and
+// changed rows are copied to sentPixels, the front buffer, which tftFlushTask
+// sends while the next frame is drawn
+static bool asyncFlush = false;
+static TaskHandle_t flushTaskHandle = NULL;
+static SemaphoreHandle_t flushStart = NULL; ///< Given when there are rows to send
+static SemaphoreHandle_t flushIdle = NULL;  ///< Held while sentPixels is being sent
 // static uint64_t tFpsStart = 0;
 // static int framesDrawn = 0;
 
@@ -475,6 +501,21 @@ void initTFT(display_t * disp, spi_host_device_t spiHost, gpio_num_t sclk,
     {
         pixels = malloc(sizeof(paletteColor_t) * TFT_HEIGHT * TFT_WIDTH);
     }
+    if(NULL == sentPixels)
+    {
+        // Only changed rows are copied here, and every row is sent first, so
+        // it doesn't need to be initialized
+        sentPixels = malloc(sizeof(paletteColor_t) * TFT_HEIGHT * TFT_WIDTH);
+        if(NULL == sentPixels)
+        {
+            ESP_LOGE("TFT", "No memory to compare rows, sending every written row");
+        }
+    }
+
+    // Let the span drawing functions write to the framebuffer directly
+    disp->pxFb = pixels;
+    disp->pxStride = TFT_WIDTH;
+    disp->dirtyRows = dirtyRows;
 }
 
 /**
@@ -488,9 +529,10 @@ void initTFT(display_t * disp, spi_host_device_t spiHost, gpio_num_t sclk,
  */
 void setPxTft(int16_t x, int16_t y, paletteColor_t px)
 {
-    if(0 <= x && x <= TFT_WIDTH && 0 <= y && y < TFT_HEIGHT && cTransparent != px)
+    if(0 <= x && x < TFT_WIDTH && 0 <= y && y < TFT_HEIGHT && cTransparent != px)
     {
         pixels[(y * TFT_WIDTH) + x] = px;
+        dirtyRows[y] = 1;
     }
 }
 
@@ -503,7 +545,7 @@ void setPxTft(int16_t x, int16_t y, paletteColor_t px)
  */
 paletteColor_t getPxTft(int16_t x, int16_t y)
 {
-    if(0 <= x && x <= TFT_WIDTH && 0 <= y && y < TFT_HEIGHT)
+    if(0 <= x && x < TFT_WIDTH && 0 <= y && y < TFT_HEIGHT)
     {
         return pixels[(y * TFT_WIDTH) + x];
     }
@@ -516,62 +558,216 @@ paletteColor_t getPxTft(int16_t x, int16_t y)
 void clearPxTft(void)
 {
     memset(pixels, 0, sizeof(paletteColor_t) * TFT_HEIGHT * TFT_WIDTH);
+    memset(dirtyRows, 1, sizeof(dirtyRows));
 }
 
 /**
- * @brief Send the current framebuffer to the TFT display over the SPI bus.
- * 
- * This function can be called as quickly as possible and will limit frames to
- * 30fps max
+ * @brief Find which rows changed since the last flush and flag them in
+ * changedRows. Rows are only considered if they were written, and are dropped
+ * if they were rewritten with the same pixels. Flagged rows are copied to
+ * sentPixels
  *
- * Because the SPI driver handles transactions in the background, we can
- * calculate the next line while the previous one is being sent.
- * 
- * @param drawDiff unused
+ * @param drawDiff true to only flag changed rows, false to flag every row
+ * @return The number of flagged rows
  */
-void drawDisplayTft(bool drawDiff __attribute__((unused)))
+static uint16_t findChangedRows(bool drawDiff)
 {
-    // Limit drawing to 30fps
-    static uint64_t tLastDraw = 0;
-    uint64_t tNow = esp_timer_get_time();
-    if (tNow - tLastDraw > 33333)
-    {
-        tLastDraw = tNow;
+    bool drawAll = !drawDiff || forceFullDraw;
+    forceFullDraw = false;
 
-        // Indexes of the line currently being sent to the LCD and the line we're calculating
-        uint8_t sending_line = 0;
-        uint8_t calc_line = 0;
+    uint16_t numChanged = 0;
+    for (uint16_t y = 0; y < TFT_HEIGHT; y++)
+    {
+        changedRows[y] = 0;
+        if (!drawAll && !dirtyRows[y])
+        {
+            continue;
+        }
+        dirtyRows[y] = 0;
 
-        // Send the frame, ping ponging the send buffer
-        for (uint16_t y = 0; y < TFT_HEIGHT; y += PARALLEL_LINES)
+        if (NULL != sentPixels)
         {
-            // Calculate a line
-            uint16_t destIdx = 0;
-            for (uint16_t yp = y; yp < y + PARALLEL_LINES; yp++)
+            // Rows are often redrawn with the same pixels, so compare them
+            paletteColor_t * row = &pixels[y * TFT_WIDTH];
+            paletteColor_t * sentRow = &sentPixels[y * TFT_WIDTH];
+            if (!drawAll && (0 == memcmp(row, sentRow, sizeof(paletteColor_t) * TFT_WIDTH)))
             {
-                for (uint16_t x = 0; x < TFT_WIDTH; x++)
-                {
-                    s_lines[calc_line][destIdx++] = paletteColors[pixels[(yp * TFT_WIDTH) + x]];
-                }
+                continue;
             }
+            memcpy(sentRow, row, sizeof(paletteColor_t) * TFT_WIDTH);
+        }
+        changedRows[y] = 1;
+        numChanged++;
+    }
+    return numChanged;
+}
+
+/**
+ * @brief Convert and send a band of rows to the TFT, at most PARALLEL_LINES
+ * at a time, ping ponging the send buffer
+ *
+ * @param src The framebuffer to send rows from
+ * @param y0 The first row to send
+ * @param y1 The row after the last row to send
+ */
+static void sendRows(const paletteColor_t * src, uint16_t y0, uint16_t y1)
+{
+    for (uint16_t y = y0; y < y1; y += PARALLEL_LINES)
+    {
+        uint16_t yEnd = (y + PARALLEL_LINES < y1) ? (y + PARALLEL_LINES) : y1;
+
+        // Calculate some lines. The band's rows are contiguous in both buffers
+        convertPaletteRgb565(s_lines[calcLine], &src[y * TFT_WIDTH],
+                             paletteColors, (yEnd - y) * TFT_WIDTH);
 
-            sending_line = calc_line;
-            calc_line = !calc_line;
+        // Send the calculated data
+        esp_lcd_panel_draw_bitmap(panel_handle, 0, y, TFT_WIDTH, yEnd,
+                                  s_lines[calcLine]);
+        calcLine = !calcLine;
+    }
+}
 
-            // Send the calculated data
-            esp_lcd_panel_draw_bitmap(panel_handle, 0, y,
-                                      TFT_WIDTH, y + PARALLEL_LINES,
-                                      s_lines[sending_line]);
+/**
+ * @brief Send the rows flagged in changedRows to the TFT. Consecutive rows are
+ * sent as bands
+ *
+ * @param src The framebuffer to send rows from
+ */
+static void sendChangedRows(const paletteColor_t * src)
+{
+    int32_t bandStart = -1;
+    for (uint16_t y = 0; y < TFT_HEIGHT; y++)
+    {
+        if (changedRows[y] && bandStart < 0)
+        {
+            bandStart = y;
+        }
+        else if (!changedRows[y] && bandStart >= 0)
+        {
+            sendRows(src, bandStart, y);
+            bandStart = -1;
         }
+    }
+    if (bandStart >= 0)
+    {
+        sendRows(src, bandStart, TFT_HEIGHT);
+    }
+}
 
-        // Debug printing for frames-per-second
-        // framesDrawn++;
-        // if (framesDrawn == 120)
-        // {
-        //     uint64_t tFpsEnd = esp_timer_get_time();
-        //     ESP_LOGD("TFT", "%f FPS", 120 / ((tFpsEnd - tFpsStart) / 1000000.0f));
-        //     tFpsStart = tFpsEnd;
-        //     framesDrawn = 0;
-        // }
+/**
+ * @brief The task which sends the front buffer while the mode draws the next
+ * frame to the back buffer. It blocks while SPI transactions are in flight,
+ * which lets the mode run
+ *
+ * @param arg unused
+ */
+static void tftFlushTask(void * arg __attribute__((unused)))
+{
+    while (true)
+    {
+        xSemaphoreTake(flushStart, portMAX_DELAY);
+        sendChangedRows(sentPixels);
+        xSemaphoreGive(flushIdle);
     }
 }
+
+/**
+ * @brief Enable or disable flushing the TFT asynchronously. When enabled, a
+ * frame's changed rows are copied to a front buffer which is sent by a
+ * background task while the mode draws the next frame. The front buffer is the
+ * copy of the rows as last sent, so this costs no more memory
+ *
+ * @param async true to flush asynchronously, false to flush synchronously
+ */
+void setTftAsyncFlush(bool async)
+{
+    if (async && !asyncFlush)
+    {
+        if (NULL == sentPixels)
+        {
+            ESP_LOGE("TFT", "No front buffer, flushing synchronously");
+            return;
+        }
+
+        if (NULL == flushTaskHandle)
+        {
+            flushStart = xSemaphoreCreateBinary();
+            flushIdle = xSemaphoreCreateBinary();
+            xSemaphoreGive(flushIdle);
+            // Higher priority than the main task, so the next band is converted
+            // as soon as the SPI bus is free
+            xTaskCreate(tftFlushTask, "TFT", 4096, NULL, tskIDLE_PRIORITY + 1,
+                &flushTaskHandle);
+        }
+    }
+    else if (!async && asyncFlush)
+    {
+        waitForTftFlush();
+    }
+    asyncFlush = async;
+}
+
+/**
+ * @brief Wait until the previous frame's flush is done with the front buffer.
+ * The last band may still be on the SPI bus, but the front buffer is free.
+ * Returns immediately if flushing is synchronous
+ */
+void waitForTftFlush(void)
+{
+    if (NULL != flushIdle)
+    {
+        xSemaphoreTake(flushIdle, portMAX_DELAY);
+        xSemaphoreGive(flushIdle);
+    }
+}
+
+/**
+ * @brief Send the current framebuffer to the TFT display over the SPI bus.
+ * 
+ * Frames are paced by the frame scheduler, see checkFrameDue(), so every call
+ * sends a frame
+ *
+ * Because the SPI driver handles transactions in the background, we can
+ * calculate the next line while the previous one is being sent.
+ *
+ * Only rows which were written since the last frame, and whose contents
+ * actually changed, are sent. Consecutive changed rows are sent as bands
+ *
+ * If flushing is asynchronous, see setTftAsyncFlush(), this waits for the
+ * previous flush, swaps the changed rows to the front buffer, and returns while
+ * they're sent. Otherwise this returns after the rows are sent
+ *
+ * @param drawDiff true to only send changed rows, false to send every row
+ */
+void drawDisplayTft(bool drawDiff)
+{
+    if (asyncFlush)
+    {
+        // Wait for the flush task to be done with the front buffer. Finding
+        // the changed rows copies them to it, then send it
+        xSemaphoreTake(flushIdle, portMAX_DELAY);
+        if (0 < findChangedRows(drawDiff))
+        {
+            xSemaphoreGive(flushStart);
+        }
+        else
+        {
+            xSemaphoreGive(flushIdle);
+        }
+    }
+    else
+    {
+        findChangedRows(drawDiff);
+        sendChangedRows(pixels);
+    }
+
+    // Debug printing for frames-per-second
+    // framesDrawn++;
+    // if (framesDrawn == 120)
+    // {
+    //     uint64_t tFpsEnd = esp_timer_get_time();
+    //     ESP_LOGD("TFT", "%f FPS", 120 / ((tFpsEnd - tFpsStart) / 1000000.0f));
+    //     tFpsStart = tFpsEnd;
+    //     framesDrawn = 0;
+    // }
+}
@@ -9,5 +9,7 @@
 void initTFT(display_t * disp, spi_host_device_t spiHost, gpio_num_t sclk,
             gpio_num_t mosi, gpio_num_t dc, gpio_num_t cs, gpio_num_t rst,
             gpio_num_t backlight);
+void setTftAsyncFlush(bool async);
+void waitForTftFlush(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tft_convert.h"
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Convert a run of palette pixels to RGB565 one pixel at a time. This is
+ * the reference for convertPaletteRgb565(), and its fallback
+ *
+ * @param dst The RGB565 pixels to write
+ * @param src The palette pixels to convert
+ * @param lut The RGB565 color for each palette color
+ * @param len The number of pixels to convert
+ */
+void convertPaletteRgb565Scalar(uint16_t * dst, const paletteColor_t * src,
+    const uint16_t * lut, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        dst[i] = lut[src[i]];
+    }
+}
+
+/**
+ * @brief Convert a run of palette pixels to RGB565, eight pixels at a time.
+ * Source pixels are read four to a word and destination pixels are written two
+ * to a word, so the loop does two loads and four stores instead of eight of
+ * each. The Xtensa core faults on unaligned word access, so words are only used
+ * once both pointers are aligned
+ *
+ * @param dst The RGB565 pixels to write
+ * @param src The palette pixels to convert
+ * @param lut The RGB565 color for each palette color
+ * @param len The number of pixels to convert
+ */
+void convertPaletteRgb565(uint16_t * dst, const paletteColor_t * src,
+    const uint16_t * lut, uint32_t len)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    // Convert single pixels until the source is word aligned
+    while((0 < len) && (0 != ((uintptr_t)src & 3)))
+    {
+        *dst++ = lut[*src++];
+        len--;
+    }
+
+    // Rows are a multiple of four pixels, so the destination is usually aligned
+    // now too
+    if(0 == ((uintptr_t)dst & 3))
+    {
+        while(len >= 8)
+        {
+            uint32_t a;
+            uint32_t b;
+            memcpy(&a, __builtin_assume_aligned(src, 4), sizeof(a));
+            memcpy(&b, __builtin_assume_aligned(src + 4, 4), sizeof(b));
+
+            // Little endian, so the lowest byte is the first pixel
+            uint32_t out[4];
+            out[0] = lut[a & 0xFF]         | ((uint32_t)lut[(a >> 8) & 0xFF] << 16);
+            out[1] = lut[(a >> 16) & 0xFF] | ((uint32_t)lut[a >> 24] << 16);
+            out[2] = lut[b & 0xFF]         | ((uint32_t)lut[(b >> 8) & 0xFF] << 16);
+            out[3] = lut[(b >> 16) & 0xFF] | ((uint32_t)lut[b >> 24] << 16);
+            memcpy(__builtin_assume_aligned(dst, 4), out, sizeof(out));
+
+            src += 8;
+            dst += 8;
+            len -= 8;
+        }
+    }
+#endif
+
+    // Convert whatever is left one pixel at a time
+    convertPaletteRgb565Scalar(dst, src, lut, len);
+}
@@ -0,0 +1,13 @@
+#ifndef _TFT_CONVERT_H_
+#define _TFT_CONVERT_H_
+
+#include <stdint.h>
+
+#include "../../main/display/palette.h"
+
+void convertPaletteRgb565(uint16_t * dst, const paletteColor_t * src,
+    const uint16_t * lut, uint32_t len);
+void convertPaletteRgb565Scalar(uint16_t * dst, const paletteColor_t * src,
+    const uint16_t * lut, uint32_t len);
+
+#endif
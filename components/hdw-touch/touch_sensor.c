@@ -16,6 +16,7 @@
 //==============================================================================
 
 static QueueHandle_t que_touch = NULL;
+static TaskHandle_t notifyTask = NULL;
 
 //==============================================================================
 // Prototypes
@@ -140,12 +141,27 @@ static void touchsensor_interrupt_cb(void *arg)
     evt.pad_num = touch_pad_get_current_meas_channel();
 
     xQueueSendFromISR(que_touch, &evt, &task_awoken);
+    if(NULL != notifyTask)
+    {
+        vTaskNotifyGiveFromISR(notifyTask, &task_awoken);
+    }
     if (task_awoken == pdTRUE)
     {
         portYIELD_FROM_ISR();
     }
 }
 
+/**
+ * @brief Set a task to notify whenever a touch event is queued, so it can block
+ * instead of polling checkTouchSensor()
+ *
+ * @param task The task to notify, or NULL to stop notifying
+ */
+void setTouchNotifyTask(TaskHandle_t task)
+{
+    notifyTask = task;
+}
+
 /**
  * @brief Call this function periodically to check the touch pad interrupt queue
  * 
@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include "driver/touch_pad.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 //==============================================================================
 // Structs
@@ -26,5 +28,6 @@ typedef struct touch_msg {
 void initTouchSensor(float touchPadSensitivity, bool denoiseEnable,
     uint8_t numTouchPads, ...);
 bool checkTouchSensor(touch_event_t *);
+void setTouchNotifyTask(TaskHandle_t task);
 
 #endif /* _TOUCH_SENSOR_H_ */
\ No newline at end of file
@@ -31,7 +31,7 @@ SRC_DIRS_RECURSIVE = emu/src main/display main/modes main/colorchord main/utils
 # This is a list of directories to scan for c files not recursively
 SRC_DIRS_FLAT = main
 # This is a list of files to compile directly. There's no scanning here
-SRC_FILES = components/hdw-spiffs/heatshrink_decoder.c components/hdw-spiffs/spiffs_json.c
+SRC_FILES = components/hdw-spiffs/heatshrink_decoder.c components/hdw-spiffs/spiffs_json.c components/hdw-spiffs/spiffs_pack.c components/hdw-tft/tft_convert.c
 # This is all the source directories combined
 SRC_DIRS = $(shell find $(SRC_DIRS_RECURSIVE) -type d) $(SRC_DIRS_FLAT)
 # This is all the source files combined
@@ -89,6 +89,7 @@ CFLAGS_WARNINGS_EXTRA = \
 # Used by the ESP SDK
 DEFINES_LIST = \
 	CONFIG_ST7789_240x240=y \
+	CONFIG_TFT_ASYNC_FLUSH=y \
 	CONFIG_IDF_TARGET_ESP32S2=y \
 	SOC_RMT_CHANNELS_PER_GROUP=4 \
 	SOC_TOUCH_SENSOR_NUM=14 \
@@ -164,7 +165,8 @@ all: $(EXECUTABLE) assets
 
 assets:
 	make -C ./spiffs_file_preprocessor/
-	./spiffs_file_preprocessor/spiffs_file_preprocessor -i ./assets/ -o ./spiffs_image/
+	mkdir -p ./$(OBJ_DIR)
+	./spiffs_file_preprocessor/spiffs_file_preprocessor -i ./assets/ -o ./spiffs_image/ -p ./$(OBJ_DIR)/assets.pak -m 0x40000
 
 # To build the main file, you have to compile the objects
 $(EXECUTABLE): $(OBJECTS)
@@ -0,0 +1,550 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "esp_timer.h"
+
+#include "emu_esp.h"
+#include "emu_display.h"
+#include "emu_bench.h"
+#include "bresenham.h"
+#include "spiffs_pack.h"
+#include "asset_cache.h"
+#include "tft_convert.h"
+#include "arena.h"
+#include "fighter_json.h"
+#include "fighter_replay.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define BENCH_FRAMES  500
+#define BENCH_SPRITES 16
+#define BENCH_WSG_W   32
+#define BENCH_WSG_H   32
+#define BENCH_FONT_H  13
+#define BENCH_LOADS   20
+#define BENCH_BAND    16 ///< Rows converted at a time, like PARALLEL_LINES
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef void (*benchFrameFn_t)(display_t * disp, wsg_t * wsg, font_t * font);
+typedef void (*benchConvertFn_t)(uint16_t * dst, const paletteColor_t * src,
+    const uint16_t * lut, uint32_t len);
+
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+static void benchLegacyFrame(display_t * disp, wsg_t * wsg, font_t * font);
+static void benchSpanFrame(display_t * disp, wsg_t * wsg, font_t * font);
+static int64_t benchRun(display_t * disp, benchFrameFn_t frameFn, wsg_t * wsg,
+    font_t * font, paletteColor_t * result);
+static int64_t benchLoadAllWsgs(bool usePack, bool useCache, uint32_t * numLoaded);
+static int64_t benchConvertFrames(benchConvertFn_t convertFn, const paletteColor_t * src,
+    const uint16_t * lut, uint16_t * dst);
+static bool replayFighterMatch(const fighterInputs_t * inputs, uint32_t numFrames,
+    uint32_t * hashes, int64_t * elapsedUs);
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Draw a frame the way the display primitives used to, one setPx() call
+ * per pixel
+ *
+ * @param disp The display to draw to
+ * @param wsg A sprite to draw
+ * @param font A font to draw text with
+ */
+static void benchLegacyFrame(display_t * disp, wsg_t * wsg, font_t * font)
+{
+    // Background, like fillDisplayArea()
+    for(int16_t y = 0; y < disp->h; y++)
+    {
+        for(int16_t x = 0; x < disp->w; x++)
+        {
+            disp->setPx(x, y, c001);
+        }
+    }
+
+    // Sprites, like drawWsg() with flips but without rotation
+    for(int16_t s = 0; s < BENCH_SPRITES; s++)
+    {
+        int16_t xOff = (s * 37) % disp->w - 8;
+        int16_t yOff = (s * 53) % disp->h - 8;
+        bool flipLR = (1 == s % 2);
+        bool flipUD = (0 == s % 3);
+        for(int16_t srcY = 0; srcY < wsg->h; srcY++)
+        {
+            for(int16_t srcX = 0; srcX < wsg->w; srcX++)
+            {
+                paletteColor_t px = wsg->px[(srcY * wsg->w) + srcX];
+                int16_t dstX = xOff + (flipLR ? (wsg->w - 1 - srcX) : srcX);
+                int16_t dstY = yOff + (flipUD ? (wsg->h - 1 - srcY) : srcY);
+                if(cTransparent != px && 0 <= dstX && dstX < disp->w &&
+                    0 <= dstY && dstY < disp->h)
+                {
+                    disp->setPx(dstX, dstY, px);
+                }
+            }
+        }
+    }
+
+    // Circles, like plotCircleFilled()
+    for(int16_t c = 0; c < 4; c++)
+    {
+        int xm = 30 + (c * 60), ym = disp->h / 2, r = 20;
+        int x = -r, y = 0, err = 2 - 2 * r;
+        do
+        {
+            for (int lineX = xm + x; lineX <= xm - x; lineX++)
+            {
+                disp->setPx(lineX, ym - y, c500);
+                disp->setPx(lineX, ym + y, c500);
+            }
+            r = err;
+            if (r <= y)
+            {
+                err += ++y * 2 + 1;
+            }
+            if (r > x || err > y)
+            {
+                err += ++x * 2 + 1;
+            }
+        } while (x < 0);
+    }
+
+    // Text, like drawChar()
+    for(int16_t line = 0; line < 8; line++)
+    {
+        int16_t xOff = 4;
+        int16_t yOff = 4 + (line * (font->h + 2));
+        for(char ch = 'A'; ch <= 'Z'; ch++)
+        {
+            font_ch_t * fch = &font->chars[ch - ' '];
+            uint8_t rowBytes = (fch->w + 7) / 8;
+            for (int y = 0; y < font->h; y++)
+            {
+                const uint8_t * row = &font->bitmaps[fch->offset + (y * rowBytes)];
+                for (int x = 0; x < fch->w; x++)
+                {
+                    if (row[x / 8] & (1 << (x % 8)))
+                    {
+                        disp->setPx(x + xOff, y + yOff, c555);
+                    }
+                }
+            }
+            xOff += fch->w + 1;
+        }
+    }
+}
+
+/**
+ * @brief Draw the same frame as benchLegacyFrame() with the span based display
+ * primitives
+ *
+ * @param disp The display to draw to
+ * @param wsg A sprite to draw
+ * @param font A font to draw text with
+ */
+static void benchSpanFrame(display_t * disp, wsg_t * wsg, font_t * font)
+{
+    fillDisplayArea(disp, 0, 0, disp->w, disp->h, c001);
+
+    for(int16_t s = 0; s < BENCH_SPRITES; s++)
+    {
+        drawWsg(disp, wsg, (s * 37) % disp->w - 8, (s * 53) % disp->h - 8,
+            (1 == s % 2), (0 == s % 3), 0);
+    }
+
+    for(int16_t c = 0; c < 4; c++)
+    {
+        plotCircleFilled(disp, 30 + (c * 60), disp->h / 2, 20, c500);
+    }
+
+    for(int16_t line = 0; line < 8; line++)
+    {
+        drawText(disp, font, c555, "ABCDEFGHIJKLMNOPQRSTUVWXYZ", 4,
+            4 + (line * (font->h + 2)));
+    }
+}
+
+/**
+ * @brief Draw a number of frames and time it
+ *
+ * @param disp The display to draw to
+ * @param frameFn The function to draw a frame with
+ * @param wsg A sprite to draw
+ * @param font A font to draw text with
+ * @param result A buffer to copy the last frame's pixels to
+ * @return The average time to draw a frame, in microseconds
+ */
+static int64_t benchRun(display_t * disp, benchFrameFn_t frameFn, wsg_t * wsg,
+    font_t * font, paletteColor_t * result)
+{
+    int64_t tStart = esp_timer_get_time();
+    for(int32_t i = 0; i < BENCH_FRAMES; i++)
+    {
+        frameFn(disp, wsg, font);
+    }
+    int64_t tElapsed = esp_timer_get_time() - tStart;
+
+    for(int16_t y = 0; y < disp->h; y++)
+    {
+        for(int16_t x = 0; x < disp->w; x++)
+        {
+            result[(y * disp->w) + x] = disp->getPx(x, y);
+        }
+    }
+    return tElapsed / BENCH_FRAMES;
+}
+
+/**
+ * @brief Benchmark the span based display primitives against per-pixel setPx()
+ * drawing on the emulated TFT, without opening a window. The output of both
+ * must be identical
+ *
+ * @return 0 if the outputs matched, 1 if they did not
+ */
+int emuBenchDisplay(void)
+{
+    display_t disp;
+    initTFT(&disp, 0, 0, 0, 0, 0, 0, 0);
+
+    // Make a sprite with a transparent border and some transparent holes
+    wsg_t wsg;
+    wsg.w = BENCH_WSG_W;
+    wsg.h = BENCH_WSG_H;
+    wsg.px = malloc(sizeof(paletteColor_t) * wsg.w * wsg.h);
+    wsg.rleRows = NULL;
+    wsg.rle = NULL;
+    for(int16_t y = 0; y < wsg.h; y++)
+    {
+        for(int16_t x = 0; x < wsg.w; x++)
+        {
+            bool isEdge = (x < 2) || (y < 2) || (x >= wsg.w - 2) || (y >= wsg.h - 2);
+            bool isHole = ((x / 4) % 3 == 0) && ((y / 4) % 3 == 0);
+            wsg.px[(y * wsg.w) + x] = (isEdge || isHole) ? cTransparent :
+                (paletteColor_t)((x * 7 + y * 3) % cTransparent);
+        }
+    }
+
+    // Make a font with arbitrary but deterministic glyphs
+    font_t font;
+    font.h = BENCH_FONT_H;
+    font.bitmaps = malloc(('~' - ' ' + 1) * BENCH_FONT_H);
+    for(uint8_t i = 0; i < '~' - ' ' + 1; i++)
+    {
+        // Every glyph is less than 8 pixels wide, so each row is one byte
+        font.chars[i].w = 5 + (i % 4);
+        font.chars[i].offset = i * BENCH_FONT_H;
+        for(uint16_t b = 0; b < BENCH_FONT_H; b++)
+        {
+            font.bitmaps[font.chars[i].offset + b] = (uint8_t)((i * 31) + (b * 113)) & ((1 << font.chars[i].w) - 1);
+        }
+    }
+
+    paletteColor_t * legacyPx = malloc(sizeof(paletteColor_t) * disp.w * disp.h);
+    paletteColor_t * spanPx = malloc(sizeof(paletteColor_t) * disp.w * disp.h);
+
+    disp.clearPx();
+    int64_t legacyUs = benchRun(&disp, benchLegacyFrame, &wsg, &font, legacyPx);
+    disp.clearPx();
+    int64_t spanUs = benchRun(&disp, benchSpanFrame, &wsg, &font, spanPx);
+
+    bool match = (0 == memcmp(legacyPx, spanPx, sizeof(paletteColor_t) * disp.w * disp.h));
+
+    printf("Display benchmark, %dx%d, %d frames\n", disp.w, disp.h, BENCH_FRAMES);
+    printf("  setPx: %6lld us/frame\n", (long long)legacyUs);
+    printf("  spans: %6lld us/frame\n", (long long)spanUs);
+    printf("  output %s\n", match ? "matches" : "DIFFERS");
+
+    free(legacyPx);
+    free(spanPx);
+    free(wsg.px);
+    freeFontData(&font);
+    deinitDisplayMemory();
+
+    return match ? 0 : 1;
+}
+
+/**
+ * @brief Load and free every WSG in the spiffs_image folder, optionally with
+ * the asset pack open or through the asset cache, and time it
+ *
+ * @param usePack true to open the asset pack first, false to read each file
+ * @param useCache true to load through the asset cache, false to bypass it
+ * @param numLoaded A pointer to return the number of WSGs loaded through
+ * @return The time it took, in microseconds, or -1 if the pack couldn't open
+ */
+static int64_t benchLoadAllWsgs(bool usePack, bool useCache, uint32_t * numLoaded)
+{
+    DIR * dir = opendir("./spiffs_image/");
+    if(NULL == dir)
+    {
+        return -1;
+    }
+
+    int64_t tStart = esp_timer_get_time();
+    if(usePack && !spiffsOpenPack(ASSET_PACK_NAME))
+    {
+        closedir(dir);
+        return -1;
+    }
+
+    *numLoaded = 0;
+    struct dirent * ent;
+    while(NULL != (ent = readdir(dir)))
+    {
+        size_t len = strlen(ent->d_name);
+        if(len > 4 && 0 == strcmp(&ent->d_name[len - 4], ".wsg"))
+        {
+            wsg_t wsg;
+            if(useCache && loadWsg(ent->d_name, &wsg))
+            {
+                freeWsg(&wsg);
+                (*numLoaded)++;
+            }
+            else if(!useCache && readWsg(ent->d_name, &wsg, NULL))
+            {
+                freeWsgData(&wsg);
+                (*numLoaded)++;
+            }
+        }
+    }
+
+    if(usePack)
+    {
+        spiffsClosePack();
+    }
+    int64_t tElapsed = esp_timer_get_time() - tStart;
+    closedir(dir);
+    return tElapsed;
+}
+
+/**
+ * @brief Benchmark loading every WSG from individual files against loading them
+ * through the asset pack, without opening a window
+ *
+ * @return 0 if both ways loaded the same WSGs, 1 if they did not
+ */
+int emuBenchAssets(void)
+{
+    int64_t fileUs = 0;
+    int64_t packUs = 0;
+    int64_t cacheUs = 0;
+    uint32_t fileLoaded = 0;
+    uint32_t packLoaded = 0;
+    uint32_t cacheLoaded = 0;
+
+    // Warm the cache, like a mode that was entered before
+    benchLoadAllWsgs(false, true, &cacheLoaded);
+    for(int32_t i = 0; i < BENCH_LOADS; i++)
+    {
+        fileUs += benchLoadAllWsgs(false, false, &fileLoaded);
+        packUs += benchLoadAllWsgs(true, false, &packLoaded);
+        cacheUs += benchLoadAllWsgs(false, true, &cacheLoaded);
+    }
+
+    assetCacheStats_t stats;
+    getAssetCacheStats(&stats);
+
+    printf("Asset benchmark, %d WSGs, %d loads\n", fileLoaded, BENCH_LOADS);
+    printf("  files: %6lld us/load\n", (long long)(fileUs / BENCH_LOADS));
+    printf("  pack:  %6lld us/load\n", (long long)(packUs / BENCH_LOADS));
+    printf("  cache: %6lld us/load (%u hits, %u misses, %u evictions, %u bytes)\n",
+        (long long)(cacheUs / BENCH_LOADS), stats.hits, stats.misses, stats.evictions,
+        (unsigned int)stats.bytes);
+
+    return ((fileLoaded == packLoaded) && (fileLoaded == cacheLoaded)) ? 0 : 1;
+}
+
+/**
+ * @brief Convert a frame of palette pixels to RGB565 in bands, like the TFT
+ * driver does, BENCH_FRAMES times and time it
+ *
+ * @param convertFn The conversion function to time
+ * @param src The frame to convert
+ * @param lut The RGB565 color for each palette color
+ * @param dst A band sized buffer to convert into
+ * @return The average time per frame, in microseconds
+ */
+static int64_t benchConvertFrames(benchConvertFn_t convertFn, const paletteColor_t * src,
+    const uint16_t * lut, uint16_t * dst)
+{
+    int64_t tStart = esp_timer_get_time();
+    for(int32_t f = 0; f < BENCH_FRAMES; f++)
+    {
+        for(uint16_t y = 0; y < TFT_HEIGHT; y += BENCH_BAND)
+        {
+            uint16_t rows = (y + BENCH_BAND < TFT_HEIGHT) ? BENCH_BAND : (TFT_HEIGHT - y);
+            convertFn(dst, &src[y * TFT_WIDTH], lut, rows * TFT_WIDTH);
+        }
+    }
+    return (esp_timer_get_time() - tStart) / BENCH_FRAMES;
+}
+
+/**
+ * @brief Benchmark the word-at-a-time palette to RGB565 conversion against the
+ * one-pixel-at-a-time loop. The output of both must be identical, including
+ * for runs which start and end unaligned
+ *
+ * @return 0 if the outputs matched, 1 if they did not
+ */
+int emuBenchConvert(void)
+{
+    // An arbitrary but deterministic lookup table and frame
+    uint16_t lut[256];
+    for(uint16_t i = 0; i < 256; i++)
+    {
+        lut[i] = (uint16_t)((i * 40503u) ^ (i << 3));
+    }
+    paletteColor_t * src = malloc(sizeof(paletteColor_t) * TFT_WIDTH * TFT_HEIGHT);
+    for(uint32_t i = 0; i < TFT_WIDTH * TFT_HEIGHT; i++)
+    {
+        src[i] = (paletteColor_t)(((i * 2654435761u) >> 13) % (cTransparent + 1));
+    }
+
+    uint16_t * scalarDst = malloc(sizeof(uint16_t) * TFT_WIDTH * TFT_HEIGHT);
+    uint16_t * wordDst = malloc(sizeof(uint16_t) * TFT_WIDTH * TFT_HEIGHT);
+
+    // Check every combination of source and destination alignment, with
+    // lengths that leave leftover pixels
+    bool match = true;
+    for(uint32_t srcOff = 0; srcOff < 4; srcOff++)
+    {
+        for(uint32_t dstOff = 0; dstOff < 2; dstOff++)
+        {
+            for(uint32_t len = 0; len < 40; len++)
+            {
+                memset(scalarDst, 0, sizeof(uint16_t) * 64);
+                memset(wordDst, 0, sizeof(uint16_t) * 64);
+                convertPaletteRgb565Scalar(&scalarDst[dstOff], &src[srcOff], lut, len);
+                convertPaletteRgb565(&wordDst[dstOff], &src[srcOff], lut, len);
+                match = match && (0 == memcmp(scalarDst, wordDst, sizeof(uint16_t) * 64));
+            }
+        }
+    }
+
+    // Then check and time whole frames
+    int64_t scalarUs = benchConvertFrames(convertPaletteRgb565Scalar, src, lut, scalarDst);
+    int64_t wordUs = benchConvertFrames(convertPaletteRgb565, src, lut, wordDst);
+    convertPaletteRgb565Scalar(scalarDst, src, lut, TFT_WIDTH * TFT_HEIGHT);
+    convertPaletteRgb565(wordDst, src, lut, TFT_WIDTH * TFT_HEIGHT);
+    match = match && (0 == memcmp(scalarDst, wordDst, sizeof(uint16_t) * TFT_WIDTH * TFT_HEIGHT));
+
+    printf("RGB565 conversion benchmark, %dx%d, %d frames\n", TFT_WIDTH, TFT_HEIGHT, BENCH_FRAMES);
+    printf("  scalar: %6lld us/frame\n", (long long)scalarUs);
+    printf("  words:  %6lld us/frame\n", (long long)wordUs);
+    printf("  output %s\n", match ? "matches" : "DIFFERS");
+
+    free(src);
+    free(scalarDst);
+    free(wordDst);
+
+    return match ? 0 : 1;
+}
+
+/**
+ * @brief Play a fighter match from its inputs with fresh fighter data, hashing
+ * the game state after every frame
+ *
+ * @param inputs The inputs for each frame
+ * @param numFrames The number of frames to play
+ * @param hashes A buffer to store each frame's hash in
+ * @param elapsedUs A pointer to return the time spent stepping through
+ * @return true if the match was played, false if the fighters couldn't load
+ */
+static bool replayFighterMatch(const fighterInputs_t * inputs, uint32_t numFrames,
+    uint32_t * hashes, int64_t * elapsedUs)
+{
+    arena_t arena = {0};
+    fighterData_t ftrData;
+    uint8_t numFighters = 0;
+
+    bool packOpen = spiffsOpenPack(ASSET_PACK_NAME);
+    fighter_t * fighters = loadFighterData(&arena, &ftrData, &numFighters);
+    if(packOpen)
+    {
+        spiffsClosePack();
+    }
+
+    fighterStage_t * stage = arenaAlloc(&arena, sizeof(fighterStage_t));
+    fighterGameState_t * state = arenaAlloc(&arena, sizeof(fighterGameState_t));
+    bool started = (NULL != stage) && (NULL != state);
+    if(started)
+    {
+        initBattlefieldStage(stage);
+        started = initFighterGame(state, stage, fighters, numFighters);
+    }
+
+    if(started)
+    {
+        int64_t tStart = esp_timer_get_time();
+        for(uint32_t i = 0; i < numFrames; i++)
+        {
+            stepFighterGame(state, stage, &inputs[i]);
+            hashes[i] = hashFighterGame(state, stage);
+        }
+        *elapsedUs = esp_timer_get_time() - tStart;
+    }
+
+    freeFighterData(&ftrData);
+    arenaReset(&arena);
+    return started;
+}
+
+/**
+ * @brief Play a recorded fighter match without opening a window, printing a
+ * hash of the game state after every frame. The match is played twice, and
+ * both playthroughs must hash the same, so the simulation is deterministic
+ *
+ * @param path The replay file, recorded with --record-fighter
+ * @return 0 if the match played the same both times, 1 if it did not
+ */
+int emuReplayFighter(const char * path)
+{
+    uint32_t numFrames = 0;
+    fighterInputs_t * inputs = loadFighterReplay(path, &numFrames);
+    if(NULL == inputs)
+    {
+        return 1;
+    }
+
+    uint32_t * hashes = calloc(numFrames ? numFrames : 1, sizeof(uint32_t));
+    uint32_t * checkHashes = calloc(numFrames ? numFrames : 1, sizeof(uint32_t));
+    int64_t elapsedUs = 0;
+    int64_t checkUs = 0;
+    bool played = replayFighterMatch(inputs, numFrames, hashes, &elapsedUs) &&
+        replayFighterMatch(inputs, numFrames, checkHashes, &checkUs);
+
+    bool match = played && (0 == memcmp(hashes, checkHashes, sizeof(uint32_t) * numFrames));
+    if(played)
+    {
+        for(uint32_t i = 0; i < numFrames; i++)
+        {
+            printf("%u %08x\n", (unsigned int)i, (unsigned int)hashes[i]);
+        }
+        printf("Fighter replay, %u frames\n", (unsigned int)numFrames);
+        printf("  step:  %6lld us total, %lld ns/frame\n", (long long)elapsedUs,
+            numFrames ? (long long)((elapsedUs * 1000) / numFrames) : 0ll);
+        printf("  final: %08x\n", numFrames ? (unsigned int)hashes[numFrames - 1] : 0u);
+        printf("  replay %s\n", match ? "matches" : "DIFFERS");
+    }
+
+    free(hashes);
+    free(checkHashes);
+    free(inputs);
+
+    return match ? 0 : 1;
+}
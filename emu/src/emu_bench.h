@@ -0,0 +1,9 @@
+#ifndef _EMU_BENCH_H_
+#define _EMU_BENCH_H_
+
+int emuBenchDisplay(void);
+int emuBenchAssets(void);
+int emuBenchConvert(void);
+int emuReplayFighter(const char * path);
+
+#endif
@@ -27,3 +27,11 @@ void i2c_master_init(gpio_num_t sda UNUSED, gpio_num_t scl UNUSED,
 {
     ; // Nothing to do
 }
+
+/**
+ * @brief Do Nothing
+ */
+void i2c_master_deinit(void)
+{
+    ; // Nothing to do
+}
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 
 #include "gpio_types.h"
@@ -239,18 +240,49 @@ uint32_t paletteColorsEmu[216] =
     0xFFFFFFFF,
 };
 
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* How fast the real TFT's SPI bus moves pixel data, 80MHz, used to model how
+ * long a flush takes */
+#define EMU_TFT_BYTES_PER_US 10
+
 //==============================================================================
 // Variables
 //==============================================================================
 
 // Display memory
-uint32_t * bitmapDisplay = NULL; //0xRRGGBBAA
+paletteColor_t * pixelsDisplay = NULL; // One palette index per pixel
 uint32_t * constBitmapDisplay = NULL; //0xRRGGBBAA
 int bitmapWidth = 0;
 int bitmapHeight = 0;
 int displayMult = 1;
+// Rows written since the last frame, and a copy of every row as last drawn, so
+// only changed rows are converted, as on the real TFT
+uint8_t dirtyRowsDisplay[TFT_HEIGHT] = {0};
+paletteColor_t * drawnPixelsDisplay = NULL;
+bool forceFullDraw = true;
+// The rows to convert in the current flush
+uint8_t changedRowsDisplay[TFT_HEIGHT] = {0};
+// How many bytes would have been sent to the TFT, and how many a full redraw of
+// every frame would have sent
+uint64_t tftPushedBytes = 0;
+uint64_t tftFullBytes = 0;
 pthread_mutex_t displayMutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Asynchronous flushing, as on the real TFT. The mode draws to pixelsDisplay,
+// the back buffer, and changed rows are copied to the front buffer which the
+// flush thread converts. NULL if flushing is synchronous
+paletteColor_t * frontPixelsDisplay = NULL;
+pthread_t flushThread;
+bool flushThreadRunning = false;
+bool flushThreadShouldRun = false;
+bool flushPending = false;
+uint16_t flushRows = 0;
+pthread_mutex_t flushMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t flushCond = PTHREAD_COND_INITIALIZER;
+
 // LED state
 uint8_t rdNumLeds = 0;
 led_t * rdLeds = NULL;
@@ -263,6 +295,10 @@ void emuSetPxTft(int16_t x, int16_t y, paletteColor_t px);
 paletteColor_t emuGetPxTft(int16_t x, int16_t y);
 void emuClearPxTft(void);
 void emuDrawDisplayTft(bool drawDiff);
+static uint16_t findChangedRows(bool drawDiff);
+static void convertChangedRows(const paletteColor_t * src);
+static void modelTftTransfer(uint16_t rows);
+static void * tftFlushThread(void * arg);
 
 void emuSetPxOled(int16_t x, int16_t y, paletteColor_t px);
 paletteColor_t emuGetPxOled(int16_t x, int16_t y);
@@ -302,15 +338,12 @@ void setDisplayBitmapMultiplier(uint8_t multiplier)
 
     displayMult = multiplier;
 
-    // Reallocate bitmapDisplay
-    free(bitmapDisplay);
-    bitmapDisplay = calloc((multiplier * TFT_WIDTH) * (multiplier * TFT_HEIGHT),
-        sizeof(uint32_t));
-
     // Reallocate constBitmapDisplay
     free(constBitmapDisplay);
     constBitmapDisplay = calloc((multiplier * TFT_WIDTH) * (multiplier * TFT_HEIGHT),
         sizeof(uint32_t));
+    // The new bitmap is blank, so every row must be drawn again
+    forceFullDraw = true;
 
     unlockDisplayMemoryMutex();
 }
@@ -330,6 +363,19 @@ uint32_t * getDisplayBitmap(uint16_t * width, uint16_t * height)
     return constBitmapDisplay;
 }
 
+/**
+ * @brief Get how many bytes of pixel data the TFT would have been sent, with
+ * only changed rows sent, and how many sending every row would have taken
+ *
+ * @param pushedBytes A pointer to return the bytes sent through
+ * @param fullBytes A pointer to return the bytes full redraws would send through
+ */
+void getTftPushStats(uint64_t * pushedBytes, uint64_t * fullBytes)
+{
+    *pushedBytes = tftPushedBytes;
+    *fullBytes = tftFullBytes;
+}
+
 /**
  * @brief Get a pointer to the LED memory. This access must be guarded by
  * lockDisplayMemoryMutex() and unlockDisplayMemoryMutex()
@@ -348,11 +394,17 @@ led_t * getLedMemory(uint8_t * numLeds)
  */
 void deinitDisplayMemory(void)
 {
+    setTftAsyncFlush(false);
+
 	pthread_mutex_lock(&displayMutex);
-	if(NULL != bitmapDisplay)
+	if(NULL != pixelsDisplay)
 	{
-		free(bitmapDisplay);
+		free(pixelsDisplay);
 	}
+    if(NULL != drawnPixelsDisplay)
+    {
+        free(drawnPixelsDisplay);
+    }
     if(NULL != constBitmapDisplay)
     {
         free(constBitmapDisplay);
@@ -392,10 +444,14 @@ void initTFT(display_t * disp, spi_host_device_t spiHost UNUSED,
     bitmapWidth = TFT_WIDTH;
     bitmapHeight = TFT_HEIGHT;
 
-    // Set up underlying bitmap
-    if(NULL == bitmapDisplay)
+    // Set up underlying framebuffer
+    if(NULL == pixelsDisplay)
     {
-        bitmapDisplay = calloc(TFT_WIDTH * TFT_HEIGHT, sizeof(uint32_t));
+        pixelsDisplay = calloc(TFT_WIDTH * TFT_HEIGHT, sizeof(paletteColor_t));
+    }
+    if(NULL == drawnPixelsDisplay)
+    {
+        drawnPixelsDisplay = calloc(TFT_WIDTH * TFT_HEIGHT, sizeof(paletteColor_t));
     }
 
     // This may be setup by the emulator already
@@ -414,41 +470,32 @@ void initTFT(display_t * disp, spi_host_device_t spiHost UNUSED,
     disp->setPx = emuSetPxTft;
     disp->clearPx = emuClearPxTft;
     disp->drawDisplay = emuDrawDisplayTft;
+
+    // Let the span drawing functions write to the framebuffer directly
+    disp->pxFb = pixelsDisplay;
+    disp->pxStride = TFT_WIDTH;
+    disp->dirtyRows = dirtyRowsDisplay;
 }
 
 /**
- * @brief Set a single pixel on the emulated TFT. This converts from 5 bit color
- * to 8 bit color
+ * @brief Set a single pixel on the emulated TFT. The pixel is stored as a
+ * palette index and converted to 24 bit color when the display is drawn
  *
  * @param x The X coordinate of the pixel to set
  * @param y The Y coordinate of the pixel to set
- * @param px The pixel to set, in 15 bit color with 1 alpha channel
+ * @param px The pixel to set, as a palette color
  */
 void emuSetPxTft(int16_t x, int16_t y, paletteColor_t px)
 {
-    if(0 <= x && x < TFT_WIDTH && 0 <= y && y < TFT_HEIGHT)
+    if(0 <= x && x < TFT_WIDTH && 0 <= y && y < TFT_HEIGHT && cTransparent != px)
     {
-        // Convert from 8 bit to 24 bit color
-        if(cTransparent != px)
-        {
-            pthread_mutex_lock(&displayMutex);
-            for(uint16_t mY = 0; mY < displayMult; mY++)
-            {
-                for(uint16_t mX = 0; mX < displayMult; mX++)
-                {
-                    int dstX = ((x * displayMult) + mX);
-                    int dstY = ((y * displayMult) + mY);
-                    bitmapDisplay[(dstY * (TFT_WIDTH * displayMult)) + dstX] = paletteColorsEmu[px];
-                }
-            }
-            pthread_mutex_unlock(&displayMutex);
-        }
+        pixelsDisplay[(y * TFT_WIDTH) + x] = px;
+        dirtyRowsDisplay[y] = 1;
     }
 }
 
 /**
- * @brief Get a pixel from the emulated TFT. This converts 8 bit color to 5 bit
- * color
+ * @brief Get a pixel from the emulated TFT
  *
  * @param x The X coordinate of the pixel to get
  * @param y The Y coordinate of the pixel to get
@@ -458,50 +505,244 @@ paletteColor_t emuGetPxTft(int16_t x, int16_t y)
 {
     if(0 <= x && x < TFT_WIDTH && 0 <= y && y < TFT_HEIGHT)
     {
-        pthread_mutex_lock(&displayMutex);
-        int srcX = (x * displayMult);
-        int srcY = (y * displayMult);
-        uint32_t argb = bitmapDisplay[(srcY * (TFT_WIDTH * displayMult)) + srcX];
-        pthread_mutex_unlock(&displayMutex);
+        return pixelsDisplay[(y * TFT_WIDTH) + x];
+    }
+    return c000;
+}
+
+/**
+ * @brief Clear the entire display to opaque black in one call
+ */
+void emuClearPxTft(void)
+{
+    memset(pixelsDisplay, c000, sizeof(paletteColor_t) * TFT_HEIGHT * TFT_WIDTH);
+    memset(dirtyRowsDisplay, 1, sizeof(dirtyRowsDisplay));
+}
+
+/**
+ * @brief Find which rows changed since the last flush and flag them in
+ * changedRowsDisplay. Rows are only considered if they were written, and are
+ * dropped if they were rewritten with the same pixels
+ *
+ * @param drawDiff true to only flag changed rows, false to flag every row
+ * @return The number of flagged rows
+ */
+static uint16_t findChangedRows(bool drawDiff)
+{
+    pthread_mutex_lock(&displayMutex);
+    bool drawAll = !drawDiff || forceFullDraw;
+    forceFullDraw = false;
+    pthread_mutex_unlock(&displayMutex);
+
+    uint16_t numChanged = 0;
+    for(uint16_t y = 0; y < TFT_HEIGHT; y++)
+    {
+        changedRowsDisplay[y] = 0;
+        if(!drawAll && !dirtyRowsDisplay[y])
+        {
+            continue;
+        }
+        dirtyRowsDisplay[y] = 0;
+
+        // Rows are often redrawn with the same pixels, so compare them
+        paletteColor_t * row = &pixelsDisplay[y * TFT_WIDTH];
+        paletteColor_t * drawnRow = &drawnPixelsDisplay[y * TFT_WIDTH];
+        if(!drawAll && (0 == memcmp(row, drawnRow, sizeof(paletteColor_t) * TFT_WIDTH)))
+        {
+            continue;
+        }
+        memcpy(drawnRow, row, sizeof(paletteColor_t) * TFT_WIDTH);
+        changedRowsDisplay[y] = 1;
+        numChanged++;
+    }
+
+    tftFullBytes += TFT_WIDTH * TFT_HEIGHT * sizeof(uint16_t);
+    tftPushedBytes += numChanged * TFT_WIDTH * sizeof(uint16_t);
+    return numChanged;
+}
+
+/**
+ * @brief Convert the rows flagged in changedRowsDisplay to memory that won't be
+ * modified by the Swadge mode. rawdraw will use this non-changing bitmap to
+ * draw. displayMutex must be held
+ *
+ * @param src The framebuffer to convert rows from
+ */
+static void convertChangedRows(const paletteColor_t * src)
+{
+    uint32_t dstW = TFT_WIDTH * displayMult;
+    for(uint16_t y = 0; y < TFT_HEIGHT; y++)
+    {
+        if(!changedRowsDisplay[y])
+        {
+            continue;
+        }
 
-        for(uint8_t i = 0; i < (sizeof(paletteColorsEmu) / sizeof(paletteColorsEmu[0])); i++)
+        // Convert one row, scaled horizontally
+        uint32_t * dstRow = &constBitmapDisplay[(y * displayMult) * dstW];
+        const paletteColor_t * srcRow = &src[y * TFT_WIDTH];
+        uint32_t dstIdx = 0;
+        for(uint16_t x = 0; x < TFT_WIDTH; x++)
         {
-            if (argb == paletteColorsEmu[i])
+            uint32_t rgba = paletteColorsEmu[srcRow[x]];
+            for(uint16_t mX = 0; mX < displayMult; mX++)
             {
-                return i;
+                dstRow[dstIdx++] = rgba;
             }
         }
+
+        // Then copy that row to scale vertically
+        for(uint16_t mY = 1; mY < displayMult; mY++)
+        {
+            memcpy(&dstRow[mY * dstW], dstRow, sizeof(uint32_t) * dstW);
+        }
     }
-    return c000;
 }
 
 /**
- * @brief Clear the entire display to opaque black in one call
+ * @brief Sleep for as long as the real TFT would take to receive some rows, so
+ * frame pacing behaves like it does on the Swadge
+ *
+ * @param rows The number of rows sent
  */
-void emuClearPxTft(void)
+static void modelTftTransfer(uint16_t rows)
 {
-	pthread_mutex_lock(&displayMutex);
-    for(uint32_t idx = 0; idx < TFT_HEIGHT * displayMult * TFT_WIDTH * displayMult; idx++)
+    if(0 < rows)
     {
-        bitmapDisplay[idx] = 0x000000FF;
+        usleep((rows * TFT_WIDTH * sizeof(uint16_t)) / EMU_TFT_BYTES_PER_US);
     }
-	pthread_mutex_unlock(&displayMutex);
+}
+
+/**
+ * @brief The thread which flushes the front buffer while the Swadge draws the
+ * next frame to the back buffer
+ *
+ * @param arg unused
+ * @return NULL
+ */
+static void * tftFlushThread(void * arg UNUSED)
+{
+    pthread_mutex_lock(&flushMutex);
+    while(flushThreadShouldRun)
+    {
+        if(!flushPending)
+        {
+            pthread_cond_wait(&flushCond, &flushMutex);
+            continue;
+        }
+        uint16_t rows = flushRows;
+        pthread_mutex_unlock(&flushMutex);
+
+        pthread_mutex_lock(&displayMutex);
+        convertChangedRows(frontPixelsDisplay);
+        pthread_mutex_unlock(&displayMutex);
+        modelTftTransfer(rows);
+
+        // Let the Swadge know the front buffer is free
+        pthread_mutex_lock(&flushMutex);
+        flushPending = false;
+        pthread_cond_broadcast(&flushCond);
+    }
+    pthread_mutex_unlock(&flushMutex);
+    return NULL;
+}
+
+/**
+ * @brief Enable or disable flushing the TFT asynchronously. When enabled, a
+ * frame's changed rows are copied to a front buffer which is flushed by another
+ * thread while the Swadge draws the next frame
+ *
+ * @param async true to flush asynchronously, false to flush synchronously
+ */
+void setTftAsyncFlush(bool async)
+{
+    if(async && !flushThreadRunning)
+    {
+        frontPixelsDisplay = calloc(TFT_WIDTH * TFT_HEIGHT, sizeof(paletteColor_t));
+        flushThreadShouldRun = true;
+        flushPending = false;
+        pthread_create(&flushThread, NULL, tftFlushThread, NULL);
+        flushThreadRunning = true;
+    }
+    else if(!async && flushThreadRunning)
+    {
+        waitForTftFlush();
+
+        pthread_mutex_lock(&flushMutex);
+        flushThreadShouldRun = false;
+        pthread_cond_broadcast(&flushCond);
+        pthread_mutex_unlock(&flushMutex);
+        pthread_join(flushThread, NULL);
+        flushThreadRunning = false;
+
+        free(frontPixelsDisplay);
+        frontPixelsDisplay = NULL;
+    }
+}
+
+/**
+ * @brief Wait until the previous frame's flush is done with the front buffer.
+ * Returns immediately if flushing is synchronous
+ */
+void waitForTftFlush(void)
+{
+    pthread_mutex_lock(&flushMutex);
+    while(flushPending)
+    {
+        pthread_cond_wait(&flushCond, &flushMutex);
+    }
+    pthread_mutex_unlock(&flushMutex);
 }
 
 /**
  * @brief Called when the Swadge wants to draw a new display. Note, this is
  * called from a pthread, so it raises a flag to draw on the main thread
  *
- * @param drawDiff unused, the whole display is always drawn
+ * Only rows which were written since the last frame, and whose contents
+ * actually changed, are converted. The bytes the real TFT would be sent are
+ * counted, see getTftPushStats()
+ *
+ * If flushing is asynchronous, this waits for the previous flush, swaps the
+ * changed rows to the front buffer, and returns while they're flushed.
+ * Otherwise this returns after the rows are flushed
+ *
+ * @param drawDiff true to only draw changed rows, false to draw every row
  */
-void emuDrawDisplayTft(bool drawDiff UNUSED)
+void emuDrawDisplayTft(bool drawDiff)
 {
-	/* Copy the current framebuffer to memory that won't be modified by the
-     * Swadge mode. rawdraw will use this non-changing bitmap to draw
-     */
-	pthread_mutex_lock(&displayMutex);
-    memcpy(constBitmapDisplay, bitmapDisplay, sizeof(uint32_t) * TFT_HEIGHT * displayMult * TFT_WIDTH * displayMult);
-	pthread_mutex_unlock(&displayMutex);
+    if(flushThreadRunning)
+    {
+        // Wait for the flush thread to be done with the front buffer
+        waitForTftFlush();
+
+        uint16_t rows = findChangedRows(drawDiff);
+        if(0 < rows)
+        {
+            // Swap the changed rows to the front buffer, then flush it
+            for(uint16_t y = 0; y < TFT_HEIGHT; y++)
+            {
+                if(changedRowsDisplay[y])
+                {
+                    memcpy(&frontPixelsDisplay[y * TFT_WIDTH], &pixelsDisplay[y * TFT_WIDTH],
+                        sizeof(paletteColor_t) * TFT_WIDTH);
+                }
+            }
+
+            pthread_mutex_lock(&flushMutex);
+            flushRows = rows;
+            flushPending = true;
+            pthread_cond_broadcast(&flushCond);
+            pthread_mutex_unlock(&flushMutex);
+        }
+    }
+    else
+    {
+        uint16_t rows = findChangedRows(drawDiff);
+        pthread_mutex_lock(&displayMutex);
+        convertChangedRows(pixelsDisplay);
+        pthread_mutex_unlock(&displayMutex);
+        modelTftTransfer(rows);
+    }
 }
 
 //==============================================================================
@@ -524,6 +765,9 @@ bool initOLED(display_t * disp, bool reset UNUSED, gpio_num_t rst UNUSED)
     disp->setPx = emuSetPxOled;
     disp->clearPx = emuClearPxOled;
     disp->drawDisplay = emuDrawDisplayOled;
+    disp->pxFb = NULL;
+    disp->pxStride = 0;
+    disp->dirtyRows = NULL;
 
     return true;
 }
@@ -43,6 +43,12 @@ uint8_t pthreadIdx = 0;
 pthread_t threads[MAX_THREADS];
 volatile bool threadsShouldRun = true;
 
+// Task notifications. Only one task waits for notifications, so there is one
+// count shared by every task handle
+static uint32_t notifyCount = 0;
+static pthread_mutex_t notifyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t notifyCond = PTHREAD_COND_INITIALIZER;
+
 //==============================================================================
 // Function prototypes
 //==============================================================================
@@ -145,6 +151,71 @@ BaseType_t xTaskCreate( TaskFunction_t pvTaskCode, const char * const pcName UNU
     return 0;
 }
 
+/**
+ * @brief Get a handle for the calling task. Only one task waits for
+ * notifications, so any non-NULL handle will do
+ *
+ * @return A handle for the calling task
+ */
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)&notifyCount;
+}
+
+/**
+ * @brief Block until the task is notified or a timeout passes
+ *
+ * @param xClearCountOnExit pdTRUE to clear the notification count, pdFALSE to
+ *                          decrement it
+ * @param xTicksToWait The longest time to block, in milliseconds
+ * @return The notification count before it was cleared or decremented
+ */
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    struct timespec tDeadline;
+    clock_gettime(CLOCK_REALTIME, &tDeadline);
+    tDeadline.tv_sec += xTicksToWait / 1000;
+    tDeadline.tv_nsec += (xTicksToWait % 1000) * 1000000;
+    if(tDeadline.tv_nsec >= 1000000000)
+    {
+        tDeadline.tv_sec++;
+        tDeadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&notifyMutex);
+    while((0 == notifyCount) && threadsShouldRun)
+    {
+        if(0 != pthread_cond_timedwait(&notifyCond, &notifyMutex, &tDeadline))
+        {
+            // Timed out
+            break;
+        }
+    }
+
+    uint32_t count = notifyCount;
+    if(0 < notifyCount)
+    {
+        notifyCount = (pdFALSE == xClearCountOnExit) ? (notifyCount - 1) : 0;
+    }
+    pthread_mutex_unlock(&notifyMutex);
+    return count;
+}
+
+/**
+ * @brief Notify a task, waking it if it's blocked in ulTaskNotifyTake()
+ *
+ * @param xTaskToNotify unused
+ * @return pdTRUE
+ */
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify UNUSED)
+{
+    pthread_mutex_lock(&notifyMutex);
+    notifyCount++;
+    pthread_cond_signal(&notifyCond);
+    pthread_mutex_unlock(&notifyMutex);
+    return pdTRUE;
+}
+
 /**
  * @brief Raise a flag to stop all threads, then join them
  */
@@ -153,6 +224,11 @@ void joinThreads(void)
     // Tell threads to stop
     threadsShouldRun = false;
 
+    // Wake any task waiting for a notification
+    pthread_mutex_lock(&notifyMutex);
+    pthread_cond_broadcast(&notifyCond);
+    pthread_mutex_unlock(&notifyMutex);
+
     // Wait for threads to actually stop
     for(uint8_t i = 0; i < pthreadIdx; i++)
     {
@@ -3,12 +3,15 @@
 //==============================================================================
 
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <math.h>
 
 #include "esp_log.h"
 #include "swadge_esp32.h"
+#include "swadgeMode.h"
 #include "btn.h"
 
 #include "list.h"
@@ -18,6 +21,10 @@
 #include "emu_display.h"
 #include "emu_sound.h"
 #include "emu_sensors.h"
+#include "emu_bench.h"
+#include "emu_wifi.h"
+#include "profiler.h"
+#include "fighter_replay.h"
 
 //Make it so we don't need to include any other C files in our build.
 #define CNFG_IMPLEMENTATION
@@ -91,6 +98,15 @@ void HandleDestroy()
     // Upon exit, stop all tasks
     joinThreads();
 
+    // Report how long switching modes took
+    modeSwitchStats_t switchStats;
+    getModeSwitchStats(&switchStats);
+    if(0 < switchStats.switches)
+    {
+        ESP_LOGI("MODE", "%u mode switches, the longest took %lldus",
+            (unsigned int)switchStats.switches, (long long)switchStats.maxUs);
+    }
+
     // Then free display memory
     deinitDisplayMemory();
 
@@ -105,12 +121,62 @@ void HandleDestroy()
  * @brief The main emulator function. This initializes rawdraw and calls
  * app_main(), then spins in a loop updating the rawdraw UI
  *
- * @param argc unused
- * @param argv unused
+ * Passing --bench-display, --bench-assets or --bench-convert runs that
+ * benchmark headless and exits instead. Passing --replay-fighter <file> plays
+ * a recorded fighter match headless, printing a hash of every frame, and
+ * exits.
+ *
+ * Otherwise these options can be combined. Passing --record-fighter <file>
+ * records fighter matches played in the window to that file. Passing
+ * --espnow-latency <ms> delays received ESP-NOW packets and passing
+ * --espnow-loss <percent> drops that share of them, to test networked modes
+ * with two emulators on one computer. Passing --profile draws the profiling
+ * overlay on the display from the start, as the main menu's Profiler row does
+ *
+ * @param argc The number of command line arguments
+ * @param argv The command line arguments
  * @return 0 on success, a nonzero value for any errors
  */
-int main(int argc UNUSED, char ** argv UNUSED)
+int main(int argc, char ** argv)
 {
+    // Run benchmarks without a window if asked to
+    if((argc > 1) && (0 == strcmp(argv[1], "--bench-display")))
+    {
+        return emuBenchDisplay();
+    }
+    else if((argc > 1) && (0 == strcmp(argv[1], "--bench-assets")))
+    {
+        return emuBenchAssets();
+    }
+    else if((argc > 1) && (0 == strcmp(argv[1], "--bench-convert")))
+    {
+        return emuBenchConvert();
+    }
+    else if((argc > 2) && (0 == strcmp(argv[1], "--replay-fighter")))
+    {
+        return emuReplayFighter(argv[2]);
+    }
+
+    for(int i = 1; i < argc; i++)
+    {
+        if((i + 1 < argc) && (0 == strcmp(argv[i], "--record-fighter")))
+        {
+            setFighterRecordFile(argv[++i]);
+        }
+        else if((i + 1 < argc) && (0 == strcmp(argv[i], "--espnow-latency")))
+        {
+            emuSetEspNowLatency(atoi(argv[++i]));
+        }
+        else if((i + 1 < argc) && (0 == strcmp(argv[i], "--espnow-loss")))
+        {
+            emuSetEspNowLoss(atoi(argv[++i]));
+        }
+        else if(0 == strcmp(argv[i], "--profile"))
+        {
+            setProfileOverlay(true);
+        }
+    }
+
     // First initialize rawdraw
     // Screen-specific configurations
     // Save window dimensions from the last loop
@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "esp_random.h"
 #include "esp_log.h"
@@ -18,7 +19,8 @@ uint32_t esp_random(void)
     if (!seeded)
     {
         seeded = true;
-        srand(time(NULL));
+        // Emulators started together still get different MACs
+        srand(time(NULL) ^ getpid());
     }
     return rand();
 }
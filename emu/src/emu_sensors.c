@@ -29,6 +29,7 @@ char inputKeys[32];
 uint32_t buttonState = 0;
 list_t * buttonQueue;
 pthread_mutex_t buttonQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+TaskHandle_t buttonNotifyTask = NULL;
 
 //==============================================================================
 // Buttons
@@ -92,6 +93,16 @@ bool checkButtonQueue(buttonEvt_t* evt)
 	}
 }
 
+/**
+ * @brief Set a task to notify whenever a button event is queued
+ *
+ * @param task The task to notify, or NULL to stop notifying
+ */
+void setButtonNotifyTask(TaskHandle_t task)
+{
+    buttonNotifyTask = task;
+}
+
 /**
  * @brief This handles key events from rawdraw
  *
@@ -148,6 +159,12 @@ void emuSensorHandleKey( int keycode, int bDown )
 			list_rpush(buttonQueue, buttonNode);
 			pthread_mutex_unlock(&buttonQueueMutex);
 
+			// Wake the task waiting for it
+			if(NULL != buttonNotifyTask)
+			{
+				xTaskNotifyGive(buttonNotifyTask);
+			}
+
 			break;
 		}
 	}
@@ -171,6 +188,17 @@ void initTouchSensor(float touchPadSensitivity UNUSED, bool denoiseEnable UNUSED
     WARN_UNIMPLEMENTED();
 }
 
+/**
+ * @brief Set a task to notify whenever a touch event is queued. The emulator
+ * has no touch pads, so this never happens
+ *
+ * @param task unused
+ */
+void setTouchNotifyTask(TaskHandle_t task UNUSED)
+{
+    ; // Nothing to do
+}
+
 /**
  * @brief Call this function periodically to check the touch pad interrupt queue
  *
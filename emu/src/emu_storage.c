@@ -7,6 +7,10 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "esp_log.h"
 #include "cJSON.h"
@@ -14,12 +18,25 @@
 #include "emu_esp.h"
 #include "nvs_manager.h"
 #include "spiffs_manager.h"
+#include "spiffs_pack.h"
 
 //==============================================================================
 // Defines
 //==============================================================================
 
 #define NVS_JSON_FILE "nvs.json"
+#define SPIFFS_DIR    "./spiffs_image/"
+/* The device flashes the asset pack to its own partition, not SPIFFS, so the
+ * emulator's assets target builds it next to the objects, see emu.mk */
+#define ASSET_PACK_PATH "./emu/obj/" ASSET_PACK_NAME
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+/* The asset pack, mapped like the device maps its asset partition */
+static spiffsMap_t assetMap;
+static bool assetsMapped = false;
 
 //==============================================================================
 // NVS
@@ -210,22 +227,60 @@ bool readNvs32(const char* key, int32_t* outVal)
 //==============================================================================
 
 /**
- * @brief Do nothing, the normal file system replaces SPIFFS well
+ * @brief Get the path of a file in the emulated SPIFFS. The asset pack is
+ * found where the emulator's assets target builds it instead
+ *
+ * @param fname The name of the file
+ * @param path  A buffer to return the path in
+ * @param pathLen The length of the buffer
+ */
+static void getSpiffsPath(const char * fname, char * path, size_t pathLen)
+{
+    if(0 == strcmp(fname, ASSET_PACK_NAME))
+    {
+        snprintf(path, pathLen, "%s", ASSET_PACK_PATH);
+    }
+    else
+    {
+        snprintf(path, pathLen, "%s%s", SPIFFS_DIR, fname);
+    }
+}
+
+/**
+ * @brief The normal file system replaces SPIFFS well. Just map the asset pack
+ * and attach it, like the device does with its asset partition
  *
  * @return true
  */
 bool initSpiffs(void)
 {
+    if(spiffsMapFile(ASSET_PACK_NAME, &assetMap))
+    {
+        if(spiffsAttachPack(assetMap.data, assetMap.size))
+        {
+            assetsMapped = true;
+        }
+        else
+        {
+            spiffsUnmapFile(&assetMap);
+        }
+    }
     return true;
 }
 
 /**
- * @brief Do nothing, the normal file system replaces SPIFFS well
+ * @brief Unmap the asset pack, the normal file system replaces SPIFFS well
  *
- * @return true
+ * @return false
  */
 bool deinitSpiffs(void)
 {
+    if(assetsMapped)
+    {
+        spiffsDetachPack();
+        spiffsUnmapFile(&assetMap);
+        assetsMapped = false;
+    }
     return false;
 }
 
@@ -253,8 +308,8 @@ bool spiffsReadFile(const char * fname, uint8_t ** output, size_t * outsize)
     ESP_LOGD("SPIFFS", "Reading %s", fname);
 
     // Open for reading the given file
-    char fnameFull[128] = "./spiffs_image/";
-    strcat(fnameFull, fname);
+    char fnameFull[128];
+    getSpiffsPath(fname, fnameFull, sizeof(fnameFull));
     FILE* f = fopen(fnameFull, "rb");
     if (f == NULL) {
         ESP_LOGE("SPIFFS", "Failed to open %s", fnameFull);
@@ -277,3 +332,77 @@ bool spiffsReadFile(const char * fname, uint8_t ** output, size_t * outsize)
     ESP_LOGD("SPIFFS", "Read from %s: %d bytes", fname, *outsize);
     return true;
 }
+
+/**
+ * @brief Get a read-only view of a whole file without copying it. Files in any
+ * open pack are returned in place, anything else is memory mapped with mmap()
+ *
+ * @param fname The name of the file to map
+ * @param map   Returns the view of the file. Must be released with
+ *              spiffsUnmapFile()
+ * @return true if the file was mapped, false if it wasn't found
+ */
+bool spiffsMapFile(const char * fname, spiffsMap_t * map)
+{
+    map->priv = NULL;
+    if(spiffsPackView(fname, &map->data, &map->size))
+    {
+        return true;
+    }
+
+    char fnameFull[128];
+    getSpiffsPath(fname, fnameFull, sizeof(fnameFull));
+    int fd = open(fnameFull, O_RDONLY);
+    if(fd < 0)
+    {
+        ESP_LOGE("SPIFFS", "Failed to open %s", fnameFull);
+        return false;
+    }
+
+    struct stat st;
+    if(0 != fstat(fd, &st))
+    {
+        close(fd);
+        return false;
+    }
+    map->size = st.st_size;
+
+    // mmap() can't map nothing, but an empty file is still a file
+    if(0 == map->size)
+    {
+        close(fd);
+        map->data = (const uint8_t *)"";
+        return true;
+    }
+
+    // The mapping outlives the file descriptor
+    void * mapped = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(MAP_FAILED == mapped)
+    {
+        ESP_LOGE("SPIFFS", "Failed to map %s", fnameFull);
+        return false;
+    }
+
+    map->data = mapped;
+    map->priv = mapped;
+    ESP_LOGD("SPIFFS", "Mapped %s: %d bytes", fname, (int)map->size);
+    return true;
+}
+
+/**
+ * @brief Release a view of a file returned by spiffsMapFile()
+ *
+ * @param map The view to release
+ */
+void spiffsUnmapFile(spiffsMap_t * map)
+{
+    // Only files which were mapped with mmap() have anything to release
+    if(NULL != map->priv)
+    {
+        munmap(map->priv, map->size);
+    }
+    map->priv = NULL;
+    map->data = NULL;
+    map->size = 0;
+}
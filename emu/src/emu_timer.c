@@ -112,8 +112,8 @@ esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args,
 {
     if(NULL == *out_handle)
     {
-        // Allocate memory for a timer
-        (*out_handle) = (esp_timer_handle_t)malloc(sizeof(struct esp_timer));
+        // Allocate memory for a timer. It isn't running until it's started
+        (*out_handle) = (esp_timer_handle_t)calloc(1, sizeof(struct esp_timer));
     }
 
     // Initialize the timer
@@ -168,6 +168,10 @@ esp_err_t esp_timer_delete(esp_timer_handle_t timer)
     }
     list_iterator_destroy(iter);
 
+    if(NULL == node)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
     list_remove(timerList, node);
     return ESP_OK;
 }
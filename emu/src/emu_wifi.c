@@ -25,9 +25,11 @@
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_random.h"
+#include "esp_timer.h"
 
 #include "espNowUtils.h"
 #include "p2pConnection.h"
+#include "emu_wifi.h"
 
 //==============================================================================
 // Defines
@@ -36,6 +38,9 @@
 #define ESP_NOW_PORT 32888
 #define MAXRECVSTRING 1024  // Longest string to receive 
 
+#define ESP_NOW_MAX_LEN    250 // The longest ESP-NOW payload
+#define DELAYED_RX_PACKETS 64  // Received packets which can be delayed at once
+
 //==============================================================================
 // Variables
 //==============================================================================
@@ -45,6 +50,21 @@ hostEspNowSendCb_t hostEspNowSendCb = NULL;
 
 int socketFd;
 
+// Impairments to test networked modes with
+static uint32_t rxLatencyUs = 0;
+static uint8_t rxLossPercent = 0;
+
+// Received packets waiting out the latency, in the order they arrived
+static struct
+{
+    int64_t deliverUs;
+    uint8_t mac[6];
+    uint8_t len;
+    char data[ESP_NOW_MAX_LEN];
+} delayedRx[DELAYED_RX_PACKETS];
+static uint8_t delayedRxHead = 0;
+static uint8_t delayedRxCount = 0;
+
 //==============================================================================
 // Functions
 //==============================================================================
@@ -186,6 +206,72 @@ void espNowSend(const char* data, uint8_t dataLen)
     }
 }
 
+/**
+ * @brief Set a task to notify whenever a packet is received. The emulator's
+ * socket is polled instead, whenever the main loop wakes up
+ *
+ * @param task unused
+ */
+void setEspNowNotifyTask(TaskHandle_t task UNUSED)
+{
+    ; // Nothing to do
+}
+
+/**
+ * @brief Delay every received ESP-NOW packet, to test networked modes with
+ * latency
+ *
+ * @param latencyMs How long to delay packets, in milliseconds
+ */
+void emuSetEspNowLatency(uint32_t latencyMs)
+{
+    rxLatencyUs = latencyMs * 1000;
+}
+
+/**
+ * @brief Drop some received ESP-NOW packets at random, to test networked modes
+ * with packet loss
+ *
+ * @param lossPercent The percentage of packets to drop
+ */
+void emuSetEspNowLoss(uint8_t lossPercent)
+{
+    rxLossPercent = lossPercent;
+}
+
+/**
+ * @brief Receive a packet, dropping or delaying it if asked to
+ *
+ * @param mac The MAC which sent it
+ * @param data The packet
+ * @param len The length of the packet
+ */
+static void emuRecvEspNow(const uint8_t* mac, const char* data, uint8_t len)
+{
+    if((rxLossPercent > 0) && ((esp_random() % 100) < rxLossPercent))
+    {
+        return;
+    }
+
+    if(0 == rxLatencyUs)
+    {
+        hostEspNowRecvCb(mac, data, len, 0);
+    }
+    else if(DELAYED_RX_PACKETS > delayedRxCount)
+    {
+        uint8_t idx = (delayedRxHead + delayedRxCount) % DELAYED_RX_PACKETS;
+        delayedRx[idx].deliverUs = esp_timer_get_time() + rxLatencyUs;
+        memcpy(delayedRx[idx].mac, mac, sizeof(delayedRx[idx].mac));
+        delayedRx[idx].len = (len > ESP_NOW_MAX_LEN) ? ESP_NOW_MAX_LEN : len;
+        memcpy(delayedRx[idx].data, data, delayedRx[idx].len);
+        delayedRxCount++;
+    }
+    else
+    {
+        ESP_LOGW("WIFI", "Too many delayed packets, dropping one");
+    }
+}
+
 /**
  * Check the ESP NOW receive queue. If there are any received packets, send
  * them to hostEspNowRecvCb()
@@ -214,10 +300,20 @@ void checkEspNowRxQueue(void)
             if(0 != memcmp(recvMac, ourMac, sizeof(ourMac)))
             {
                 // If it does, send it to the application through the callback
-                hostEspNowRecvCb(recvMac, &recvString[21], recvStringLen - 21, 0);
+                emuRecvEspNow(recvMac, &recvString[21], recvStringLen - 21);
             }
         }
     }
+
+    // Deliver delayed packets which have waited long enough
+    int64_t tNowUs = esp_timer_get_time();
+    while((delayedRxCount > 0) && (delayedRx[delayedRxHead].deliverUs <= tNowUs))
+    {
+        hostEspNowRecvCb(delayedRx[delayedRxHead].mac, delayedRx[delayedRxHead].data,
+                         delayedRx[delayedRxHead].len, 0);
+        delayedRxHead = (delayedRxHead + 1) % DELAYED_RX_PACKETS;
+        delayedRxCount--;
+    }
 }
 
 /**
@@ -0,0 +1,9 @@
+#ifndef _EMU_WIFI_H_
+#define _EMU_WIFI_H_
+
+#include <stdint.h>
+
+void emuSetEspNowLatency(uint32_t latencyMs);
+void emuSetEspNowLoss(uint8_t lossPercent);
+
+#endif
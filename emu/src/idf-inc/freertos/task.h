@@ -13,9 +13,22 @@ typedef void (*TaskFunction_t)( void * );
 
 typedef unsigned portBASE_TYPE	UBaseType_t;
 
+typedef uint32_t TickType_t;
+
+#define pdFALSE ( ( BaseType_t ) 0 )
+#define pdTRUE  ( ( BaseType_t ) 1 )
+
+#define portMAX_DELAY ( TickType_t ) 0xffffffffUL
+#define portTICK_PERIOD_MS ( ( TickType_t ) 1 )
+#define pdMS_TO_TICKS( xTimeInMs ) ( ( TickType_t ) ( xTimeInMs ) / portTICK_PERIOD_MS )
+
 void taskYIELD(void);
 BaseType_t xTaskCreate( TaskFunction_t pvTaskCode, const char * const pcName,
     const uint32_t usStackDepth, void * const pvParameters, 
     UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask);
 
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+
 #endif
\ No newline at end of file
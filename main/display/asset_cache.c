@@ -0,0 +1,397 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <esp_log.h>
+
+#include "asset_cache.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+// Must be a power of two
+#define ASSET_CACHE_BUCKETS 32
+
+//==============================================================================
+// Enums
+//==============================================================================
+
+typedef enum
+{
+    ASSET_WSG,
+    ASSET_FONT,
+} assetType_t;
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct assetEntry
+{
+    struct assetEntry * nextInBucket;
+    struct assetEntry * newer; ///< The next more recently used entry
+    struct assetEntry * older; ///< The next less recently used entry
+    uint32_t hash;
+    assetType_t type;
+    uint32_t refs;
+    size_t bytes;
+    union
+    {
+        wsg_t wsg;
+        font_t font;
+    } asset;
+    char name[];
+} assetEntry_t;
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static assetEntry_t * buckets[ASSET_CACHE_BUCKETS] = {NULL};
+
+// The least recently used list, from newest to oldest
+static assetEntry_t * newest = NULL;
+static assetEntry_t * oldest = NULL;
+
+// The bytes held by entries which nothing references, bounded by the budget
+static size_t unusedBytes = 0;
+
+static assetCacheStats_t cacheStats = {0};
+
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+static uint32_t hashName(const char * name);
+static void * cacheAsset(assetType_t type, const char * name);
+static void releaseAsset(assetType_t type, const void * asset);
+static bool assetMatches(assetType_t type, const void * asset, assetEntry_t * entry);
+static void unlinkEntry(assetEntry_t * entry);
+static void linkNewest(assetEntry_t * entry);
+static void evictEntry(assetEntry_t * entry);
+static void evictToBudget(size_t budget);
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Hash an asset's name with 32 bit FNV-1a
+ *
+ * @param name The name to hash
+ * @return The hash
+ */
+static uint32_t hashName(const char * name)
+{
+    uint32_t hash = 2166136261u;
+    while('\0' != *name)
+    {
+        hash = (hash ^ (uint8_t)(*name++)) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Remove an entry from the least recently used list
+ *
+ * @param entry The entry to remove
+ */
+static void unlinkEntry(assetEntry_t * entry)
+{
+    if(NULL != entry->newer)
+    {
+        entry->newer->older = entry->older;
+    }
+    else
+    {
+        newest = entry->older;
+    }
+
+    if(NULL != entry->older)
+    {
+        entry->older->newer = entry->newer;
+    }
+    else
+    {
+        oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+/**
+ * @brief Add an entry to the front of the least recently used list
+ *
+ * @param entry The entry to add
+ */
+static void linkNewest(assetEntry_t * entry)
+{
+    entry->newer = NULL;
+    entry->older = newest;
+    if(NULL != newest)
+    {
+        newest->newer = entry;
+    }
+    newest = entry;
+    if(NULL == oldest)
+    {
+        oldest = entry;
+    }
+}
+
+/**
+ * @brief Free an unreferenced entry and the asset it holds
+ *
+ * @param entry The entry to free
+ */
+static void evictEntry(assetEntry_t * entry)
+{
+    // Remove it from its bucket
+    assetEntry_t ** link = &buckets[entry->hash & (ASSET_CACHE_BUCKETS - 1)];
+    while(*link != entry)
+    {
+        link = &(*link)->nextInBucket;
+    }
+    *link = entry->nextInBucket;
+
+    unlinkEntry(entry);
+    unusedBytes -= entry->bytes;
+    cacheStats.bytes -= entry->bytes;
+    cacheStats.entries--;
+    cacheStats.evictions++;
+
+    switch(entry->type)
+    {
+        case ASSET_WSG:
+        {
+            freeWsgData(&entry->asset.wsg);
+            break;
+        }
+        case ASSET_FONT:
+        {
+            freeFontData(&entry->asset.font);
+            break;
+        }
+    }
+    free(entry);
+}
+
+/**
+ * @brief Free the least recently used unreferenced entries until the
+ * unreferenced entries fit in a budget
+ *
+ * @param budget The number of bytes unreferenced entries may hold
+ */
+static void evictToBudget(size_t budget)
+{
+    assetEntry_t * entry = oldest;
+    while((unusedBytes > budget) && (NULL != entry))
+    {
+        assetEntry_t * newer = entry->newer;
+        if(0 == entry->refs)
+        {
+            evictEntry(entry);
+        }
+        entry = newer;
+    }
+}
+
+/**
+ * @brief Get a reference to an asset, loading it if it isn't cached already
+ *
+ * @param type The type of asset to get
+ * @param name The filename of the asset
+ * @return A pointer to the cached asset, or NULL if it couldn't be loaded
+ */
+static void * cacheAsset(assetType_t type, const char * name)
+{
+    uint32_t hash = hashName(name);
+    assetEntry_t ** bucket = &buckets[hash & (ASSET_CACHE_BUCKETS - 1)];
+
+    // Look for the asset in its bucket
+    for(assetEntry_t * entry = *bucket; NULL != entry; entry = entry->nextInBucket)
+    {
+        if((hash == entry->hash) && (type == entry->type) && (0 == strcmp(name, entry->name)))
+        {
+            if(0 == entry->refs)
+            {
+                unusedBytes -= entry->bytes;
+            }
+            entry->refs++;
+
+            // Mark it as the most recently used
+            unlinkEntry(entry);
+            linkNewest(entry);
+            cacheStats.hits++;
+            return &entry->asset;
+        }
+    }
+
+    // Not cached, so load it
+    assetEntry_t * entry = calloc(1, sizeof(assetEntry_t) + strlen(name) + 1);
+    if(NULL == entry)
+    {
+        ESP_LOGE("CACHE", "Couldn't allocate an entry for %s", name);
+        return NULL;
+    }
+    bool loaded = false;
+    switch(type)
+    {
+        case ASSET_WSG:
+        {
+            loaded = readWsg(name, &entry->asset.wsg, &entry->bytes);
+            break;
+        }
+        case ASSET_FONT:
+        {
+            loaded = readFont(name, &entry->asset.font, &entry->bytes);
+            break;
+        }
+    }
+    if(!loaded)
+    {
+        free(entry);
+        return NULL;
+    }
+
+    entry->hash = hash;
+    entry->type = type;
+    entry->refs = 1;
+    strcpy(entry->name, name);
+    entry->nextInBucket = *bucket;
+    *bucket = entry;
+    linkNewest(entry);
+
+    cacheStats.misses++;
+    cacheStats.entries++;
+    cacheStats.bytes += entry->bytes;
+    return &entry->asset;
+}
+
+/**
+ * @brief Check if an asset is the one in a cache entry, or a copy of it. Copies
+ * share the entry's memory, so the pointers to that memory are compared
+ *
+ * @param type The type of the asset
+ * @param asset A pointer to the asset
+ * @param entry The entry to compare to
+ * @return true if the asset is the entry's, false if it isn't
+ */
+static bool assetMatches(assetType_t type, const void * asset, assetEntry_t * entry)
+{
+    if(type != entry->type)
+    {
+        return false;
+    }
+
+    switch(type)
+    {
+        case ASSET_WSG:
+        {
+            const wsg_t * wsg = (const wsg_t *)asset;
+            return (wsg->px == entry->asset.wsg.px) && (wsg->rleRows == entry->asset.wsg.rleRows);
+        }
+        case ASSET_FONT:
+        {
+            const font_t * font = (const font_t *)asset;
+            return font->bitmaps == entry->asset.font.bitmaps;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Drop a reference to an asset. Unreferenced assets stay cached until
+ * they are pushed out by the budget
+ *
+ * @param type The type of asset to release
+ * @param asset A pointer to the cached asset, or a copy of it
+ */
+static void releaseAsset(assetType_t type, const void * asset)
+{
+    // Assets may be copied by value, so search for the entry. There are only a
+    // few dozen assets, and this happens when modes exit
+    for(assetEntry_t * entry = newest; NULL != entry; entry = entry->older)
+    {
+        if((0 < entry->refs) && assetMatches(type, asset, entry))
+        {
+            entry->refs--;
+            if(0 == entry->refs)
+            {
+                unusedBytes += entry->bytes;
+                evictToBudget(ASSET_CACHE_BUDGET);
+            }
+            return;
+        }
+    }
+    ESP_LOGE("CACHE", "Released an asset which isn't cached");
+}
+
+/**
+ * @brief Get a reference to a WSG through the asset cache, loading it if it
+ * isn't loaded already. The WSG is shared, so it must not be modified
+ *
+ * @param name The filename of the WSG
+ * @return A pointer to the WSG, or NULL if it couldn't be loaded. Must be
+ *         released with releaseWsg()
+ */
+wsg_t * cacheWsg(const char * name)
+{
+    return (wsg_t *)cacheAsset(ASSET_WSG, name);
+}
+
+/**
+ * @brief Release a reference to a WSG from cacheWsg() or loadWsg()
+ *
+ * @param wsg The WSG to release
+ */
+void releaseWsg(const wsg_t * wsg)
+{
+    releaseAsset(ASSET_WSG, wsg);
+}
+
+/**
+ * @brief Get a reference to a font through the asset cache, loading it if it
+ * isn't loaded already. The font is shared, so it must not be modified
+ *
+ * @param name The filename of the font
+ * @return A pointer to the font, or NULL if it couldn't be loaded. Must be
+ *         released with releaseFont()
+ */
+font_t * cacheFont(const char * name)
+{
+    return (font_t *)cacheAsset(ASSET_FONT, name);
+}
+
+/**
+ * @brief Release a reference to a font from cacheFont() or loadFont()
+ *
+ * @param font The font to release
+ */
+void releaseFont(const font_t * font)
+{
+    releaseAsset(ASSET_FONT, font);
+}
+
+/**
+ * @brief Free every cached asset which isn't referenced, i.e. before a large
+ * allocation
+ */
+void flushAssetCache(void)
+{
+    evictToBudget(0);
+}
+
+/**
+ * @brief Get the asset cache's statistics
+ *
+ * @param stats Returns the statistics
+ */
+void getAssetCacheStats(assetCacheStats_t * stats)
+{
+    *stats = cacheStats;
+}
@@ -0,0 +1,27 @@
+#ifndef _ASSET_CACHE_H_
+#define _ASSET_CACHE_H_
+
+#include "display.h"
+
+/* Unreferenced assets are kept loaded until they add up to this many bytes,
+ * then the least recently used ones are freed */
+#define ASSET_CACHE_BUDGET (32 * 1024)
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t entries;
+    size_t bytes;
+} assetCacheStats_t;
+
+wsg_t * cacheWsg(const char * name);
+void releaseWsg(const wsg_t * wsg);
+
+font_t * cacheFont(const char * name);
+void releaseFont(const font_t * font);
+
+void flushAssetCache(void);
+void getAssetCacheStats(assetCacheStats_t * stats);
+
+#endif
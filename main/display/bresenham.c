@@ -71,21 +71,33 @@ void oddEvenFill(display_t * disp, int x0, int y0, int x1, int y1,
     // Iterate over the bounding box
     for(int y = y0; y < y1; y++)
     {
+        // Read directly from the framebuffer if there is one
+        const paletteColor_t * row = (NULL != disp->pxFb) ?
+            &disp->pxFb[y * disp->pxStride] : NULL;
+
         // Assume starting outside the shape for each row
         bool isInside = false;
+        int spanStart = x0;
         for(int x = x0; x < x1; x++)
         {
             // If a boundary is hit
-            if(boundaryColor == disp->getPx(x, y))
+            if(boundaryColor == ((NULL != row) ? row[x] : disp->getPx(x, y)))
             {
-                // Flip this boolean, don't color the boundary
+                // Color the span up to the boundary, but not the boundary
+                if(isInside)
+                {
+                    fillDisplaySpan(disp, spanStart, x, y, fillColor);
+                }
+                // Flip this boolean
                 isInside = !isInside;
+                spanStart = x + 1;
             }
-            else if(isInside)
-            {
-                // If we're in-bounds, color the pixel
-                disp->setPx(x, y, fillColor);
-            }
+        }
+
+        // If we're still in-bounds at the edge, color the rest of the row
+        if(isInside)
+        {
+            fillDisplaySpan(disp, spanStart, x1, y, fillColor);
         }
     }
 }
@@ -243,10 +255,10 @@ void plotCircleFilled(display_t * disp, int xm, int ym, int r, paletteColor_t co
     int x = -r, y = 0, err = 2 - 2 * r; /* bottom left to top right */
     do
     {
-        for (int lineX = xm + x; lineX <= xm - x; lineX++)
+        fillDisplaySpan(disp, xm + x, xm - x + 1, ym - y, col);
+        if(0 != y)
         {
-            disp->setPx(lineX, ym - y, col);
-            disp->setPx(lineX, ym + y, col);
+            fillDisplaySpan(disp, xm + x, xm - x + 1, ym + y, col);
         }
 
         r = err;
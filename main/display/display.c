@@ -8,6 +8,7 @@
 #include <esp_log.h>
 
 #include "display.h"
+#include "asset_cache.h"
 #include "heatshrink_decoder.h"
 
 #include "../../components/hdw-spiffs/spiffs_manager.h"
@@ -18,6 +19,11 @@
 
 #define CLAMP(x,l,u) ((x) < l ? l : ((x) > u ? u : (x)))
 
+// Note that a row was written to, if the display tracks that
+#define MARK_ROW_DIRTY(disp, y) do { \
+        if(NULL != (disp)->dirtyRows) { (disp)->dirtyRows[y] = 1; } \
+    } while(0)
+
 //==============================================================================
 // Constant data
 //==============================================================================
@@ -54,46 +60,31 @@ const uint32_t sin1024[] =
     -36, -18
 };
 
-const uint32_t tan1024[] =
-{
-    0, 18, 36, 54, 72, 90, 108, 126, 144, 162, 181, 199, 218, 236, 255, 274, 294,
-    313, 333, 353, 373, 393, 414, 435, 456, 477, 499, 522, 544, 568, 591, 615,
-    640, 665, 691, 717, 744, 772, 800, 829, 859, 890, 922, 955, 989, 1024, 1060,
-    1098, 1137, 1178, 1220, 1265, 1311, 1359, 1409, 1462, 1518, 1577, 1639, 1704,
-    1774, 1847, 1926, 2010, 2100, 2196, 2300, 2412, 2534, 2668, 2813, 2974,
-    3152, 3349, 3571, 3822, 4107, 4435, 4818, 5268, 5807, 6465, 7286, 8340, 9743,
-    11704, 14644, 19539, 29324, 58665, 67108863, -58665, -29324, -19539, -14644,
-    -11704, -9743, -8340, -7286, -6465, -5807, -5268, -4818, -4435, -4107, -3822,
-    -3571, -3349, -3152, -2974, -2813, -2668, -2534, -2412, -2300, -2196, -2100,
-    -2010, -1926, -1847, -1774, -1704, -1639, -1577, -1518, -1462, -1409,
-    -1359, -1311, -1265, -1220, -1178, -1137, -1098, -1060, -1024, -989, -955,
-    -922, -890, -859, -829, -800, -772, -744, -717, -691, -665, -640, -615, -591,
-    -568, -544, -522, -499, -477, -456, -435, -414, -393, -373, -353, -333, -313,
-    -294, -274, -255, -236, -218, -199, -181, -162, -144, -126, -108, -90, -72,
-    -54, -36, -18, 0, 18, 36, 54, 72, 90, 108, 126, 144, 162, 181, 199, 218,
-    236, 255, 274, 294, 313, 333, 353, 373, 393, 414, 435, 456, 477, 499, 522,
-    544, 568, 591, 615, 640, 665, 691, 717, 744, 772, 800, 829, 859, 890, 922, 955,
-    989, 1024, 1060, 1098, 1137, 1178, 1220, 1265, 1311, 1359, 1409, 1462,
-    1518, 1577, 1639, 1704, 1774, 1847, 1926, 2010, 2100, 2196, 2300, 2412, 2534,
-    2668, 2813, 2974, 3152, 3349, 3571, 3822, 4107, 4435, 4818, 5268, 5807, 6465,
-    7286, 8340, 9743, 11704, 14644, 19539, 29324, 58665, 67108863, -58665, -29324,
-    -19539, -14644, -11704, -9743, -8340, -7286, -6465, -5807, -5268, -4818,
-    -4435, -4107, -3822, -3571, -3349, -3152, -2974, -2813, -2668, -2534, -2412,
-    -2300, -2196, -2100, -2010, -1926, -1847, -1774, -1704, -1639, -1577, -1518,
-    -1462, -1409, -1359, -1311, -1265, -1220, -1178, -1137, -1098, -1060, -1024,
-    -989, -955, -922, -890, -859, -829, -800, -772, -744, -717, -691, -665,
-    -640, -615, -591, -568, -544, -522, -499, -477, -456, -435, -414, -393, -373,
-    -353, -333, -313, -294, -274, -255, -236, -218, -199, -181, -162, -144, -126,
-    -108, -90, -72, -54, -36, -18
-};
+//==============================================================================
+// Variables
+//==============================================================================
+
+// One decoder is reused for every WSG load
+static heatshrink_decoder * wsgDecoder = NULL;
 
 //==============================================================================
 // Function Prototypes
 //==============================================================================
 
-void transformPixel(int16_t* x, int16_t* y, int16_t transX,
-                    int16_t transY, bool flipLR, bool flipUD,
-                    int16_t rotateDeg, int16_t width, int16_t height);
+static void copyOpaqueRuns(paletteColor_t * dst, const paletteColor_t * src,
+    int32_t len);
+static uint32_t decodeWsgBytes(heatshrink_decoder * hsd, const uint8_t * in,
+    uint32_t inLen, uint32_t * inIdx, uint8_t * out, uint32_t outLen);
+static bool indexWsgRle(wsg_t * wsg, uint32_t len);
+static void drawWsgUnrotated(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD);
+static void drawWsgRle(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD);
+static paletteColor_t getWsgRlePx(const wsg_t * wsg, int32_t x, int32_t y);
+static void drawWsgRotated(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD, int16_t rotateDeg);
+static void drawBitmap(display_t * disp, paletteColor_t color, const uint8_t * bits,
+    uint16_t rowBytes, int16_t w, int16_t h, int16_t xOff, int16_t yOff);
 
 //==============================================================================
 // Functions
@@ -117,21 +108,170 @@ void fillDisplayArea(display_t * disp, int16_t x1, int16_t y1, int16_t x2,
     int16_t xMax = CLAMP(x2, 0, disp->w);
     int16_t yMin = CLAMP(y1, 0, disp->h);
     int16_t yMax = CLAMP(y2, 0, disp->h);
-    
-    // Set each pixel
-    for (int y = yMin; y < yMax; y++)
+
+    // Fill each row
+    for (int16_t y = yMin; y < yMax; y++)
+    {
+        fillDisplaySpan(disp, xMin, xMax, y, c);
+    }
+}
+
+/**
+ * @brief Fill a horizontal span of pixels on a single row with a single color.
+ * The span is clipped to the display once, then written directly to the
+ * framebuffer if the display has one
+ *
+ * @param disp The display to fill a span on
+ * @param x1 The x coordinate to start the fill (inclusive)
+ * @param x2 The x coordinate to stop the fill (exclusive)
+ * @param y  The row to fill
+ * @param c  The color to fill
+ */
+void fillDisplaySpan(display_t * disp, int16_t x1, int16_t x2, int16_t y,
+    paletteColor_t c)
+{
+    // Don't draw transparent or offscreen pixels
+    if((cTransparent == c) || (y < 0) || (y >= disp->h))
+    {
+        return;
+    }
+
+    // Clip the span to the display
+    if(x1 < 0)
     {
-        for (int x = xMin; x < xMax; x++)
+        x1 = 0;
+    }
+    if(x2 > disp->w)
+    {
+        x2 = disp->w;
+    }
+    if(x1 >= x2)
+    {
+        return;
+    }
+
+    if(NULL != disp->pxFb)
+    {
+        MARK_ROW_DIRTY(disp, y);
+        // paletteColor_t is a packed one-byte enum, so memset() works
+        memset(&disp->pxFb[(y * disp->pxStride) + x1], c, x2 - x1);
+    }
+    else
+    {
+        for(int16_t x = x1; x < x2; x++)
         {
             disp->setPx(x, y, c);
         }
     }
 }
 
+/**
+ * @brief Copy a row of pixels to a display, including transparent ones. The
+ * row is clipped to the display once, then copied directly to the framebuffer
+ * if the display has one
+ *
+ * @param disp The display to copy pixels to
+ * @param xOff The x coordinate to copy the first pixel to
+ * @param y    The row to copy pixels to
+ * @param src  The pixels to copy
+ * @param len  The number of pixels to copy
+ */
+void blitDisplayRow(display_t * disp, int16_t xOff, int16_t y,
+    const paletteColor_t * src, uint16_t len)
+{
+    // Don't draw offscreen rows
+    if((y < 0) || (y >= disp->h))
+    {
+        return;
+    }
+
+    // Clip the row to the display
+    int32_t x1 = xOff;
+    int32_t x2 = xOff + len;
+    if(x1 < 0)
+    {
+        src -= x1;
+        x1 = 0;
+    }
+    if(x2 > disp->w)
+    {
+        x2 = disp->w;
+    }
+    if(x1 >= x2)
+    {
+        return;
+    }
+
+    if(NULL != disp->pxFb)
+    {
+        MARK_ROW_DIRTY(disp, y);
+        memcpy(&disp->pxFb[(y * disp->pxStride) + x1], src, x2 - x1);
+    }
+    else
+    {
+        for(int32_t x = x1; x < x2; x++)
+        {
+            disp->setPx(x, y, *(src++));
+        }
+    }
+}
+
+/**
+ * @brief Copy a row of pixels to a display, skipping transparent ones. The
+ * row is clipped to the display once, then opaque pixels are copied directly to
+ * the framebuffer if the display has one
+ *
+ * @param disp The display to copy pixels to
+ * @param xOff The x coordinate to copy the first pixel to
+ * @param y    The row to copy pixels to
+ * @param src  The pixels to copy
+ * @param len  The number of pixels to copy
+ */
+void blitDisplayRowMasked(display_t * disp, int16_t xOff, int16_t y,
+    const paletteColor_t * src, uint16_t len)
+{
+    // Don't draw offscreen rows
+    if((y < 0) || (y >= disp->h))
+    {
+        return;
+    }
+
+    // Clip the row to the display
+    int32_t x1 = xOff;
+    int32_t x2 = xOff + len;
+    if(x1 < 0)
+    {
+        src -= x1;
+        x1 = 0;
+    }
+    if(x2 > disp->w)
+    {
+        x2 = disp->w;
+    }
+    if(x1 >= x2)
+    {
+        return;
+    }
+
+    if(NULL != disp->pxFb)
+    {
+        MARK_ROW_DIRTY(disp, y);
+        copyOpaqueRuns(&disp->pxFb[(y * disp->pxStride) + x1], src, x2 - x1);
+    }
+    else
+    {
+        for(int32_t x = x1; x < x2; x++)
+        {
+            disp->setPx(x, y, *(src++));
+        }
+    }
+}
+
 /**
  * @brief Load a WSG from ROM to RAM. WSGs placed in the spiffs_image folder
- * before compilation will be automatically flashed to ROM 
- * 
+ * before compilation will be automatically flashed to ROM. WSGs are shared
+ * through the asset cache, so loading one which is already loaded is free
+ *
  * @param name The filename of the WSG to load
  * @param wsg  A handle to load the WSG to
  * @return true if the WSG was loaded successfully,
@@ -139,163 +279,563 @@ void fillDisplayArea(display_t * disp, int16_t x1, int16_t y1, int16_t x2,
  */
 bool loadWsg(char * name, wsg_t * wsg)
 {
-    // Read WSG from file
-    uint8_t * buf = NULL;
-    size_t sz;
-    if(!spiffsReadFile(name, &buf, &sz))
+    wsg_t * cached = cacheWsg(name);
+    if(NULL == cached)
     {
-        ESP_LOGE("WSG", "Failed to read %s", name);
         return false;
     }
+    *wsg = *cached;
+    return true;
+}
 
-    // Pick out the decompresed size and create a space for it
-    uint16_t decompressedSize = (buf[0] << 8) | buf[1];
-    uint8_t decompressedBuf[decompressedSize];
+/**
+ * @brief Read and decode a WSG from ROM to RAM, bypassing the asset cache. The
+ * WSG must be freed with freeWsgData()
+ *
+ * @param name  The filename of the WSG to read
+ * @param wsg   A handle to read the WSG to
+ * @param dataSize If not NULL, the size of the decoded WSG is returned through this
+ * @return true if the WSG was read successfully,
+ *         false if the WSG read failed and should not be used
+ */
+bool readWsg(const char * name, wsg_t * wsg, size_t * dataSize)
+{
+    // Map the compressed WSG, it is decoded straight out of the mapping
+    spiffsMap_t map;
+    if(!spiffsMapFile(name, &map))
+    {
+        ESP_LOGE("WSG", "Failed to read %s", name);
+        return false;
+    }
+    const uint8_t * buf = map.data;
+    size_t sz = map.size;
 
-    // Create the decoder
-    size_t copied = 0;
-    heatshrink_decoder * hsd = heatshrink_decoder_alloc(256, 8, 4);
-    heatshrink_decoder_reset(hsd);
+    // Pick out the decompresed size, which must at least fit the dimensions
+    uint16_t decompressedSize = (sz < 2) ? 0 : ((buf[0] << 8) | buf[1]);
+    if(decompressedSize < 4)
+    {
+        ESP_LOGE("WSG", "Invalid size in %s", name);
+        spiffsUnmapFile(&map);
+        return false;
+    }
 
-    // Decode the file in chunks
-    uint32_t inputIdx = 0;
-    uint32_t outputIdx = 0;
-    while(inputIdx < (sz-2))
+    // Create the decoder once, then reuse it for every load
+    if(NULL == wsgDecoder)
     {
-        // Decode some data
-        copied = 0;
-        heatshrink_decoder_sink(hsd, &buf[2 + inputIdx], sz - 2 - inputIdx, &copied);
-        inputIdx += copied;
+        wsgDecoder = heatshrink_decoder_alloc(256, 8, 4);
+        if(NULL == wsgDecoder)
+        {
+            ESP_LOGE("WSG", "Couldn't allocate a decoder for %s", name);
+            spiffsUnmapFile(&map);
+            return false;
+        }
+    }
+    heatshrink_decoder_reset(wsgDecoder);
 
-        // Save it to the output array
-        copied = 0;
-        heatshrink_decoder_poll(hsd, &decompressedBuf[outputIdx], sizeof(decompressedBuf) - outputIdx, &copied);
-        outputIdx += copied;
+    // Decode just the four byte dimension header first
+    uint32_t inputIdx = 2;
+    uint8_t hdr[4];
+    if(sizeof(hdr) != decodeWsgBytes(wsgDecoder, buf, sz, &inputIdx, hdr, sizeof(hdr)))
+    {
+        ESP_LOGE("WSG", "Failed to decode %s", name);
+        spiffsUnmapFile(&map);
+        return false;
     }
+    uint16_t wHdr = (hdr[0] << 8) | hdr[1];
+    wsg->w = wHdr & ~WSG_RLE_FLAG;
+    wsg->h = (hdr[2] << 8) | hdr[3];
 
-    // Note that it's all done
-    heatshrink_decoder_finish(hsd);
+    // The rest of the bytes are pixels, either run-length encoded or not.
+    // Allocate the final buffer and decode straight into it
+    uint32_t pxLen = decompressedSize - sizeof(hdr);
+    uint8_t * pxBuf;
+    if(wHdr & WSG_RLE_FLAG)
+    {
+        // Row indices and the encoded rows are allocated together
+        wsg->px = NULL;
+        wsg->rleRows = (uint32_t *)malloc((sizeof(uint32_t) * wsg->h) + pxLen);
+        if(NULL == wsg->rleRows)
+        {
+            ESP_LOGE("WSG", "Couldn't allocate %s", name);
+            wsg->rle = NULL;
+            spiffsUnmapFile(&map);
+            return false;
+        }
+        wsg->rle = (uint8_t *)&wsg->rleRows[wsg->h];
+        pxBuf = wsg->rle;
+    }
+    else
+    {
+        wsg->rleRows = NULL;
+        wsg->rle = NULL;
+        wsg->px = (paletteColor_t *)malloc(sizeof(paletteColor_t) * wsg->w * wsg->h);
+        if(NULL == wsg->px)
+        {
+            ESP_LOGE("WSG", "Couldn't allocate %s", name);
+            spiffsUnmapFile(&map);
+            return false;
+        }
+        pxBuf = (uint8_t *)wsg->px;
+        pxLen = sizeof(paletteColor_t) * wsg->w * wsg->h;
+    }
+    uint32_t decoded = decodeWsgBytes(wsgDecoder, buf, sz, &inputIdx, pxBuf, pxLen);
 
-    // Flush any final output
-    copied = 0;
-    heatshrink_decoder_poll(hsd, &decompressedBuf[outputIdx], sizeof(decompressedBuf) - outputIdx, &copied);
-    outputIdx += copied;
+    // Done with the compressed data
+    spiffsUnmapFile(&map);
 
-    // All done decoding
-    heatshrink_decoder_finish(hsd);
-    heatshrink_decoder_free(hsd);
+    if((decoded != pxLen) || ((NULL != wsg->rle) && !indexWsgRle(wsg, pxLen)))
+    {
+        ESP_LOGE("WSG", "Failed to decode %s", name);
+        freeWsgData(wsg);
+        wsg->px = NULL;
+        wsg->rleRows = NULL;
+        wsg->rle = NULL;
+        return false;
+    }
 
-    // Save the decompressed info to the wsg. The first four bytes are dimension
-    wsg->w = (decompressedBuf[0] << 8) | decompressedBuf[1];
-    wsg->h = (decompressedBuf[2] << 8) | decompressedBuf[3];
-    // The rest of the bytes are pixels
-    wsg->px = (paletteColor_t *)malloc(sizeof(paletteColor_t) * wsg->w * wsg->h);
-    memcpy(wsg->px, &decompressedBuf[4], outputIdx - 4);
+    if(NULL != dataSize)
+    {
+        *dataSize = (NULL != wsg->rleRows) ? ((sizeof(uint32_t) * wsg->h) + pxLen) : pxLen;
+    }
 
     // all done
     return true;
 }
 
 /**
- * @brief Free the memory for a loaded WSG
- * 
- * @param wsg The WSG to free memory from
+ * @brief Decompress bytes from a WSG file until the output buffer is full or
+ * the input runs out. The decoder keeps its state between calls, so this can
+ * be called repeatedly to decode a file into different buffers
+ *
+ * @param hsd The decoder to use
+ * @param in The compressed file
+ * @param inLen The length of the compressed file
+ * @param inIdx The index of the next byte to sink, updated as bytes are sunk
+ * @param out The buffer to decompress to
+ * @param outLen The number of bytes to decompress
+ * @return The number of bytes decompressed to out
+ */
+static uint32_t decodeWsgBytes(heatshrink_decoder * hsd, const uint8_t * in,
+    uint32_t inLen, uint32_t * inIdx, uint8_t * out, uint32_t outLen)
+{
+    uint32_t outIdx = 0;
+    bool finished = false;
+    while(outIdx < outLen)
+    {
+        // Drain any pending output first
+        size_t copied = 0;
+        HSD_poll_res pRes = heatshrink_decoder_poll(hsd, &out[outIdx], outLen - outIdx, &copied);
+        outIdx += copied;
+        if(pRes < 0)
+        {
+            break;
+        }
+        else if(HSDR_POLL_EMPTY == pRes)
+        {
+            if((*inIdx) < inLen)
+            {
+                // Sink more input. The decoder doesn't modify it
+                copied = 0;
+                if(heatshrink_decoder_sink(hsd, (uint8_t *)&in[*inIdx], inLen - (*inIdx), &copied) < 0)
+                {
+                    break;
+                }
+                (*inIdx) += copied;
+            }
+            else if(finished || (HSDR_FINISH_DONE == heatshrink_decoder_finish(hsd)))
+            {
+                // Out of input and output
+                break;
+            }
+            else
+            {
+                // Poll the last output, but don't finish twice
+                finished = true;
+            }
+        }
+    }
+    return outIdx;
+}
+
+/**
+ * @brief Find where each row of a run-length encoded WSG starts. The encoding
+ * is validated along the way so drawing doesn't need to
+ *
+ * @param wsg The WSG to index, w, h, rleRows, and rle must be set already
+ * @param len The length of the run-length encoded pixels
+ * @return true if the encoding was valid, false if it was not
+ */
+static bool indexWsgRle(wsg_t * wsg, uint32_t len)
+{
+    uint32_t idx = 0;
+    for(uint16_t y = 0; y < wsg->h; y++)
+    {
+        wsg->rleRows[y] = idx;
+        uint32_t x = 0;
+        while(x < wsg->w)
+        {
+            // Read a (skip, run) pair and step over the run's pixels
+            if(idx + 2 > len)
+            {
+                break;
+            }
+            uint8_t run = wsg->rle[idx + 1];
+            x += wsg->rle[idx] + run;
+            idx += 2 + run;
+        }
+
+        // Each row must be exactly as wide as the image
+        if((x != wsg->w) || (idx > len))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Release a WSG loaded with loadWsg(). Its memory is kept in the asset
+ * cache in case it's loaded again
+ *
+ * @param wsg The WSG to release
  */
 void freeWsg(wsg_t * wsg)
+{
+    releaseWsg(wsg);
+}
+
+/**
+ * @brief Free the memory for a WSG read with readWsg()
+ *
+ * @param wsg The WSG to free memory from
+ */
+void freeWsgData(wsg_t * wsg)
 {
     free(wsg->px);
+    free(wsg->rleRows);
 }
 
 /**
- * Transform a pixel's coordinates by rotation around the sprite's center point,
- * then reflection over Y axis, then reflection over X axis, then translation
+ * @brief Copy pixels from one buffer to another, skipping transparent ones.
+ * Opaque pixels are found in runs and each run is copied with memcpy()
  *
- * This intentionally does not have ICACHE_FLASH_ATTR because it may be called often
+ * @param dst The buffer to copy pixels to
+ * @param src The buffer to copy pixels from
+ * @param len The number of pixels to copy
+ */
+static void copyOpaqueRuns(paletteColor_t * dst, const paletteColor_t * src,
+    int32_t len)
+{
+    int32_t i = 0;
+    while(i < len)
+    {
+        // Skip over transparent pixels
+        while((i < len) && (cTransparent == src[i]))
+        {
+            i++;
+        }
+
+        // Find the end of the opaque run
+        int32_t runStart = i;
+        while((i < len) && (cTransparent != src[i]))
+        {
+            i++;
+        }
+
+        // Copy the run
+        if(i > runStart)
+        {
+            memcpy(&dst[runStart], &src[runStart], i - runStart);
+        }
+    }
+}
+
+/**
+ * @brief Draw a WSG to the display without rotation. The sprite's rectangle is
+ * clipped against the display once, then each visible row is copied with
+ * dedicated loops for each flip
  *
- * @param x The x coordinate of the pixel location to transform
- * @param y The y coordinate of the pixel location to trasform
- * @param transX The number of pixels to translate X by
- * @param transY The number of pixels to translate Y by
- * @param flipLR true to flip over the Y axis, false to do nothing
- * @param flipUD true to flip over the X axis, false to do nothing
- * @param rotateDeg The number of degrees to rotate clockwise, must be 0-359
- * @param width  The width of the image
- * @param height The height of the image
+ * @param disp The display to draw the WSG to
+ * @param wsg  The WSG to draw to the display
+ * @param xOff The x offset to draw the WSG at
+ * @param yOff The y offset to draw the WSG at
+ * @param flipLR true to flip the image across the Y axis
+ * @param flipUD true to flip the image across the X axis
  */
-void transformPixel(int16_t* x, int16_t* y, int16_t transX,
-                    int16_t transY, bool flipLR, bool flipUD,
-                    int16_t rotateDeg, int16_t width, int16_t height)
+static void drawWsgUnrotated(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD)
 {
-    // First rotate the sprite around the sprite's center point
-    if (0 < rotateDeg && rotateDeg < 360)
+    // Clip the sprite's rectangle against the display
+    int32_t dx0 = CLAMP(xOff, 0, disp->w);
+    int32_t dx1 = CLAMP(xOff + wsg->w, 0, disp->w);
+    int32_t dy0 = CLAMP(yOff, 0, disp->h);
+    int32_t dy1 = CLAMP(yOff + wsg->h, 0, disp->h);
+    if((dx0 >= dx1) || (dy0 >= dy1))
     {
-        // This solves the aliasing problem, but because of tan() it's only safe
-        // to rotate by 0 to 90 degrees. So rotate by a multiple of 90 degrees
-        // first, which doesn't need trig, then rotate the rest with shears
-        // See http://datagenetics.com/blog/august32013/index.html
-        // See https://graphicsinterface.org/wp-content/uploads/gi1986-15.pdf
+        return;
+    }
 
-        // Center around (0, 0)
-        (*x) -= (width / 2);
-        (*y) -= (height / 2);
+    int32_t len = dx1 - dx0;
+    for(int32_t dy = dy0; dy < dy1; dy++)
+    {
+        // Find the source row for this destination row
+        int32_t srcY = dy - yOff;
+        if(flipUD)
+        {
+            srcY = wsg->h - 1 - srcY;
+        }
+        const paletteColor_t * srcRow = &wsg->px[srcY * wsg->w];
+        MARK_ROW_DIRTY(disp, dy);
 
-        // First rotate to the nearest 90 degree boundary, which is trivial
-        if(rotateDeg >= 270)
+        if(NULL == disp->pxFb)
         {
-            // (x, y) -> (y, -x)
-            int16_t tmp = (*x);
-            (*x) = (*y);
-            (*y) = -tmp;
+            // No framebuffer, so set each pixel
+            for(int32_t dx = dx0; dx < dx1; dx++)
+            {
+                int32_t srcX = dx - xOff;
+                disp->setPx(dx, dy, srcRow[flipLR ? (wsg->w - 1 - srcX) : srcX]);
+            }
         }
-        else if(rotateDeg >= 180)
+        else if(!flipLR)
         {
-            // (x, y) -> (-x, -y)
-            (*x) = -(*x);
-            (*y) = -(*y);
+            // Copy opaque runs forwards
+            copyOpaqueRuns(&disp->pxFb[(dy * disp->pxStride) + dx0],
+                &srcRow[dx0 - xOff], len);
         }
-        else if(rotateDeg >= 90)
+        else
         {
-            // (x, y) -> (-y, x)
-            int16_t tmp = (*x);
-            (*x) = -(*y);
-            (*y) = tmp;
+            // Copy opaque pixels backwards
+            paletteColor_t * dst = &disp->pxFb[(dy * disp->pxStride) + dx0];
+            const paletteColor_t * src = &srcRow[wsg->w - 1 - (dx0 - xOff)];
+            for(int32_t i = 0; i < len; i++)
+            {
+                if(cTransparent != *src)
+                {
+                    dst[i] = *src;
+                }
+                src--;
+            }
         }
-        // Now that it's rotated to a 90 degree boundary, find out how much more
-        // there is to rotate by shearing
-        rotateDeg = rotateDeg % 90;
+    }
+}
 
-        // If there's any more to rotate, apply three shear matrices in order
-        // if(rotateDeg > 1 && rotateDeg < 89)
-        if(rotateDeg > 0)
+/**
+ * @brief Draw a run-length encoded WSG to the display without rotation. Rows
+ * are clipped against the display once, transparent spans are skipped
+ * wholesale, and each opaque run is clipped and copied
+ *
+ * @param disp The display to draw the WSG to
+ * @param wsg  The WSG to draw to the display
+ * @param xOff The x offset to draw the WSG at
+ * @param yOff The y offset to draw the WSG at
+ * @param flipLR true to flip the image across the Y axis
+ * @param flipUD true to flip the image across the X axis
+ */
+static void drawWsgRle(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD)
+{
+    // Clip the sprite's rows against the display
+    int32_t dy0 = CLAMP(yOff, 0, disp->h);
+    int32_t dy1 = CLAMP(yOff + wsg->h, 0, disp->h);
+    if((dy0 >= dy1) || (xOff >= disp->w) || (xOff + wsg->w <= 0))
+    {
+        return;
+    }
+
+    for(int32_t dy = dy0; dy < dy1; dy++)
+    {
+        // Find the source row for this destination row
+        int32_t srcY = dy - yOff;
+        if(flipUD)
         {
-            // 1st shear
-            (*x) = (*x) - (((*y) * tan1024[rotateDeg / 2]) + 512) / 1024;
-            // 2nd shear
-            (*y) = (((*x) * sin1024[rotateDeg]) + 512) / 1024 + (*y);
-            // 3rd shear
-            (*x) = (*x) - (((*y) * tan1024[rotateDeg / 2]) + 512) / 1024;
+            srcY = wsg->h - 1 - srcY;
         }
+        const uint8_t * rp = &wsg->rle[wsg->rleRows[srcY]];
+        paletteColor_t * dstRow = (NULL != disp->pxFb) ?
+            &disp->pxFb[dy * disp->pxStride] : NULL;
+        MARK_ROW_DIRTY(disp, dy);
+
+        int32_t srcX = 0;
+        while(srcX < wsg->w)
+        {
+            // Skip the transparent pixels, then find the opaque run
+            srcX += *(rp++);
+            int32_t run = *(rp++);
+            const paletteColor_t * src = (const paletteColor_t *)rp;
+            rp += run;
+
+            // Find where the run lands on the display
+            int32_t dstX = flipLR ? (xOff + wsg->w - srcX - run) : (xOff + srcX);
+            srcX += run;
+
+            // Clip the run against the display
+            int32_t start = (dstX < 0) ? -dstX : 0;
+            int32_t end = (dstX + run > disp->w) ? (disp->w - dstX) : run;
+            if(start >= end)
+            {
+                // If this run is past the right edge, the rest are too
+                if(!flipLR && (dstX >= disp->w))
+                {
+                    break;
+                }
+                continue;
+            }
 
-        // Return pixel to original position
-        (*x) = (*x) + (width / 2);
-        (*y) = (*y) + (height / 2);
+            if(!flipLR && (NULL != dstRow))
+            {
+                memcpy(&dstRow[dstX + start], &src[start], end - start);
+            }
+            else
+            {
+                // Flipped runs are copied backwards, one pixel at a time
+                for(int32_t i = start; i < end; i++)
+                {
+                    paletteColor_t px = flipLR ? src[run - 1 - i] : src[i];
+                    if(NULL != dstRow)
+                    {
+                        dstRow[dstX + i] = px;
+                    }
+                    else
+                    {
+                        disp->setPx(dstX + i, dy, px);
+                    }
+                }
+            }
+        }
     }
+}
 
-    // Then reflect over Y axis
-    if (flipLR)
+/**
+ * @brief Get one pixel of a run-length encoded WSG. The row is found through
+ * rleRows, then its runs are walked up to the pixel
+ *
+ * @param wsg The run-length encoded WSG to get a pixel from
+ * @param x The x coordinate of the pixel, must be in the WSG
+ * @param y The y coordinate of the pixel, must be in the WSG
+ * @return The pixel's color, cTransparent if it's skipped
+ */
+static paletteColor_t getWsgRlePx(const wsg_t * wsg, int32_t x, int32_t y)
+{
+    const uint8_t * rp = &wsg->rle[wsg->rleRows[y]];
+    int32_t runX = 0;
+    while(true)
     {
-        (*x) = width - 1 - (*x);
+        // Skipped pixels are transparent
+        runX += rp[0];
+        if(x < runX)
+        {
+            return cTransparent;
+        }
+
+        // Otherwise check if the pixel is in this run
+        uint8_t run = rp[1];
+        if(x < runX + run)
+        {
+            return rp[2 + x - runX];
+        }
+        runX += run;
+        rp += 2 + run;
     }
+}
 
-    // Then reflect over X axis
-    if(flipUD)
+/**
+ * @brief Draw a WSG to the display with rotation. Rather than transforming each
+ * source pixel, which leaves holes, this iterates over every destination pixel
+ * in the rotated sprite's clipped bounding box and maps it back to a source
+ * pixel. The mapping is stepped incrementally in 10 bit fixed point across each
+ * row. Run-length encoded WSGs are read in place, a row at a time through
+ * rleRows
+ *
+ * @param disp The display to draw the WSG to
+ * @param wsg  The WSG to draw to the display
+ * @param xOff The x offset to draw the WSG at
+ * @param yOff The y offset to draw the WSG at
+ * @param flipLR true to flip the image across the Y axis
+ * @param flipUD true to flip the image across the X axis
+ * @param rotateDeg The number of degrees to rotate clockwise, must be 1-359
+ */
+static void drawWsgRotated(display_t * disp, wsg_t *wsg, int16_t xOff,
+    int16_t yOff, bool flipLR, bool flipUD, int16_t rotateDeg)
+{
+    int32_t w = wsg->w;
+    int32_t h = wsg->h;
+    int32_t sinR = (int32_t)sin1024[rotateDeg];
+    int32_t cosR = (int32_t)sin1024[(rotateDeg + 90) % 360];
+
+    // Find the rotated sprite's bounding box, which is centered on the sprite's
+    // center no matter how it's flipped. Pad it by a pixel for rounding
+    int32_t bbW = ((w * abs(cosR)) + (h * abs(sinR)) + 1023) / 1024;
+    int32_t bbH = ((w * abs(sinR)) + (h * abs(cosR)) + 1023) / 1024;
+    int32_t u0 = ((w - bbW) / 2) - 1;
+    int32_t v0 = ((h - bbH) / 2) - 1;
+
+    // Clip the bounding box against the display
+    int32_t dx0 = CLAMP(xOff + u0, 0, disp->w);
+    int32_t dx1 = CLAMP(xOff + u0 + bbW + 2, 0, disp->w);
+    int32_t dy0 = CLAMP(yOff + v0, 0, disp->h);
+    int32_t dy1 = CLAMP(yOff + v0 + bbH + 2, 0, disp->h);
+    if((dx0 >= dx1) || (dy0 >= dy1))
     {
-        (*y) = height - 1 - (*y);
+        return;
     }
 
-    // Then translate
-    (*x) += transX;
-    (*y) += transY;
+    /* Coordinates relative to the sprite's center are doubled so that pixel
+     * centers are integers, i.e. pixel u is at (2u + 1 - w). Moving one pixel
+     * right on the display moves two units, or backwards if flipped
+     */
+    int32_t stepDu = flipLR ? -2 : 2;
+    for(int32_t dy = dy0; dy < dy1; dy++)
+    {
+        MARK_ROW_DIRTY(disp, dy);
+
+        // Undo the translation and flips for the first pixel in this row
+        int32_t v = dy - yOff;
+        if(flipUD)
+        {
+            v = h - 1 - v;
+        }
+        int32_t u = dx0 - xOff;
+        if(flipLR)
+        {
+            u = w - 1 - u;
+        }
+        int32_t du = (2 * u) + 1 - w;
+        int32_t dv = (2 * v) + 1 - h;
+
+        // Undo the clockwise rotation, then shift to the sprite's corner
+        int32_t sx = (du * cosR) + (dv * sinR) + (w * 1024);
+        int32_t sy = (dv * cosR) - (du * sinR) + (h * 1024);
+        int32_t stepSx = stepDu * cosR;
+        int32_t stepSy = -stepDu * sinR;
+
+        for(int32_t dx = dx0; dx < dx1; dx++)
+        {
+            // Convert back from doubled fixed point to a source pixel
+            if(0 <= sx && 0 <= sy)
+            {
+                int32_t srcX = sx / 2048;
+                int32_t srcY = sy / 2048;
+                if(srcX < w && srcY < h)
+                {
+                    paletteColor_t px = (NULL != wsg->px) ? wsg->px[(srcY * w) + srcX] :
+                                        getWsgRlePx(wsg, srcX, srcY);
+                    if(cTransparent != px)
+                    {
+                        if(NULL != disp->pxFb)
+                        {
+                            disp->pxFb[(dy * disp->pxStride) + dx] = px;
+                        }
+                        else
+                        {
+                            disp->setPx(dx, dy, px);
+                        }
+                    }
+                }
+            }
+            sx += stepSx;
+            sy += stepSy;
+        }
+    }
 }
 
 /**
@@ -312,31 +852,32 @@ void transformPixel(int16_t* x, int16_t* y, int16_t transX,
 void drawWsg(display_t * disp, wsg_t *wsg, int16_t xOff, int16_t yOff,
     bool flipLR, bool flipUD, int16_t rotateDeg)
 {
-    if(NULL == wsg->px)
+    rotateDeg %= 360;
+    if(rotateDeg < 0)
     {
-        return;
+        rotateDeg += 360;
     }
 
-    // Draw the image's pixels
-    for(int16_t srcY = 0; srcY < wsg->h; srcY++)
+    if(NULL != wsg->px)
     {
-        for(int16_t srcX = 0; srcX < wsg->w; srcX++)
+        if(0 == rotateDeg)
         {
-            // Draw if not transparent
-            if (cTransparent != wsg->px[(srcY * wsg->w) + srcX])
-            {
-                // Transform this pixel's draw location as necessary
-                int16_t dstX = srcX;
-                int16_t dstY = srcY;
-                transformPixel(&dstX, &dstY, xOff, yOff, flipLR, flipUD,
-                    rotateDeg, wsg->w, wsg->h);
-                // Check bounds
-                if(0 <= dstX && dstX < disp->w && 0 <= dstY && dstY <= disp->h)
-                {
-                    // Draw the pixel
-                    disp->setPx(dstX, dstY, wsg->px[(srcY * wsg->w) + srcX]);
-                }
-            }
+            drawWsgUnrotated(disp, wsg, xOff, yOff, flipLR, flipUD);
+        }
+        else
+        {
+            drawWsgRotated(disp, wsg, xOff, yOff, flipLR, flipUD, rotateDeg);
+        }
+    }
+    else if(NULL != wsg->rleRows)
+    {
+        if(0 == rotateDeg)
+        {
+            drawWsgRle(disp, wsg, xOff, yOff, flipLR, flipUD);
+        }
+        else
+        {
+            drawWsgRotated(disp, wsg, xOff, yOff, flipLR, flipUD, rotateDeg);
         }
     }
 }
@@ -345,8 +886,9 @@ void drawWsg(display_t * disp, wsg_t *wsg, int16_t xOff, int16_t yOff,
  * @brief Load a font from ROM to RAM. Fonts are bitmapped image files that have
  * a single height, all ASCII characters, and a width for each character.
  * PNGs placed in the assets folder before compilation will be automatically
- * flashed to ROM 
- * 
+ * flashed to ROM. Fonts are shared through the asset cache, so loading one
+ * which is already loaded is free
+ *
  * @param name The name of the font to load
  * @param font A handle to load the font to
  * @return true if the font was loaded successfully
@@ -354,97 +896,228 @@ void drawWsg(display_t * disp, wsg_t *wsg, int16_t xOff, int16_t yOff,
  */
 bool loadFont(const char * name, font_t * font)
 {
-    // Read font from file
-    uint8_t * buf = NULL;
-    size_t bufIdx = 0;
-    size_t sz;
-    if(!spiffsReadFile(name, &buf, &sz))
+    font_t * cached = cacheFont(name);
+    if(NULL == cached)
+    {
+        return false;
+    }
+    *font = *cached;
+    return true;
+}
+
+/**
+ * @brief Read a font from ROM to RAM, bypassing the asset cache. The font must
+ * be freed with freeFontData()
+ *
+ * @param name  The name of the font to read
+ * @param font  A handle to read the font to
+ * @param dataSize If not NULL, the size of the font's glyphs is returned through this
+ * @return true if the font was read successfully
+ *         false if the font failed to read and should not be used
+ */
+bool readFont(const char * name, font_t * font, size_t * dataSize)
+{
+    // Map the font, glyphs are repacked straight out of the mapping
+    spiffsMap_t map;
+    if(!spiffsMapFile(name, &map))
     {
         ESP_LOGE("FONT", "Failed to read %s", name);
         return false;
     }
+    const uint8_t * buf = map.data;
+    size_t sz = map.size;
 
-    // Read the data into a font struct
-    font->h = buf[bufIdx++];
+    // Read the height
+    if(0 == sz)
+    {
+        ESP_LOGE("FONT", "Empty font %s", name);
+        spiffsUnmapFile(&map);
+        return false;
+    }
+    font->h = buf[0];
 
-    // Read each char
+    // In the file, each char is a width followed by bits packed across rows.
+    // First find each char's width and offset in the blob, where each row
+    // starts on a byte boundary, and make sure the file isn't truncated
+    size_t bufIdx = 1;
+    uint32_t blobLen = 0;
     for(char ch = ' '; ch <= '~'; ch++)
     {
-        // Get an easy refence to this character
         font_ch_t * this = &font->chars[ch - ' '];
+        this->w = (bufIdx < sz) ? buf[bufIdx++] : 0;
+        this->offset = blobLen;
 
-        // Read the width
-        this->w = buf[bufIdx++];
+        uint32_t pixels = font->h * this->w;
+        bufIdx += (pixels + 7) / 8;
+        blobLen += font->h * ((this->w + 7) / 8);
+    }
+    if((bufIdx > sz) || (blobLen > UINT16_MAX))
+    {
+        ESP_LOGE("FONT", "Invalid font %s", name);
+        spiffsUnmapFile(&map);
+        return false;
+    }
 
-        // Figure out what size the char is
-        int pixels = font->h * this->w;
-        int bytes = (pixels / 8) + ((pixels % 8 == 0) ? 0 : 1);
+    // Then repack every char's rows into the single blob
+    font->bitmaps = (uint8_t *)calloc(blobLen, sizeof(uint8_t));
+    if(NULL == font->bitmaps)
+    {
+        ESP_LOGE("FONT", "Couldn't allocate %s", name);
+        spiffsUnmapFile(&map);
+        return false;
+    }
+    bufIdx = 1;
+    for(char ch = ' '; ch <= '~'; ch++)
+    {
+        font_ch_t * this = &font->chars[ch - ' '];
+        bufIdx++;
 
-        // Allocate space for this char and copy it over
-        this->bitmap = (uint8_t *) malloc(sizeof(uint8_t) * bytes);
-        memcpy(this->bitmap, &buf[bufIdx], bytes);
-        bufIdx += bytes;
+        uint8_t * row = &font->bitmaps[this->offset];
+        uint8_t rowBytes = (this->w + 7) / 8;
+        uint32_t bit = 0;
+        for(uint16_t y = 0; y < font->h; y++)
+        {
+            for(uint16_t x = 0; x < this->w; x++)
+            {
+                if(buf[bufIdx + (bit / 8)] & (1 << (bit % 8)))
+                {
+                    row[x / 8] |= (1 << (x % 8));
+                }
+                bit++;
+            }
+            row += rowBytes;
+        }
+        bufIdx += (bit + 7) / 8;
     }
 
-    // Free the SPIFFS data
-    free(buf);
+    // Done with the font data
+    spiffsUnmapFile(&map);
 
+    if(NULL != dataSize)
+    {
+        *dataSize = blobLen;
+    }
     return true;
 }
 
 /**
- * @brief Free the memory allocated for a font
+ * @brief Release a font loaded with loadFont(). Its memory is kept in the
+ * asset cache in case it's loaded again
  *
- * @param font The font to free memory from
+ * @param font The font to release
  */
 void freeFont(font_t * font)
 {
-    for(char ch = ' '; ch <= '~'; ch++)
-    {
-        free(font->chars[ch - ' '].bitmap);
-    }
+    releaseFont(font);
 }
 
+/**
+ * @brief Free the memory allocated for a font read with readFont()
+ *
+ * @param font The font to free memory from
+ */
+void freeFontData(font_t * font)
+{
+    free(font->bitmaps);
+    font->bitmaps = NULL;
+}
 
 /**
- * @brief Draw a single character from a font to a display
- * 
- * @param disp  The display to draw a character to
- * @param color The color of the character to draw
- * @param h     The height of the character to draw
- * @param ch    The character bitmap to draw (includes the width of the char)
- * @param xOff  The x offset to draw the char at
- * @param yOff  The y offset to draw the char at
+ * @brief Draw a 1-bit bitmap to a display. The bitmap is clipped to the display
+ * first, then each row's bytes are expanded into spans of set pixels
+ *
+ * @param disp     The display to draw to
+ * @param color    The color to draw set pixels with
+ * @param bits     The bitmap. Each row starts on a byte boundary and the lowest
+ *                 bit is the leftmost pixel
+ * @param rowBytes The number of bytes in each row
+ * @param w        The width of the bitmap
+ * @param h        The height of the bitmap
+ * @param xOff     The x offset to draw the bitmap at
+ * @param yOff     The y offset to draw the bitmap at
  */
-void drawChar(display_t * disp, paletteColor_t color, uint16_t h, font_ch_t * ch, int16_t xOff, int16_t yOff)
+static void drawBitmap(display_t * disp, paletteColor_t color, const uint8_t * bits,
+    uint16_t rowBytes, int16_t w, int16_t h, int16_t xOff, int16_t yOff)
 {
-    uint16_t byteIdx = 0;
-    uint8_t bitIdx = 0;
-    // Iterate over the character bitmap
-    for (int y = 0; y < h; y++)
-    {
-        for (int x = 0; x < ch->w; x++)
-        {
-            // Figure out where to draw
-            int drawX = x + xOff;
-            int drawY = y + yOff;
-            // If there is a pixel
-            if (ch->bitmap[byteIdx] & (1 << bitIdx))
+    // Clip the bitmap to the display, relative to its corner
+    int16_t xStart = (xOff < 0) ? -xOff : 0;
+    int16_t xEnd = (xOff + w > disp->w) ? disp->w - xOff : w;
+    int16_t yStart = (yOff < 0) ? -yOff : 0;
+    int16_t yEnd = (yOff + h > disp->h) ? disp->h - yOff : h;
+    if((xStart >= xEnd) || (yStart >= yEnd))
+    {
+        return;
+    }
+
+    const uint8_t * row = &bits[yStart * rowBytes];
+    for(int16_t y = yStart; y < yEnd; y++)
+    {
+        // Collect runs of set pixels and fill them as spans
+        int16_t runStart = -1;
+        int16_t x = xStart;
+        while(x < xEnd)
+        {
+            // Get the rest of the bits in this byte, the lowest bit is leftmost
+            uint8_t byteBits = row[x / 8] >> (x % 8);
+            int16_t byteEnd = ((x | 7) + 1 < xEnd) ? (x | 7) + 1 : xEnd;
+
+            if(0 == byteBits)
             {
-                // Draw the pixel
-                disp->setPx(drawX, drawY, color);
+                // Nothing else set in this byte, so end any run and skip it
+                if(runStart >= 0)
+                {
+                    fillDisplaySpan(disp, xOff + runStart, xOff + x, yOff + y, color);
+                    runStart = -1;
+                }
+                x = byteEnd;
+                continue;
             }
 
-            // Iterate over the bit data
-            bitIdx++;
-            if(8 == bitIdx) {
-                bitIdx = 0;
-                byteIdx++;
+            for(; x < byteEnd; x++, byteBits >>= 1)
+            {
+                if(byteBits & 1)
+                {
+                    // Start a run if one isn't started already
+                    if(runStart < 0)
+                    {
+                        runStart = x;
+                    }
+                }
+                else if(runStart >= 0)
+                {
+                    // The run ended, so draw it
+                    fillDisplaySpan(disp, xOff + runStart, xOff + x, yOff + y, color);
+                    runStart = -1;
+                }
             }
         }
+
+        // Draw any run which reached the end of the row
+        if(runStart >= 0)
+        {
+            fillDisplaySpan(disp, xOff + runStart, xOff + xEnd, yOff + y, color);
+        }
+        row += rowBytes;
     }
 }
 
+/**
+ * @brief Draw a single character from a font to a display
+ *
+ * @param disp  The display to draw a character to
+ * @param color The color of the character to draw
+ * @param font  The font the character is from
+ * @param ch    The character to draw, from font->chars
+ * @param xOff  The x offset to draw the char at
+ * @param yOff  The y offset to draw the char at
+ */
+void drawChar(display_t * disp, paletteColor_t color, const font_t * font,
+    const font_ch_t * ch, int16_t xOff, int16_t yOff)
+{
+    drawBitmap(disp, color, &font->bitmaps[ch->offset], (ch->w + 7) / 8,
+        ch->w, font->h, xOff, yOff);
+}
+
 /**
  * @brief Draw text to a display with the given color and font
  * 
@@ -464,7 +1137,7 @@ int16_t drawText(display_t * disp, font_t * font, paletteColor_t color, const ch
         if (xOff + font->chars[(*text) - ' '].w >= 0)
         {
             // Draw char
-            drawChar(disp, color, font->h, &font->chars[(*text) - ' '], xOff, yOff);
+            drawChar(disp, color, font, &font->chars[(*text) - ' '], xOff, yOff);
         }
 
         // Move to the next char
@@ -503,6 +1176,133 @@ uint16_t textWidth(font_t * font, const char * text)
     return width;
 }
 
+/**
+ * @brief Lay out text once so it can be drawn repeatedly without measuring it
+ * again. This is for labels which are drawn every frame, like menu rows. The
+ * text may optionally be rasterized to a 1-bit mask, which is then drawn as
+ * spans without looking up any glyphs
+ *
+ * @param pt        The prepared text to fill. Must be freed with freePreparedText()
+ * @param font      The font to use. It must stay loaded while pt is used
+ * @param text      The text to prepare. It isn't referenced after this returns
+ * @param rasterize true to rasterize the text to a mask, false to only keep the
+ *                  glyph list
+ */
+void prepareText(preparedText_t * pt, const font_t * font, const char * text,
+    bool rasterize)
+{
+    pt->font = font;
+    pt->len = strlen(text);
+    pt->w = 0;
+    pt->mask = NULL;
+    pt->maskRowBytes = 0;
+
+    // Measure the text first, so the glyph list and mask can share an allocation
+    for(uint16_t i = 0; i < pt->len; i++)
+    {
+        pt->w += font->chars[text[i] - ' '].w + 1;
+    }
+    // Delete trailing space
+    if(0 < pt->w)
+    {
+        pt->w--;
+    }
+
+    size_t glyphsSize = sizeof(const font_ch_t *) * pt->len;
+    size_t maskSize = 0;
+    if(rasterize)
+    {
+        pt->maskRowBytes = (pt->w + 7) / 8;
+        maskSize = pt->maskRowBytes * font->h;
+    }
+    pt->glyphs = (const font_ch_t **)calloc(1, glyphsSize + maskSize);
+    if(NULL == pt->glyphs)
+    {
+        // Leave the text empty, which draws nothing
+        pt->len = 0;
+        pt->w = 0;
+        pt->maskRowBytes = 0;
+        return;
+    }
+    if(rasterize)
+    {
+        pt->mask = (uint8_t *)&pt->glyphs[pt->len];
+    }
+
+    int16_t xPos = 0;
+    for(uint16_t i = 0; i < pt->len; i++)
+    {
+        const font_ch_t * ch = &font->chars[text[i] - ' '];
+        pt->glyphs[i] = ch;
+
+        if(rasterize)
+        {
+            // Copy the glyph's set bits into the mask at its position
+            uint8_t chRowBytes = (ch->w + 7) / 8;
+            for(uint16_t y = 0; y < font->h; y++)
+            {
+                const uint8_t * chRow = &font->bitmaps[ch->offset + (y * chRowBytes)];
+                uint8_t * maskRow = &pt->mask[y * pt->maskRowBytes];
+                for(uint16_t x = 0; x < ch->w; x++)
+                {
+                    if(chRow[x / 8] & (1 << (x % 8)))
+                    {
+                        maskRow[(xPos + x) / 8] |= (1 << ((xPos + x) % 8));
+                    }
+                }
+            }
+        }
+        xPos += ch->w + 1;
+    }
+}
+
+/**
+ * @brief Draw text prepared with prepareText(). Text which couldn't be
+ * prepared is empty, and draws nothing
+ *
+ * @param disp  The display to draw to
+ * @param pt    The prepared text to draw
+ * @param color The color to draw the text with
+ * @param xOff  The x offset to draw the text at
+ * @param yOff  The y offset to draw the text at
+ * @return The x offset at the end of the text, like drawText()
+ */
+int16_t drawPreparedText(display_t * disp, const preparedText_t * pt,
+    paletteColor_t color, int16_t xOff, int16_t yOff)
+{
+    if(NULL != pt->mask)
+    {
+        // The whole label is one bitmap
+        drawBitmap(disp, color, pt->mask, pt->maskRowBytes, pt->w, pt->font->h,
+            xOff, yOff);
+    }
+    else
+    {
+        // Draw each glyph, which are already looked up
+        int16_t x = xOff;
+        for(uint16_t i = 0; (i < pt->len) && (x < disp->w); i++)
+        {
+            drawChar(disp, color, pt->font, pt->glyphs[i], x, yOff);
+            x += pt->glyphs[i]->w + 1;
+        }
+    }
+    return (0 < pt->len) ? (xOff + pt->w + 1) : xOff;
+}
+
+/**
+ * @brief Free the memory allocated for prepared text
+ *
+ * @param pt The prepared text to free
+ */
+void freePreparedText(preparedText_t * pt)
+{
+    free(pt->glyphs);
+    pt->glyphs = NULL;
+    pt->mask = NULL;
+    pt->len = 0;
+    pt->w = 0;
+}
+
 /**
  * @brief Convert hue, saturation, and value to 15-bit RGB representation
  *
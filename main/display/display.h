@@ -7,8 +7,16 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "palette.h"
 
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* Set in a WSG file's width header if the pixels are run-length encoded */
+#define WSG_RLE_FLAG 0x8000
+
 //==============================================================================
 // Structs
 //==============================================================================
@@ -17,6 +25,13 @@ typedef struct {
     paletteColor_t * px;
     uint16_t w;
     uint16_t h;
+    /* Run-length encoded WSGs have px set to NULL and use these instead. Each
+     * row in rle is a series of (skip, run) byte pairs, where skip is a number
+     * of transparent pixels and run is a number of opaque pixels, each pair
+     * followed by the run's pixels. rleRows[y] is the index of row y in rle.
+     * Both are in a single allocation starting at rleRows */
+    uint32_t * rleRows;
+    uint8_t * rle;
 } wsg_t;
 
 typedef void (*pxSetFunc_t)(int16_t x, int16_t y, paletteColor_t px);
@@ -31,18 +46,42 @@ typedef struct {
     drawDisplayFunc_t drawDisplay;
     uint16_t w;
     uint16_t h;
+    /* The raw framebuffer, one paletteColor_t per pixel, or NULL if this
+     * display doesn't have one (i.e. the OLED). Rows are pxStride pixels apart.
+     * The span functions write here directly instead of calling setPx() */
+    paletteColor_t * pxFb;
+    uint16_t pxStride;
+    /* One flag per row, set when anything writes to that row, or NULL if this
+     * display doesn't track dirty rows. drawDisplay(true) only considers these
+     * rows for sending, then clears their flags */
+    uint8_t * dirtyRows;
 } display_t;
 
 typedef struct {
     uint8_t w;
-    uint8_t * bitmap;
+    uint16_t offset; ///< The index of this character's bitmap in the font's bitmaps
 } font_ch_t;
 
 typedef struct {
     uint8_t h;
+    /* Every character's bitmap in a single allocation. Each bitmap is h rows,
+     * each row is (w + 7) / 8 bytes, and the lowest bit is the leftmost pixel */
+    uint8_t * bitmaps;
     font_ch_t chars['~' - ' ' + 1];
 } font_t;
 
+/* Text which is laid out once by prepareText() and drawn many times */
+typedef struct {
+    const font_t * font;
+    uint16_t w;                ///< The measured width of the text
+    uint16_t len;              ///< The number of characters
+    const font_ch_t ** glyphs; ///< Each character's glyph, in order
+    /* If not NULL, the text rasterized to a font->h by w 1-bit mask, with rows
+     * maskRowBytes apart. It shares the glyphs allocation */
+    uint8_t * mask;
+    uint16_t maskRowBytes;
+} preparedText_t;
+
 //==============================================================================
 // Prototypes
 //==============================================================================
@@ -50,18 +89,34 @@ typedef struct {
 void fillDisplayArea(display_t * disp, int16_t x1, int16_t y1, int16_t x2,
     int16_t y2, paletteColor_t c);
 
+void fillDisplaySpan(display_t * disp, int16_t x1, int16_t x2, int16_t y,
+    paletteColor_t c);
+void blitDisplayRow(display_t * disp, int16_t xOff, int16_t y,
+    const paletteColor_t * src, uint16_t len);
+void blitDisplayRowMasked(display_t * disp, int16_t xOff, int16_t y,
+    const paletteColor_t * src, uint16_t len);
+
 bool loadWsg(char * name, wsg_t * wsg);
+bool readWsg(const char * name, wsg_t * wsg, size_t * dataSize);
 void drawWsg(display_t * disp, wsg_t *wsg, int16_t xOff, int16_t yOff,
     bool flipLR, bool flipUD, int16_t rotateDeg);
 void freeWsg(wsg_t * wsg);
+void freeWsgData(wsg_t * wsg);
 
 bool loadFont(const char * name, font_t * font);
-void drawChar(display_t * disp, paletteColor_t color, uint16_t h, font_ch_t * ch,
-    int16_t xOff, int16_t yOff);
+bool readFont(const char * name, font_t * font, size_t * dataSize);
+void drawChar(display_t * disp, paletteColor_t color, const font_t * font,
+    const font_ch_t * ch, int16_t xOff, int16_t yOff);
 int16_t drawText(display_t * disp, font_t * font, paletteColor_t color,
     const char * text, int16_t xOff, int16_t yOff);
 uint16_t textWidth(font_t * font, const char * text);
+void prepareText(preparedText_t * pt, const font_t * font, const char * text,
+    bool rasterize);
+int16_t drawPreparedText(display_t * disp, const preparedText_t * pt,
+    paletteColor_t color, int16_t xOff, int16_t yOff);
+void freePreparedText(preparedText_t * pt);
 void freeFont(font_t * font);
+void freeFontData(font_t * font);
 
 paletteColor_t hsv2rgb(uint16_t h, float s, float v);
 
@@ -0,0 +1,148 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <esp_log.h>
+
+#include "frame_scheduler.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* Missed frames are logged at most this often, so an overloaded mode doesn't
+ * also flood the log */
+#define MISSED_LOG_PERIOD_US 1000000
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+static uint16_t frameRate = DEFAULT_FRAME_RATE;
+static int64_t framePeriodUs = 1000000 / DEFAULT_FRAME_RATE;
+
+// The deadline for the next frame, or 0 before the first frame
+static int64_t tNextFrameUs = 0;
+static int64_t tLastFrameUs = 0;
+
+static frameStats_t frameStats = {0};
+
+// Frames missed since they were last logged
+static uint32_t unloggedMissed = 0;
+static int64_t tLastMissedLogUs = 0;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Reset the frame scheduler for a new mode, with the first frame due
+ * immediately
+ *
+ * @param fps The number of frames per second to schedule, or 0 for
+ *            DEFAULT_FRAME_RATE
+ */
+void initFrameScheduler(uint16_t fps)
+{
+    setFrameRate(fps);
+    tNextFrameUs = 0;
+    tLastFrameUs = 0;
+    unloggedMissed = 0;
+    tLastMissedLogUs = 0;
+    frameStats = (frameStats_t){0};
+}
+
+/**
+ * @brief Change the number of frames per second to schedule. The next frame's
+ * deadline is unchanged
+ *
+ * @param fps The number of frames per second to schedule, or 0 for
+ *            DEFAULT_FRAME_RATE
+ */
+void setFrameRate(uint16_t fps)
+{
+    frameRate = (0 == fps) ? DEFAULT_FRAME_RATE : fps;
+    framePeriodUs = 1000000 / frameRate;
+}
+
+/**
+ * @return The number of frames per second being scheduled
+ */
+uint16_t getFrameRate(void)
+{
+    return frameRate;
+}
+
+/**
+ * @brief Check if it's time to draw and flush a frame. This should be called
+ * from the main loop, and when it returns true the mode should draw a frame
+ * and the display should be flushed.
+ *
+ * Deadlines are a fixed period apart, so a late frame doesn't push back the
+ * ones after it. If whole periods pass without a frame, those frames are
+ * skipped rather than drawn back to back, and counted as missed
+ *
+ * @param tNowUs The current time, in microseconds
+ * @param tElapsedUs A pointer to return the time since the last frame through
+ * @return true if a frame is due, false if it isn't
+ */
+bool checkFrameDue(int64_t tNowUs, int64_t * tElapsedUs)
+{
+    // The first frame is due immediately
+    if(0 == tNextFrameUs)
+    {
+        tNextFrameUs = tNowUs;
+        tLastFrameUs = tNowUs;
+    }
+
+    if(tNowUs < tNextFrameUs)
+    {
+        return false;
+    }
+
+    // Skip any deadlines which have passed entirely
+    int64_t lateUs = tNowUs - tNextFrameUs;
+    uint32_t missed = lateUs / framePeriodUs;
+    tNextFrameUs += (missed + 1) * framePeriodUs;
+
+    frameStats.framesDrawn++;
+    frameStats.framesMissed += missed;
+    if(lateUs > frameStats.maxLateUs)
+    {
+        frameStats.maxLateUs = lateUs;
+    }
+
+    unloggedMissed += missed;
+    if((0 < unloggedMissed) && (tNowUs - tLastMissedLogUs >= MISSED_LOG_PERIOD_US))
+    {
+        ESP_LOGW("FRAME", "Missed %u frames at %dfps", (unsigned int)unloggedMissed, frameRate);
+        unloggedMissed = 0;
+        tLastMissedLogUs = tNowUs;
+    }
+
+    *tElapsedUs = tNowUs - tLastFrameUs;
+    tLastFrameUs = tNowUs;
+    return true;
+}
+
+/**
+ * @brief Get the deadline for the next frame, so the main loop knows how long
+ * it may block
+ *
+ * @return The time the next frame is due, in microseconds. This is 0 before the
+ *         first frame, which is due immediately
+ */
+int64_t getNextFrameTime(void)
+{
+    return tNextFrameUs;
+}
+
+/**
+ * @brief Get the frame scheduler's statistics since the mode started
+ *
+ * @param stats Returns the statistics
+ */
+void getFrameStats(frameStats_t * stats)
+{
+    *stats = frameStats;
+}
@@ -0,0 +1,23 @@
+#ifndef _FRAME_SCHEDULER_H_
+#define _FRAME_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The frame rate used when a mode doesn't ask for one */
+#define DEFAULT_FRAME_RATE 30
+
+typedef struct {
+    uint32_t framesDrawn;  ///< Frames which were due and drawn
+    uint32_t framesMissed; ///< Frame deadlines which passed without a frame
+    int64_t maxLateUs;     ///< The latest a frame has been drawn after its deadline
+} frameStats_t;
+
+void initFrameScheduler(uint16_t fps);
+void setFrameRate(uint16_t fps);
+uint16_t getFrameRate(void);
+bool checkFrameDue(int64_t tNowUs, int64_t * tElapsedUs);
+int64_t getNextFrameTime(void);
+void getFrameStats(frameStats_t * stats);
+
+#endif
@@ -28,7 +28,7 @@ static const uint8_t rowOffsets[MAX_ROWS] =
 // Function Prototypes
 //==============================================================================
 
-static void drawMeleeMenuText(display_t* d, font_t* font, const char* text,
+static void drawMeleeMenuText(display_t* d, font_t* font, const preparedText_t* text,
                               int16_t xPos, int16_t yPos, bool isSelected);
 
 //==============================================================================
@@ -57,6 +57,8 @@ meleeMenu_t* initMeleeMenu(const char* title, font_t* font, meleeMenuCb cbFunc)
     newMenu->title = title;
     newMenu->cbFunc = cbFunc;
     newMenu->font = font;
+    // The title is drawn every frame, so lay it out once
+    prepareText(&newMenu->titleText, font, title, true);
     // Return the menu
     return newMenu;
 }
@@ -68,6 +70,11 @@ meleeMenu_t* initMeleeMenu(const char* title, font_t* font, meleeMenuCb cbFunc)
  */
 void deinitMeleeMenu(meleeMenu_t* menu)
 {
+    freePreparedText(&menu->titleText);
+    for(uint8_t row = 0; row < menu->numRows; row++)
+    {
+        freePreparedText(&menu->rowTexts[row]);
+    }
     free(menu);
 }
 
@@ -83,8 +90,9 @@ void addRowToMeleeMenu(meleeMenu_t* menu, const char* label)
     // Make sure there's space for this row
     if(menu->numRows < MAX_ROWS)
     {
-        // Add the row
+        // Add the row, and lay it out once since it's drawn every frame
         menu->rows[menu->numRows] = label;
+        prepareText(&menu->rowTexts[menu->numRows], menu->font, label, true);
         menu->numRows++;
     }
 }
@@ -147,24 +155,22 @@ void meleeMenuButton(meleeMenu_t* menu, buttonBit_t btn)
  */
 void drawMeleeMenu(display_t* d, meleeMenu_t* menu)
 {
-    // Draw a dim blue background with a grey grid
+    // Draw a dim blue background with a grey grid. There are only two kinds
+    // of rows, so build each once and copy them to the display
+    paletteColor_t gridRow[d->w];
+    paletteColor_t bgRow[d->w];
+    memset(gridRow, c111, sizeof(gridRow));
+    for(int16_t x = 0; x < d->w; x++)
+    {
+        bgRow[x] = ((x % 12) == 0) ? c111 : c001;
+    }
     for(int16_t y = 0; y < d->h; y++)
     {
-        for(int16_t x = 0; x < d->w; x++)
-        {
-            if(((x % 12) == 0) || ((y % 12) == 0))
-            {
-                d->setPx(x, y, c111); // Grid
-            }
-            else
-            {
-                d->setPx(x, y, c001); // Background
-            }
-        }
+        blitDisplayRow(d, 0, y, ((y % 12) == 0) ? gridRow : bgRow, d->w);
     }
 
     // Draw the title and note where it ends
-    int16_t textEnd = drawText(d, menu->font, c222, menu->title, 33, 25);
+    int16_t textEnd = drawPreparedText(d, &menu->titleText, c222, 33, 25);
 
     // The width of the border
 #define BORDER_WIDTH 7
@@ -206,7 +212,7 @@ void drawMeleeMenu(display_t* d, meleeMenu_t* menu)
     int16_t yIdx = 37;
     for(uint8_t row = 0; row < menu->numRows; row++)
     {
-        drawMeleeMenuText(d, menu->font, menu->rows[row],
+        drawMeleeMenuText(d, menu->font, &menu->rowTexts[row],
                           rowOffsets[row], (yIdx += (menu->font->h + 7)),
                           (row == menu->selectedRow));
     }
@@ -217,7 +223,7 @@ void drawMeleeMenu(display_t* d, meleeMenu_t* menu)
  *
  * @param d    The display to draw to
  * @param font The font to use
- * @param text The text for this box
+ * @param text The prepared text for this box
  * @param xPos The X position of the text. Note, this is not the position of the
  *             boundary and filled background
  * @param yPos The Y position of the text. Note, this is not the position of the
@@ -225,14 +231,14 @@ void drawMeleeMenu(display_t* d, meleeMenu_t* menu)
  * @param isSelected true if this is the selected item. This will draw with
  *                   different colors
  */
-static void drawMeleeMenuText(display_t* d, font_t* font, const char* text,
+static void drawMeleeMenuText(display_t* d, font_t* font, const preparedText_t* text,
                               int16_t xPos, int16_t yPos, bool isSelected)
 {
     // Boundary color is the same for all entries
     paletteColor_t boundaryColor = c321;
 
     // Figure out the text width to draw around it
-    int16_t tWidth = textWidth(font, text);
+    int16_t tWidth = text->w;
 
     // Top line
     plotLine(d,
@@ -276,5 +282,5 @@ static void drawMeleeMenuText(display_t* d, font_t* font, const char* text,
                 boundaryColor, fillColor);
 
     // Draw the text
-    drawText(d, font, textColor, text, xPos, yPos);
+    drawPreparedText(d, text, textColor, xPos, yPos);
 }
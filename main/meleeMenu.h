@@ -24,6 +24,8 @@ typedef struct
 {
     const char* rows[MAX_ROWS];
     const char* title;
+    preparedText_t rowTexts[MAX_ROWS]; ///< The rows, laid out once
+    preparedText_t titleText;          ///< The title, laid out once
     font_t* font;
     meleeMenuCb cbFunc;
     uint8_t numRows;
@@ -2,10 +2,20 @@
 // Includes
 //==============================================================================
 
+#include <string.h>
+
 #include "display.h"
 #include "bresenham.h"
 #include "aabb_utils.h"
 
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+static void getGridCells(const collisionGrid_t* grid, box_t box,
+                         uint8_t* col0, uint8_t* row0, uint8_t* col1, uint8_t* row1);
+static uint8_t getGridCell(int32_t pos, int32_t origin, int32_t cellSize, uint8_t numCells);
+
 //==============================================================================
 // Functions
 //==============================================================================
@@ -53,4 +63,141 @@ bool boxesCollide(box_t box0, box_t box1)
             (int32_t)(box0.x1) > box1.x0 &&
             box0.y0 < (int32_t)(box1.y1) &&
             (int32_t)(box0.y1) > box1.y0);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Set up an empty collision grid covering an area
+ *
+ * @param grid The grid to set up
+ * @param bounds The area the grid covers, split into GRID_COLS by GRID_ROWS
+ *               cells
+ */
+void initCollisionGrid(collisionGrid_t* grid, box_t bounds)
+{
+    grid->x0 = bounds.x0;
+    grid->y0 = bounds.y0;
+    // Round up so the cells cover all of the bounds
+    grid->cellW = ((bounds.x1 - bounds.x0) + GRID_COLS - 1) / GRID_COLS;
+    grid->cellH = ((bounds.y1 - bounds.y0) + GRID_ROWS - 1) / GRID_ROWS;
+    if(grid->cellW < 1)
+    {
+        grid->cellW = 1;
+    }
+    if(grid->cellH < 1)
+    {
+        grid->cellH = 1;
+    }
+    clearCollisionGrid(grid);
+}
+
+/**
+ * @brief Remove every box from a collision grid
+ *
+ * @param grid The grid to clear
+ */
+void clearCollisionGrid(collisionGrid_t* grid)
+{
+    memset(grid->cells, 0, sizeof(grid->cells));
+}
+
+/**
+ * @brief Get the cell a coordinate falls in along one axis, clamped to the grid
+ *
+ * @param pos The coordinate
+ * @param origin The grid's edge on this axis
+ * @param cellSize The size of a cell on this axis
+ * @param numCells The number of cells on this axis
+ * @return The index of the cell
+ */
+static uint8_t getGridCell(int32_t pos, int32_t origin, int32_t cellSize, uint8_t numCells)
+{
+    if(pos <= origin)
+    {
+        return 0;
+    }
+    int32_t cell = (pos - origin) / cellSize;
+    return (cell >= numCells) ? (numCells - 1) : cell;
+}
+
+/**
+ * @brief Get the range of cells a box overlaps, inclusive
+ *
+ * @param grid The grid
+ * @param box The box
+ * @param col0 The leftmost column is written here
+ * @param row0 The topmost row is written here
+ * @param col1 The rightmost column is written here
+ * @param row1 The bottommost row is written here
+ */
+static void getGridCells(const collisionGrid_t* grid, box_t box,
+                         uint8_t* col0, uint8_t* row0, uint8_t* col1, uint8_t* row1)
+{
+    *col0 = getGridCell(box.x0, grid->x0, grid->cellW, GRID_COLS);
+    *row0 = getGridCell(box.y0, grid->y0, grid->cellH, GRID_ROWS);
+    *col1 = getGridCell(box.x1, grid->x0, grid->cellW, GRID_COLS);
+    *row1 = getGridCell(box.y1, grid->y0, grid->cellH, GRID_ROWS);
+}
+
+/**
+ * @brief Add a box to every cell of a collision grid which it overlaps. A box
+ * may be added again with the same ID, e.g. after it moves. It's then in the
+ * cells of both boxes
+ *
+ * @param grid The grid to add to
+ * @param box The box to add
+ * @param id The box's ID, less than GRID_MAX_IDS
+ */
+void addToCollisionGrid(collisionGrid_t* grid, box_t box, uint8_t id)
+{
+    uint8_t col0, row0, col1, row1;
+    getGridCells(grid, box, &col0, &row0, &col1, &row1);
+    for(uint8_t row = row0; row <= row1; row++)
+    {
+        for(uint8_t col = col0; col <= col1; col++)
+        {
+            grid->cells[row][col] |= (1u << id);
+        }
+    }
+}
+
+/**
+ * @brief Find which boxes in a collision grid may collide with a box
+ *
+ * @param grid The grid to query
+ * @param box The box to check
+ * @return A bitmask of the IDs of every box sharing a cell with this box. Boxes
+ *         which aren't in the mask don't collide with it
+ */
+uint32_t queryCollisionGrid(const collisionGrid_t* grid, box_t box)
+{
+    uint8_t col0, row0, col1, row1;
+    getGridCells(grid, box, &col0, &row0, &col1, &row1);
+    uint32_t ids = 0;
+    for(uint8_t row = row0; row <= row1; row++)
+    {
+        for(uint8_t col = col0; col <= col1; col++)
+        {
+            ids |= grid->cells[row][col];
+        }
+    }
+    return ids;
+}
+
+/**
+ * @brief Take the lowest ID out of a bitmask from queryCollisionGrid(). This
+ * visits candidates in ascending order, like looping over an array would
+ *
+ * @param ids The bitmask of IDs. The returned ID is cleared from it
+ * @param id The lowest ID is written here
+ * @return true if an ID was taken, false if the bitmask was empty
+ */
+bool popCollisionGridId(uint32_t* ids, uint8_t* id)
+{
+    if(0 == *ids)
+    {
+        return false;
+    }
+    *id = __builtin_ctz(*ids);
+    *ids &= (*ids - 1);
+    return true;
+}
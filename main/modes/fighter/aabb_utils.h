@@ -18,7 +18,33 @@ typedef struct
     int32_t y1;
 } box_t;
 
+#define GRID_COLS 16
+#define GRID_ROWS 16
+#define GRID_MAX_IDS 32 // Each cell holds a bitmask of IDs
+
+/*
+ * A uniform grid for broad phase collision checks. Boxes are added to every
+ * cell they overlap, by ID, and a query returns the IDs of every box sharing a
+ * cell with the query box. Only those candidates need a boxesCollide() check.
+ * Boxes outside the grid's bounds are clamped to its edge cells, so nothing is
+ * ever missed, it's just less selective there
+ */
+typedef struct
+{
+    int32_t x0;    ///< The left edge of the grid
+    int32_t y0;    ///< The top edge of the grid
+    int32_t cellW; ///< The width of each cell
+    int32_t cellH; ///< The height of each cell
+    uint32_t cells[GRID_ROWS][GRID_COLS];
+} collisionGrid_t;
+
 void drawBox(display_t* disp, box_t box, paletteColor_t color, bool isFilled, int32_t scalingFactor);
 bool boxesCollide(box_t box0, box_t box1);
 
+void initCollisionGrid(collisionGrid_t* grid, box_t bounds);
+void clearCollisionGrid(collisionGrid_t* grid);
+void addToCollisionGrid(collisionGrid_t* grid, box_t box, uint8_t id);
+uint32_t queryCollisionGrid(const collisionGrid_t* grid, box_t box);
+bool popCollisionGridId(uint32_t* ids, uint8_t* id);
+
 #endif
\ No newline at end of file
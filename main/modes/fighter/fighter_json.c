@@ -4,904 +4,303 @@
 
 #include <stdint.h>
 #include <string.h>
-#include <stdlib.h>
 
 #include "esp_log.h"
-#include "jsmn.h"
 
-#include "spiffs_json.h"
+#include "spiffs_manager.h"
+#include "spiffs_pack.h"
+#include "asset_cache.h"
 #include "fighter_json.h"
 
-//==============================================================================
-// Structs
-//==============================================================================
-
-typedef struct
-{
-    char* name;
-    wsg_t sprite;
-} namedSprite_t;
-
 //==============================================================================
 // Prototypes
 //==============================================================================
 
-int32_t parseJsonFighter(          char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites,
-                                   fighter_t* ftr);
-int32_t parseJsonAttack(           char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites,
-                                   attack_t* atk);
-int32_t parseJsonAttackFrame(      char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites,
-                                   attackFrame_t* frm);
-int32_t parseJsonAttackFrameHitbox(char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites,
-                                   attackHitbox_t* hbx);
+static bool isInFighterData(size_t dataSize, uint32_t offset, uint32_t len);
+static bool isFighterSprite(const ftrDataHeader_t* hdr, uint16_t idx);
+static bool validateFighterAttack(const uint8_t* data, size_t dataSize, const ftrAttackRec_t* atkRec);
+static bool validateFighterData(const uint8_t* data, size_t dataSize);
 
 //==============================================================================
-// JSON Utility Functions
+// Functions
 //==============================================================================
 
 /**
- * @brief Compare a JSMN String to a given string value
- *
- * @param jsonStr The full JSON string
- * @param tok The token for the string to compare
- * @param s The string to compare to
- * @return 0 if the strings match, non-zero value if they do not (see strcmp())
- */
-static int32_t jsoneq(const char* jsonStr, jsmntok_t* tok, const char* s)
-{
-    if (tok->type == JSMN_STRING && (int32_t)strlen(s) == tok->end - tok->start)
-    {
-        return strncmp(jsonStr + tok->start, s, tok->end - tok->start);
-    }
-    return -1;
-}
-
-/**
- * @brief Extract an integer value from a JSMN primitive
- *
- * @param jsonStr The full JSON string
- * @param tok The token for the integer to extract
- * @return An integer value
- */
-static int32_t jsonInteger(const char* jsonStr, jsmntok_t tok)
-{
-    if(JSMN_PRIMITIVE == tok.type)
-    {
-        char jsonVal[(tok.end - tok.start) + 1];
-        memcpy(jsonVal, &(jsonStr[tok.start]), (tok.end - tok.start));
-        jsonVal[(tok.end - tok.start)] = 0;
-        return atoi(jsonVal);
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-/**
- * @brief Extract a string value from a JSMN string. This allocates memory which
- * must be free()'d later
+ * @brief Check if a range of bytes is inside the fighter data, and starts on a
+ * four byte boundary so records in it can be used in place
  *
- * @param jsonStr The full JSON string
- * @param tok The token for the string to extract
- * @return A pointer to a freshly allocated string
+ * @param dataSize The size of the fighter data
+ * @param offset The offset of the range
+ * @param len The length of the range
+ * @return true if the range is inside the data, false if it isn't
  */
-static char* jsonString(const char* jsonStr, jsmntok_t tok)
+static bool isInFighterData(size_t dataSize, uint32_t offset, uint32_t len)
 {
-    char* copiedStr = calloc((tok.end - tok.start + 1), sizeof(char));
-    memcpy(copiedStr, &(jsonStr[tok.start]), (tok.end - tok.start));
-    copiedStr[tok.end - tok.start] = 0;
-    return copiedStr;
+    return (0 == (offset % 4)) && (offset <= dataSize) && (len <= dataSize - offset);
 }
 
 /**
- * @brief Extract a boolean value from a JSMN primitive
+ * @brief Check if a sprite index names a sprite in the fighter data's sprite
+ * table. Index 0 is no sprite, which is never valid for a sprite that's drawn
  *
- * @param jsonStr The full JSON string
- * @param tok The token for the boolean to extract
- * @return true or false
+ * @param hdr The fighter data's header
+ * @param idx The sprite index to check
+ * @return true if the index is valid, false if it isn't
  */
-static bool jsonBoolean(const char* jsonStr, jsmntok_t tok)
+static bool isFighterSprite(const ftrDataHeader_t* hdr, uint16_t idx)
 {
-    return (0 == memcmp("true", &(jsonStr[tok.start]), (tok.end - tok.start))) ? true : false;
+    return (0 < idx) && (idx < hdr->numSprites);
 }
 
-//==============================================================================
-// Parsing Functions
-//==============================================================================
-
 /**
- * @brief Parse fighter attributes from a JSON file and return them in struct form
+ * @brief Check that an attack's frames and their hitboxes are inside the
+ * fighter data, and that every sprite they use exists
  *
- * @param numFighters The number of fighters will be written to this pointer
- * @param loadedSprites A list of loaded sprites. Will be filled with sprites
- * @return A pointer to the allocated fighter attribute data
+ * @param data The fighter data
+ * @param dataSize The size of the fighter data
+ * @param atkRec The attack to check
+ * @return true if the attack is valid, false if it isn't
  */
-fighter_t* loadJsonFighterData(uint8_t* numFighters, list_t* loadedSprites)
+static bool validateFighterAttack(const uint8_t* data, size_t dataSize, const ftrAttackRec_t* atkRec)
 {
-    // Load the json string
-    char* jsonStr = loadJson("test.json");
-
-    // Allocate a bunch of tokens
-    jsmn_parser p;
-    jsmntok_t* toks = calloc(1024, sizeof(jsmntok_t));
-    int32_t tokIdx = 0;
-
-    // Parse the JSON into tokens
-    jsmn_init(&p);
-    int32_t numToks = jsmn_parse(&p, jsonStr, strlen(jsonStr), toks, 1024);
-    if (numToks < 0)
+    const ftrDataHeader_t* hdr = (const ftrDataHeader_t*)data;
+    if((atkRec->numAttackFrames > MAX_ATTACK_FRAMES) ||
+            !isFighterSprite(hdr, atkRec->startupLagSpr) ||
+            !isFighterSprite(hdr, atkRec->endLagSpr) ||
+            !isInFighterData(dataSize, atkRec->framesOffset, atkRec->numAttackFrames * sizeof(attackFrame_t)))
     {
-        ESP_LOGE("FTR", "Failed to parse JSON: %d\n", numToks);
-        free(toks);
-        return NULL;
+        return false;
     }
-    else
-    {
-        ESP_LOGI("FTR", "numToks = %d", numToks);
-    }
-
-    // Pointer to allocate memory for later
-    fighter_t* fighters = NULL;
-
-    ////////////////////////////////////////////////////////////////////////////
 
-    // Each attack is an object
-    if(JSMN_OBJECT != toks[tokIdx].type)
+    const attackFrame_t* frames = (const attackFrame_t*)&data[atkRec->framesOffset];
+    for(uint8_t frmIdx = 0; frmIdx < atkRec->numAttackFrames; frmIdx++)
     {
-        ESP_LOGE("JSON", "Non-object!!");
-    }
-
-    // Keep track of fields so we know when we're done
-    uint8_t numFieldsParsed = 0;
-    uint8_t numFieldsToParse = toks[tokIdx].size;
-
-    // Move to the first field
-    tokIdx++;
-
-    // Parse the tokens
-    while(true)
-    {
-        if(JSMN_STRING == toks[tokIdx].type)
+        const attackFrame_t* frm = &frames[frmIdx];
+        uint32_t frmOffset = (const uint8_t*)frm - data;
+        if(!isFighterSprite(hdr, frm->sprite) ||
+                (UINT32_MAX - frmOffset < frm->hitboxesOffset) ||
+                !isInFighterData(dataSize, frmOffset + frm->hitboxesOffset, frm->numHitboxes * sizeof(attackHitbox_t)))
         {
-            if (0 == jsoneq(jsonStr, &toks[tokIdx], "fighters"))
-            {
-                tokIdx++;
-
-                // Allocate space for the fighters
-                *numFighters = toks[tokIdx].size;
-                fighters = calloc(sizeof(fighter_t), *numFighters);
-
-                // Move to the next token
-                tokIdx++;
-
-                // Parse each fighter
-                for(int32_t fighterIdx = 0; fighterIdx < *numFighters; fighterIdx++)
-                {
-                    // Sum up the number of tokens this fighter parsed
-                    tokIdx = parseJsonFighter(jsonStr, toks, tokIdx, loadedSprites, &fighters[fighterIdx]);
-                }
-
-                numFieldsParsed++;
-            }
-        }
-        else
-        {
-            ESP_LOGE("JSON", "Non-string key!!");
+            return false;
         }
 
-        // Check to return
-        if(numFieldsParsed == numFieldsToParse)
+        const attackHitbox_t* hitboxes = getAttackHitboxes(frm);
+        for(uint8_t hbIdx = 0; hbIdx < frm->numHitboxes; hbIdx++)
         {
-            return fighters;
+            // Only projectiles are drawn with a sprite
+            if(hitboxes[hbIdx].isProjectile && !isFighterSprite(hdr, hitboxes[hbIdx].projSprite))
+            {
+                return false;
+            }
         }
     }
-    return fighters;
+    return true;
 }
 
 /**
- * @brief Parse a fighter object from a JSON string
+ * @brief Check every offset, count, and sprite index in the fighter data once,
+ * so it can be used in place without any further checks
  *
- * @param jsonStr The whole JSON string
- * @param toks An array of JSON tokens
- * @param tokIdx The index of the current JSON token
- * @param loadedSprites A list of sprites, used for loading
- * @param ftr The fighter to parse data into
- * @return int32_t The index of the JSON token after parsing
+ * @param data The fighter data
+ * @param dataSize The size of the fighter data
+ * @return true if the data is valid, false if it isn't
  */
-int32_t parseJsonFighter(char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites, fighter_t* ftr)
+static bool validateFighterData(const uint8_t* data, size_t dataSize)
 {
-    // Each fighter is an object
-    if(JSMN_OBJECT != toks[tokIdx].type)
+    const ftrDataHeader_t* hdr = (const ftrDataHeader_t*)data;
+    if((dataSize < sizeof(ftrDataHeader_t)) ||
+            (0 != memcmp(hdr->magic, FIGHTER_DATA_MAGIC, sizeof(hdr->magic))) ||
+            (FIGHTER_DATA_VERSION != hdr->version) ||
+            (sizeof(attackFrame_t) != hdr->frameSize) ||
+            (sizeof(attackHitbox_t) != hdr->hitboxSize) ||
+            !isInFighterData(dataSize, hdr->spriteNamesOffset, hdr->numSprites * sizeof(uint32_t)) ||
+            !isInFighterData(dataSize, hdr->fightersOffset, hdr->numFighters * sizeof(ftrFighterRec_t)))
     {
-        ESP_LOGE("JSON", "Non-object!!");
+        return false;
     }
 
-    uint8_t numFieldsParsed = 0;
-    uint8_t numFieldsToParse = toks[tokIdx].size;
-
-    // Move to the first field
-    tokIdx++;
-
-    // Parse the tokens
-    while(true)
+    // Every sprite name must be NUL terminated inside the data. Sprite 0 is no
+    // sprite and has no name
+    const uint32_t* spriteNames = (const uint32_t*)&data[hdr->spriteNamesOffset];
+    for(uint8_t sprIdx = 1; sprIdx < hdr->numSprites; sprIdx++)
     {
-        if(JSMN_STRING == toks[tokIdx].type)
+        uint32_t nameOffset = spriteNames[sprIdx];
+        if((nameOffset >= dataSize) || (NULL == memchr(&data[nameOffset], 0, dataSize - nameOffset)))
         {
-            if (0 == jsoneq(jsonStr, &toks[tokIdx], "name"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ESP_LOGD("FTR", "Fighter name is %s", name);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "idle_spr_0"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->idleSprite0 = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "idle_spr_1"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->idleSprite1 = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "run_spr_0"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->runSprite0 = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "run_spr_1"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->runSprite1 = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "jump_spr"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->jumpSprite = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "duck_spr"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->duckSprite = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "land_lag_spr"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                ftr->landingLagSprite = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "gravity"))
-            {
-                tokIdx++;
-                ftr->gravity = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "jump_velo"))
-            {
-                tokIdx++;
-                ftr->jump_velo = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "run_accel"))
-            {
-                tokIdx++;
-                ftr->run_accel = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "run_decel"))
-            {
-                tokIdx++;
-                ftr->run_decel = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "run_max_velo"))
-            {
-                tokIdx++;
-                ftr->run_max_velo = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "size_x"))
-            {
-                tokIdx++;
-                ftr->size.x = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                ftr->originalSize.x = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "size_y"))
-            {
-                tokIdx++;
-                ftr->size.y = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                ftr->originalSize.y = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "nJumps"))
-            {
-                tokIdx++;
-                ftr->numJumps = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "landing_lag"))
-            {
-                tokIdx++;
-                ftr->landingLag = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "attacks"))
-            {
-                // Move to the array, get the size
-                tokIdx++;
-                uint8_t numAttacks = toks[tokIdx].size;
-
-                // Check length
-                if(numAttacks != NUM_ATTACKS)
-                {
-                    ESP_LOGE("JSON", "Incorrect number of attacks");
-                }
-
-                tokIdx++;
-                for(uint8_t atkIdx = 0; atkIdx < numAttacks; atkIdx++)
-                {
-                    tokIdx = parseJsonAttack(jsonStr, toks, tokIdx, loadedSprites, &ftr->attacks[atkIdx]);
-                }
-                numFieldsParsed++;
-            }
+            return false;
         }
-        else
+    }
+
+    const ftrFighterRec_t* recs = (const ftrFighterRec_t*)&data[hdr->fightersOffset];
+    for(uint8_t ftrIdx = 0; ftrIdx < hdr->numFighters; ftrIdx++)
+    {
+        const ftrFighterRec_t* rec = &recs[ftrIdx];
+        if(!isFighterSprite(hdr, rec->idleSprite0) ||
+                !isFighterSprite(hdr, rec->idleSprite1) ||
+                !isFighterSprite(hdr, rec->runSprite0) ||
+                !isFighterSprite(hdr, rec->runSprite1) ||
+                !isFighterSprite(hdr, rec->jumpSprite) ||
+                !isFighterSprite(hdr, rec->duckSprite) ||
+                !isFighterSprite(hdr, rec->landingLagSprite))
         {
-            ESP_LOGE("JSON", "Non-string key!!");
+            return false;
         }
 
-        // Check to return
-        if(numFieldsParsed == numFieldsToParse)
+        for(uint8_t atkIdx = 0; atkIdx < NUM_ATTACKS; atkIdx++)
         {
-            return tokIdx;
+            if(!validateFighterAttack(data, dataSize, &rec->attacks[atkIdx]))
+            {
+                return false;
+            }
         }
     }
-    return tokIdx;
+    return true;
 }
 
 /**
- * @brief Parse an attack object from a JSON string
+ * @brief Load the compiled fighter data. The data is validated once and then
+ * used in place, attack frames and hitboxes point into it, so it stays mapped
+ * until freeFighterData(). The fighters and sprite table are allocated from the
+ * arena. The sprites are referenced in the asset cache
  *
- * @param jsonStr The whole JSON string
- * @param toks An array of JSON tokens
- * @param tokIdx The index of the current JSON token
- * @param loadedSprites A list of sprites, used for loading
- * @param atk The attack to parse data into
- * @return int32_t The index of the JSON token after parsing
+ * @param arena The arena to allocate from
+ * @param ftrData Returns the mapped data and the table of loaded sprites. Must
+ *                be released with freeFighterData()
+ * @param numFighters The number of fighters will be written to this pointer
+ * @return A pointer to the allocated fighters, or NULL if the data couldn't be
+ *         loaded or is invalid
  */
-int32_t parseJsonAttack(char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites, attack_t* atk)
+fighter_t* loadFighterData(arena_t* arena, fighterData_t* ftrData, uint8_t* numFighters)
 {
-    // Each attack is an object
-    if(JSMN_OBJECT != toks[tokIdx].type)
-    {
-        ESP_LOGE("JSON", "Non-object!!");
-    }
-
-    // Keep track of fields so we know when we're done
-    uint8_t numFieldsParsed = 0;
-    uint8_t numFieldsToParse = toks[tokIdx].size;
+    memset(ftrData, 0, sizeof(fighterData_t));
 
-    // Move to the first field
-    tokIdx++;
+    // The data may be viewed in the asset pack, so hold the pack open while
+    // it's used. This is free if the pack is attached already
+    ftrData->packHeld = spiffsOpenPack(ASSET_PACK_NAME);
 
-    // Parse the tokens
-    while(true)
+    // Get the whole file at once
+    if(!spiffsMapFile(FIGHTER_DATA_FILE, &ftrData->map))
     {
-        if(JSMN_STRING == toks[tokIdx].type)
-        {
-            if (0 == jsoneq(jsonStr, &toks[tokIdx], "type"))
-            {
-                tokIdx++;
-                char* type = jsonString(jsonStr, toks[tokIdx]);
-                // ESP_LOGD("FTR", "Parsing %s", type);
-                free(type);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "startupLag"))
-            {
-                tokIdx++;
-                atk->startupLag = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "endLag"))
-            {
-                tokIdx++;
-                atk->endLag = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "landing_lag"))
-            {
-                tokIdx++;
-                atk->landingLag = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "startupLagSpr"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                atk->startupLagSpr = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "endLagSpr"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                atk->endLagSpr = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "onlyFirstHit"))
-            {
-                tokIdx++;
-                atk->onlyFirstHit = jsonBoolean(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "iframe_timer"))
-            {
-                tokIdx++;
-                atk->iFrames = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "attack_frames"))
-            {
-                // Move to the array, get the size
-                tokIdx++;
-                atk->numAttackFrames = toks[tokIdx].size;
-
-                // Allocate memory
-                atk->attackFrames = calloc(atk->numAttackFrames, sizeof(attackFrame_t));
-
-                tokIdx++;
-                for(uint8_t frmIdx = 0; frmIdx < atk->numAttackFrames; frmIdx++)
-                {
-                    tokIdx = parseJsonAttackFrame(jsonStr, toks, tokIdx, loadedSprites, &atk->attackFrames[frmIdx]);
-                }
-                numFieldsParsed++;
-            }
-        }
-        else
-        {
-            ESP_LOGE("JSON", "Non-string key!!");
-        }
-
-        // Check to return
-        if(numFieldsParsed == numFieldsToParse)
-        {
-            return tokIdx;
-        }
+        freeFighterData(ftrData);
+        return NULL;
     }
-    return tokIdx;
-}
+    const uint8_t* data = ftrData->map.data;
 
-/**
- * @brief Parse an attack frame object from a JSON string
- *
- * @param jsonStr The whole JSON string
- * @param toks An array of JSON tokens
- * @param tokIdx The index of the current JSON token
- * @param loadedSprites A list of sprites, used for loading
- * @param ftr The attack frame to parse data into
- * @return int32_t The index of the JSON token after parsing
- */
-int32_t parseJsonAttackFrame(char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites, attackFrame_t* frm)
-{
-    // Each attack is an object
-    if(JSMN_OBJECT != toks[tokIdx].type)
+    // Check everything before trusting any of it
+    if(!validateFighterData(data, ftrData->map.size))
     {
-        ESP_LOGE("JSON", "Non-object!!");
+        ESP_LOGE("FTR", "%s isn't valid fighter data", FIGHTER_DATA_FILE);
+        freeFighterData(ftrData);
+        return NULL;
     }
+    const ftrDataHeader_t* hdr = (const ftrDataHeader_t*)data;
 
-    // Keep track of fields so we know when we're done
-    uint8_t numFieldsParsed = 0;
-    uint8_t numFieldsToParse = toks[tokIdx].size;
-
-    // Move to the first field
-    tokIdx++;
-
-    // Parse the tokens
-    while(true)
+    fighter_t* fighters = arenaAlloc(arena, hdr->numFighters * sizeof(fighter_t));
+    wsg_t** sprTable = arenaAlloc(arena, hdr->numSprites * sizeof(wsg_t*));
+    if((NULL == fighters) || (NULL == sprTable))
     {
-        if(JSMN_STRING == toks[tokIdx].type)
-        {
-            if (0 == jsoneq(jsonStr, &toks[tokIdx], "duration"))
-            {
-                tokIdx++;
-                frm->duration = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "sprite"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                frm->sprite = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "sprite_offset_x"))
-            {
-                tokIdx++;
-                frm->sprite_offset.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "sprite_offset_y"))
-            {
-                tokIdx++;
-                frm->sprite_offset.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "hurtbox_offset_x"))
-            {
-                tokIdx++;
-                frm->hurtbox_offset.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "hurtbox_offset_y"))
-            {
-                tokIdx++;
-                frm->hurtbox_offset.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "hurtbox_size_x"))
-            {
-                tokIdx++;
-                frm->hurtbox_size.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "hurtbox_size_y"))
-            {
-                tokIdx++;
-                frm->hurtbox_size.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "iframe_timer"))
-            {
-                tokIdx++;
-                frm->iFrames = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "velo_x"))
-            {
-                tokIdx++;
-                frm->velocity.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "velo_y"))
-            {
-                tokIdx++;
-                frm->velocity.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if (0 == jsoneq(jsonStr, &toks[tokIdx], "hitboxes"))
-            {
-                // Move to the array, get the size
-                tokIdx++;
-                frm->numHitboxes = toks[tokIdx].size;
-
-                // Allocate memory
-                frm->hitboxes = calloc(frm->numHitboxes, sizeof(attackHitbox_t));
-
-                // Move to the first object and start parsing
-                tokIdx++;
-                for(uint8_t hbxIdx = 0; hbxIdx < frm->numHitboxes; hbxIdx++)
-                {
-                    tokIdx = parseJsonAttackFrameHitbox(jsonStr, toks, tokIdx, loadedSprites, &frm->hitboxes[hbxIdx]);
-                }
-                numFieldsParsed++;
-            }
-        }
-        else
-        {
-            ESP_LOGE("JSON", "Non-string key!!");
-        }
+        freeFighterData(ftrData);
+        return NULL;
+    }
 
-        // Check to return
-        if(numFieldsParsed == numFieldsToParse)
+    // Load each sprite once. Sprite 0 is no sprite
+    const uint32_t* spriteNames = (const uint32_t*)&data[hdr->spriteNamesOffset];
+    ftrData->sprites = sprTable;
+    ftrData->numSprites = hdr->numSprites;
+    for(uint8_t sprIdx = 1; sprIdx < hdr->numSprites; sprIdx++)
+    {
+        sprTable[sprIdx] = cacheWsg((const char*)&data[spriteNames[sprIdx]]);
+        if(NULL == sprTable[sprIdx])
         {
-            return tokIdx;
+            ESP_LOGE("FTR", "Couldn't load %s", (const char*)&data[spriteNames[sprIdx]]);
+            // Release the sprites loaded so far, the rest of the table is NULL
+            freeFighterData(ftrData);
+            return NULL;
         }
     }
-    return tokIdx;
-}
 
-/**
- * @brief Parse an attack hitbox object from a JSON string
- *
- * @param jsonStr The whole JSON string
- * @param toks An array of JSON tokens
- * @param tokIdx The index of the current JSON token
- * @param loadedSprites A list of sprites, used for loading
- * @param ftr The attack hitbox to parse data into
- * @return int32_t The index of the JSON token after parsing
- */
-int32_t parseJsonAttackFrameHitbox(char* jsonStr, jsmntok_t* toks, int32_t tokIdx, list_t* loadedSprites,
-                                   attackHitbox_t* hbx)
-{
-    // Each attack is an object
-    if(JSMN_OBJECT != toks[tokIdx].type)
+    // Copy each fighter's attributes, and point its attacks at their frames
+    const ftrFighterRec_t* recs = (const ftrFighterRec_t*)&data[hdr->fightersOffset];
+    for(uint8_t ftrIdx = 0; ftrIdx < hdr->numFighters; ftrIdx++)
     {
-        ESP_LOGE("JSON", "Non-object!!");
-    }
-
-    // Keep track of fields so we know when we're done
-    uint8_t numFieldsParsed = 0;
-    uint8_t numFieldsToParse = toks[tokIdx].size;
+        const ftrFighterRec_t* rec = &recs[ftrIdx];
+        fighter_t* ftr = &fighters[ftrIdx];
 
-    // Move to the first field
-    tokIdx++;
+        ftr->gravity          = rec->gravity;
+        ftr->jump_velo        = rec->jump_velo;
+        ftr->run_accel        = rec->run_accel;
+        ftr->run_decel        = rec->run_decel;
+        ftr->run_max_velo     = rec->run_max_velo;
+        ftr->size.x           = rec->size_x;
+        ftr->size.y           = rec->size_y;
+        ftr->originalSize     = ftr->size;
+        ftr->numJumps         = rec->numJumps;
+        ftr->landingLag       = rec->landingLag;
+        ftr->sprites          = sprTable;
+        ftr->idleSprite0      = sprTable[rec->idleSprite0];
+        ftr->idleSprite1      = sprTable[rec->idleSprite1];
+        ftr->runSprite0       = sprTable[rec->runSprite0];
+        ftr->runSprite1       = sprTable[rec->runSprite1];
+        ftr->jumpSprite       = sprTable[rec->jumpSprite];
+        ftr->duckSprite       = sprTable[rec->duckSprite];
+        ftr->landingLagSprite = sprTable[rec->landingLagSprite];
 
-    // Parse the tokens
-    while(true)
-    {
-        if(JSMN_STRING == toks[tokIdx].type)
-        {
-            if(0 == jsoneq(jsonStr, &toks[tokIdx], "relativePos_x"))
-            {
-                tokIdx++;
-                hbx->hitboxPos.x = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "relativePos_y"))
-            {
-                tokIdx++;
-                hbx->hitboxPos.y = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "size_x"))
-            {
-                tokIdx++;
-                hbx->hitboxSize.x = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "size_y"))
-            {
-                tokIdx++;
-                hbx->hitboxSize.y = SF * jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "damage"))
-            {
-                tokIdx++;
-                hbx->damage = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "knockback_x"))
-            {
-                tokIdx++;
-                hbx->knockback.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "knockback_y"))
-            {
-                tokIdx++;
-                hbx->knockback.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "hitstun"))
-            {
-                tokIdx++;
-                hbx->hitstun = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "isProjectile"))
-            {
-                tokIdx++;
-                hbx->isProjectile = jsonBoolean(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileSprite"))
-            {
-                tokIdx++;
-                char* name = jsonString(jsonStr, toks[tokIdx]);
-                hbx->projSprite = loadFighterSprite(name, loadedSprites);
-                free(name);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileDuration"))
-            {
-                tokIdx++;
-                hbx->projDuration = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileVelo_x"))
-            {
-                tokIdx++;
-                hbx->projVelo.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileVelo_y"))
-            {
-                tokIdx++;
-                hbx->projVelo.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileAccel_x"))
-            {
-                tokIdx++;
-                hbx->projAccel.x = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-            else if(0 == jsoneq(jsonStr, &toks[tokIdx], "projectileAccel_y"))
-            {
-                tokIdx++;
-                hbx->projAccel.y = jsonInteger(jsonStr, toks[tokIdx]);
-                tokIdx++;
-                numFieldsParsed++;
-            }
-        }
-        else
+        for(uint8_t atkIdx = 0; atkIdx < NUM_ATTACKS; atkIdx++)
         {
-            ESP_LOGE("JSON", "Non-string key!!");
-        }
+            const ftrAttackRec_t* atkRec = &rec->attacks[atkIdx];
+            attack_t* atk = &ftr->attacks[atkIdx];
 
-        // Check to return
-        if(numFieldsParsed == numFieldsToParse)
-        {
-            return tokIdx;
+            atk->startupLag      = atkRec->startupLag;
+            atk->endLag          = atkRec->endLag;
+            atk->landingLag      = atkRec->landingLag;
+            atk->iFrames         = atkRec->iFrames;
+            atk->onlyFirstHit    = atkRec->onlyFirstHit;
+            atk->startupLagSpr   = sprTable[atkRec->startupLagSpr];
+            atk->endLagSpr       = sprTable[atkRec->endLagSpr];
+            atk->attackFrames    = (const attackFrame_t*)&data[atkRec->framesOffset];
+            atk->numAttackFrames = atkRec->numAttackFrames;
         }
     }
-    return tokIdx;
+
+    *numFighters = hdr->numFighters;
+    return fighters;
 }
 
 /**
- * @brief Free all the data associated with an array of fighters
+ * @brief Get an attack frame's hitboxes, which follow it in the fighter data
  *
- * @param fighters A pointer to fighter data to free
- * @param numFighters The number of fighters to free
+ * @param frm The attack frame
+ * @return A pointer to the first of the frame's numHitboxes hitboxes
  */
-void freeFighterData(fighter_t* fighters, uint8_t numFighters)
+const attackHitbox_t* getAttackHitboxes(const attackFrame_t* frm)
 {
-    for(uint8_t ftrIdx = 0; ftrIdx < numFighters; ftrIdx++)
-    {
-        fighter_t* ftr = &fighters[ftrIdx];
-        for(uint8_t atkIdx = 0; atkIdx < NUM_ATTACKS; atkIdx++)
-        {
-            attack_t* atk = &ftr->attacks[atkIdx];
-            for(uint8_t atkFrameIdx = 0; atkFrameIdx < atk->numAttackFrames; atkFrameIdx++)
-            {
-                attackFrame_t* frm = &atk->attackFrames[atkFrameIdx];
-                // for(uint8_t hbIdx = 0; hbIdx < frm->numHitboxes; hbIdx++)
-                // {
-                //     attackHitbox_t * hbx = &frm->hitboxes[hbIdx];
-                // }
-                free(frm->hitboxes);
-            }
-            free(atk->attackFrames);
-        }
-        // attacks isn't dynamically allocated
-    }
-    free(fighters);
+    return (const attackHitbox_t*)((const uint8_t*)frm + frm->hitboxesOffset);
 }
 
 /**
- * Load a sprite, or return a pointer to that sprite if it's already loaded.
- * When loading a sprite, add it to loadedSprites.
+ * Release the fighter data and all loaded sprites. The sprites stay in the
+ * asset cache, so loading them again is free. Attack frames and hitboxes must
+ * not be used after
  *
- * @param name The name of the sprite to load
- * @param loadedSprites A linked list of loaded sprites
- * @return A pointer to a wsg_t sprite
+ * @param ftrData The fighter data to release
  */
-wsg_t* loadFighterSprite(char* name, list_t* loadedSprites)
+void freeFighterData(fighterData_t* ftrData)
 {
-    // Iterate through the list of loaded sprites and look to see if this
-    // has been loaded already. If so, return it
-    node_t* currentNode = loadedSprites->first;
-    while (currentNode != NULL)
+    // Sprite 0 is no sprite
+    for(uint8_t sprIdx = 1; sprIdx < ftrData->numSprites; sprIdx++)
     {
-        if(0 == strcmp(((namedSprite_t*)currentNode->val)->name, name))
+        if(NULL != ftrData->sprites[sprIdx])
         {
-            // Name matches, so return this loaded sprite
-            return &((namedSprite_t*)currentNode->val)->sprite;
+            releaseWsg(ftrData->sprites[sprIdx]);
         }
-        // Name didn't match, so iterate
-        currentNode = currentNode->next;
     }
+    ftrData->sprites = NULL;
+    ftrData->numSprites = 0;
 
-    // Made it this far, which means it isn't loaded yet.
-    // Allocate a new sprite
-    namedSprite_t* newSprite = calloc(1, sizeof(namedSprite_t));
-
-    // Load the sprite
-    loadWsg(name, &(newSprite->sprite));
-    // Copy the name
-    newSprite->name = calloc(1, strlen(name) + 1);
-    memcpy(newSprite->name, name, strlen(name) + 1);
-
-    // Add the loaded sprite to the list
-    push(loadedSprites, newSprite);
-
-    // Return the loaded sprite
-    return &(newSprite->sprite);
-}
-
-/**
- * Free all loaded sprites
- *
- * @param loadedSprites a list of sprites to free
- */
-void freeFighterSprites(list_t* loadedSprites)
-{
-    // Pop and free all sprites
-    namedSprite_t* toFree;
-    while (NULL != (toFree = pop(loadedSprites)))
+    spiffsUnmapFile(&ftrData->map);
+    if(ftrData->packHeld)
     {
-        // Free the fields
-        freeWsg(&(toFree->sprite));
-        free(toFree->name);
-        // Free the named sprite
-        free(toFree);
+        spiffsClosePack();
+        ftrData->packHeld = false;
     }
 }
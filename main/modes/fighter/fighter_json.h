@@ -2,12 +2,97 @@
 #define _FIGHTER_JSON_H_
 
 #include "mode_fighter.h"
-#include "linked_list.h"
+#include "arena.h"
+#include "spiffs_manager.h"
 
-fighter_t* loadJsonFighterData(uint8_t* numFighters, list_t* loadedSprites);
-void freeFighterData(fighter_t* fighter, uint8_t numFighters);
+/*
+ * Fighter data is compiled from JSON by spiffs_file_preprocessor into one flat
+ * file, which is mapped whole. Attack frames and hitboxes are used in place, so
+ * their records are laid out exactly like attackFrame_t and attackHitbox_t.
+ * All integers are little-endian and every record starts on a four byte
+ * boundary. Offsets are from the start of the file unless noted otherwise:
+ *
+ *   Header, ftrDataHeader_t:
+ *     [4]  FIGHTER_DATA_MAGIC
+ *     [2]  FIGHTER_DATA_VERSION
+ *     [1]  The number of fighters
+ *     [1]  The number of sprites, including the empty sprite 0
+ *     [2]  sizeof(attackFrame_t)
+ *     [2]  sizeof(attackHitbox_t)
+ *     [4]  The offset of the sprite name table
+ *     [4]  The offset of the fighter records
+ *   The fighter records, ftrFighterRec_t, each followed by its NUM_ATTACKS
+ *   attack records. Sizes are scaled by SF
+ *   The attack frames, as attackFrame_t. Each attack's frames are contiguous
+ *   and hitboxesOffset is from the frame itself
+ *   The hitboxes, as attackHitbox_t. Positions and sizes are scaled by SF
+ *   The sprite name table, one entry per sprite:
+ *     [4]  The offset of the sprite's NUL terminated file name, 0 for sprite 0
+ *   The sprite names
+ *
+ * These must match spiffs_file_preprocessor/fighter_processor.c
+ */
+#define FIGHTER_DATA_FILE    "test.ftr"
+#define FIGHTER_DATA_MAGIC   "SWFT"
+#define FIGHTER_DATA_VERSION 1
 
-void freeFighterSprites(list_t* loadedSprites);
-wsg_t* loadFighterSprite(char* name, list_t* loadedSprites);
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint8_t numFighters;
+    uint8_t numSprites;
+    uint16_t frameSize;
+    uint16_t hitboxSize;
+    uint32_t spriteNamesOffset;
+    uint32_t fightersOffset;
+} ftrDataHeader_t;
 
-#endif
\ No newline at end of file
+typedef struct
+{
+    uint32_t framesOffset;
+    uint16_t startupLag;
+    uint16_t endLag;
+    uint16_t landingLag;
+    uint16_t iFrames;
+    uint16_t startupLagSpr;
+    uint16_t endLagSpr;
+    uint8_t numAttackFrames;
+    bool onlyFirstHit;
+} ftrAttackRec_t;
+
+typedef struct
+{
+    int32_t gravity;
+    int32_t jump_velo;
+    int32_t run_accel;
+    int32_t run_decel;
+    int32_t run_max_velo;
+    int32_t size_x;
+    int32_t size_y;
+    uint16_t landingLag;
+    uint8_t numJumps;
+    uint16_t idleSprite0;
+    uint16_t idleSprite1;
+    uint16_t runSprite0;
+    uint16_t runSprite1;
+    uint16_t jumpSprite;
+    uint16_t duckSprite;
+    uint16_t landingLagSprite;
+    ftrAttackRec_t attacks[NUM_ATTACKS];
+} ftrFighterRec_t;
+
+/* The loaded fighter data, which is used in place until freeFighterData() */
+typedef struct
+{
+    spiffsMap_t map;
+    bool packHeld;      ///< true if the asset pack is held open for the map
+    wsg_t** sprites;    ///< The loaded sprites, indexed by sprite index
+    uint8_t numSprites;
+} fighterData_t;
+
+fighter_t* loadFighterData(arena_t* arena, fighterData_t* ftrData, uint8_t* numFighters);
+const attackHitbox_t* getAttackHitboxes(const attackFrame_t* frm);
+void freeFighterData(fighterData_t* ftrData);
+
+#endif
@@ -0,0 +1,165 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "fighter_replay.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#define REPLAY_HEADER_SIZE 8
+#define REPLAY_FRAME_SIZE  (2 * NUM_FIGHTERS)
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+// Where to record matches to, or NULL to not record
+static const char* recordPath = NULL;
+static FILE* recordFile = NULL;
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Set the file that matches are recorded to. Nothing is recorded unless
+ * this is called before the match starts
+ *
+ * @param path The file to record to, which is overwritten, or NULL to stop
+ *             recording
+ */
+void setFighterRecordFile(const char* path)
+{
+    recordPath = path;
+}
+
+/**
+ * @brief Start recording a match, if there is a file to record to
+ */
+void startFighterRecording(void)
+{
+    stopFighterRecording();
+    if(NULL == recordPath)
+    {
+        return;
+    }
+
+    recordFile = fopen(recordPath, "wb");
+    if(NULL == recordFile)
+    {
+        ESP_LOGE("FTR", "Couldn't record to %s", recordPath);
+        return;
+    }
+
+    uint8_t header[REPLAY_HEADER_SIZE] =
+    {
+        FIGHTER_REPLAY_MAGIC[0], FIGHTER_REPLAY_MAGIC[1],
+        FIGHTER_REPLAY_MAGIC[2], FIGHTER_REPLAY_MAGIC[3],
+        FIGHTER_REPLAY_VERSION & 0xFF, (FIGHTER_REPLAY_VERSION >> 8) & 0xFF,
+        NUM_FIGHTERS, 0,
+    };
+    fwrite(header, 1, sizeof(header), recordFile);
+}
+
+/**
+ * @brief Record one frame's inputs, if a match is being recorded
+ *
+ * @param inputs The inputs for the frame
+ */
+void recordFighterInputs(const fighterInputs_t* inputs)
+{
+    if(NULL == recordFile)
+    {
+        return;
+    }
+
+    uint8_t frame[REPLAY_FRAME_SIZE];
+    for(uint8_t i = 0; i < NUM_FIGHTERS; i++)
+    {
+        frame[(2 * i) + 0] = inputs->btnState[i] & 0xFF;
+        frame[(2 * i) + 1] = (inputs->btnState[i] >> 8) & 0xFF;
+    }
+    fwrite(frame, 1, sizeof(frame), recordFile);
+}
+
+/**
+ * @brief Stop recording a match and close the file
+ */
+void stopFighterRecording(void)
+{
+    if(NULL != recordFile)
+    {
+        fclose(recordFile);
+        recordFile = NULL;
+    }
+}
+
+/**
+ * @brief Load a recorded match's inputs
+ *
+ * @param path The file to load
+ * @param numFrames A pointer to return the number of frames through
+ * @return The inputs for each frame, which must be freed with free(), or NULL
+ *         if the file couldn't be loaded
+ */
+fighterInputs_t* loadFighterReplay(const char* path, uint32_t* numFrames)
+{
+    *numFrames = 0;
+
+    FILE* fp = fopen(path, "rb");
+    if(NULL == fp)
+    {
+        ESP_LOGE("FTR", "Couldn't open %s", path);
+        return NULL;
+    }
+
+    uint8_t header[REPLAY_HEADER_SIZE];
+    if((sizeof(header) != fread(header, 1, sizeof(header), fp)) ||
+            (0 != memcmp(header, FIGHTER_REPLAY_MAGIC, 4)) ||
+            (FIGHTER_REPLAY_VERSION != (header[4] | (header[5] << 8))) ||
+            (NUM_FIGHTERS != header[6]))
+    {
+        ESP_LOGE("FTR", "%s isn't a replay this version can play", path);
+        fclose(fp);
+        return NULL;
+    }
+
+    // The frames are the rest of the file. A partial last frame is ignored
+    fseek(fp, 0, SEEK_END);
+    long fileSize = ftell(fp);
+    fseek(fp, REPLAY_HEADER_SIZE, SEEK_SET);
+    uint32_t frames = (fileSize - REPLAY_HEADER_SIZE) / REPLAY_FRAME_SIZE;
+
+    fighterInputs_t* inputs = calloc(frames ? frames : 1, sizeof(fighterInputs_t));
+    if(NULL == inputs)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    for(uint32_t fIdx = 0; fIdx < frames; fIdx++)
+    {
+        uint8_t frame[REPLAY_FRAME_SIZE];
+        if(sizeof(frame) != fread(frame, 1, sizeof(frame), fp))
+        {
+            frames = fIdx;
+            break;
+        }
+        for(uint8_t i = 0; i < NUM_FIGHTERS; i++)
+        {
+            inputs[fIdx].btnState[i] = frame[(2 * i) + 0] | (frame[(2 * i) + 1] << 8);
+        }
+    }
+    fclose(fp);
+
+    *numFrames = frames;
+    return inputs;
+}
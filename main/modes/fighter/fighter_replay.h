@@ -0,0 +1,29 @@
+#ifndef _FIGHTER_REPLAY_H_
+#define _FIGHTER_REPLAY_H_
+
+#include "mode_fighter.h"
+
+/*
+ * A replay is the inputs of every frame of a match. Matches are deterministic,
+ * so stepping a fresh game with the same inputs plays the match out again.
+ * All integers are little-endian:
+ *
+ *   Header:
+ *     [4]  FIGHTER_REPLAY_MAGIC
+ *     [2]  FIGHTER_REPLAY_VERSION
+ *     [1]  The number of fighters, NUM_FIGHTERS
+ *     [1]  Reserved, 0
+ *   Then for each frame, for each fighter:
+ *     [2]  The button state
+ */
+#define FIGHTER_REPLAY_MAGIC   "SWFR"
+#define FIGHTER_REPLAY_VERSION 1
+
+void setFighterRecordFile(const char* path);
+void startFighterRecording(void);
+void recordFighterInputs(const fighterInputs_t* inputs);
+void stopFighterRecording(void);
+
+fighterInputs_t* loadFighterReplay(const char* path, uint32_t* numFrames);
+
+#endif
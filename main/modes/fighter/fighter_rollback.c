@@ -0,0 +1,394 @@
+/*
+ * How far apart the two Swadges can get bounds how much of each ring is in use.
+ * The game stalls instead of running more than ROLLBACK_MAX_FRAMES ahead of the
+ * remote input it has, and each side's input runs ROLLBACK_INPUT_DELAY frames
+ * ahead of its game. So the unacknowledged local input, the oldest of which is
+ * resent in every packet, is at most (2 * ROLLBACK_MAX_FRAMES) +
+ * (2 * ROLLBACK_INPUT_DELAY) frames, and the remote input from the last
+ * confirmed frame to the newest one which can arrive is about as long. Both fit
+ * in ROLLBACK_INPUT_RING.
+ *
+ * Snapshots are only needed from the first frame without confirmed remote input
+ * to the current frame, which is at most ROLLBACK_MAX_FRAMES back.
+ */
+
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "fighter_rollback.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* There is no frame to roll back to */
+#define ROLLBACK_NONE UINT32_MAX
+
+/* After waiting a frame for the remote to catch up, don't wait again for this long */
+#define ROLLBACK_SYNC_INTERVAL 10
+
+//==============================================================================
+// Prototypes
+//==============================================================================
+
+static void getRollbackInputs(fighterRollback_t* rb, uint32_t frame, fighterInputs_t* inputs);
+static void saveRollbackSyncHash(fighterRollback_t* rb, const fighterGameState_t* state,
+                                 const fighterStage_t* stage);
+static int8_t getRollbackAdvantage(const fighterRollback_t* rb);
+static void setU32(uint8_t* dst, uint32_t val);
+static uint32_t getU32(const uint8_t* src);
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Start rollback for a new match. Both Swadges must start the match from
+ * the same state
+ *
+ * @param rb The rollback state to start
+ * @param localIdx The index of the local player's fighter
+ */
+void initFighterRollback(fighterRollback_t* rb, uint8_t localIdx)
+{
+    memset(rb, 0, sizeof(fighterRollback_t));
+    rb->localIdx = localIdx;
+    rb->rollbackFrame = ROLLBACK_NONE;
+    for(uint8_t i = 0; i < ROLLBACK_INPUT_RING; i++)
+    {
+        rb->syncHashes[i].frame = UINT32_MAX;
+    }
+
+    // Local input is delayed by starting with this many frames of no input
+    rb->localFrames = ROLLBACK_INPUT_DELAY;
+}
+
+/**
+ * @brief Get the inputs for a frame. Remote input which hasn't arrived is
+ * predicted, and the prediction is saved to check when it does arrive
+ *
+ * @param rb The rollback state
+ * @param frame The frame to get inputs for
+ * @param inputs Where to put the inputs
+ */
+static void getRollbackInputs(fighterRollback_t* rb, uint32_t frame, fighterInputs_t* inputs)
+{
+    uint16_t remoteBtnState;
+    if(frame < rb->remoteFrames)
+    {
+        remoteBtnState = rb->remoteInputs[frame % ROLLBACK_INPUT_RING];
+    }
+    else
+    {
+        // Predict the remote player is still holding the same buttons
+        remoteBtnState = (0 == rb->remoteFrames) ? 0 :
+                         rb->remoteInputs[(rb->remoteFrames - 1) % ROLLBACK_INPUT_RING];
+        rb->remoteInputs[frame % ROLLBACK_INPUT_RING] = remoteBtnState;
+    }
+
+    inputs->btnState[rb->localIdx] = rb->localInputs[frame % ROLLBACK_INPUT_RING];
+    inputs->btnState[1 - rb->localIdx] = remoteBtnState;
+}
+
+/**
+ * @brief Hash the latest state which only depends on confirmed input, if it's
+ * newer than the last one hashed. The remote compares it to its own
+ *
+ * @param rb The rollback state
+ * @param state The current game state
+ * @param stage The stage the match is played on
+ */
+static void saveRollbackSyncHash(fighterRollback_t* rb, const fighterGameState_t* state,
+                                 const fighterStage_t* stage)
+{
+    uint32_t syncFrame = (rb->remoteFrames < rb->frame) ? rb->remoteFrames : rb->frame;
+    if(syncFrame <= rb->syncFrame)
+    {
+        return;
+    }
+
+    const fighterGameState_t* syncState = (syncFrame == rb->frame) ? state :
+                                          &rb->snapshots[syncFrame % ROLLBACK_SNAPSHOTS];
+    rb->syncFrame = syncFrame;
+    rb->syncHashes[syncFrame % ROLLBACK_INPUT_RING].frame = syncFrame;
+    rb->syncHashes[syncFrame % ROLLBACK_INPUT_RING].hash = hashFighterGame(syncState, stage);
+}
+
+/**
+ * @param rb The rollback state
+ * @return How many frames the local game is ahead of the remote's, as of the
+ *         remote's latest packet
+ */
+static int8_t getRollbackAdvantage(const fighterRollback_t* rb)
+{
+    int32_t advantage = (int32_t)(rb->frame - rb->remoteFrame);
+    if(advantage > INT8_MAX)
+    {
+        return INT8_MAX;
+    }
+    else if(advantage < INT8_MIN)
+    {
+        return INT8_MIN;
+    }
+    return advantage;
+}
+
+/**
+ * @brief Advance the match by a frame, if it can be. First, if a prediction was
+ * wrong, the state is rolled back and the frames since are simulated again.
+ * Then the next frame is simulated, unless the remote input is too far behind
+ * or the remote game is, in which case this waits a frame instead
+ *
+ * @param rb The rollback state
+ * @param state The game state to advance
+ * @param stage The stage the match is played on
+ * @param localBtnState The local player's buttons, used ROLLBACK_INPUT_DELAY
+ *                      frames from now
+ * @return true if the match advanced, false if it waited
+ */
+bool advanceFighterRollback(fighterRollback_t* rb, fighterGameState_t* state,
+                            fighterStage_t* stage, uint16_t localBtnState)
+{
+    rb->ticksSinceRx++;
+
+    // Don't predict too far ahead
+    if(rb->frame >= rb->remoteFrames + ROLLBACK_MAX_FRAMES)
+    {
+        rb->stats.stalls++;
+        return false;
+    }
+
+    // If this game is ahead of the remote's, by more than latency explains,
+    // wait a frame now and then so the remote doesn't have to roll back as far
+    if(rb->syncCooldown > 0)
+    {
+        rb->syncCooldown--;
+    }
+    else if((rb->stats.packetsReceived > 0) &&
+            ((getRollbackAdvantage(rb) - rb->remoteAdvantage) / 2 >= 1))
+    {
+        rb->syncCooldown = ROLLBACK_SYNC_INTERVAL;
+        rb->stats.syncWaits++;
+        return false;
+    }
+
+    rb->localInputs[rb->localFrames % ROLLBACK_INPUT_RING] = localBtnState;
+    rb->localFrames++;
+
+    fighterInputs_t inputs;
+
+    // If a prediction was wrong, restore the state from before that frame and
+    // simulate again up to the current frame
+    if(ROLLBACK_NONE != rb->rollbackFrame)
+    {
+        uint32_t numFrames = rb->frame - rb->rollbackFrame;
+        rb->stats.rollbacks++;
+        rb->stats.framesResimulated += numFrames;
+        if(numFrames > rb->stats.maxRollback)
+        {
+            rb->stats.maxRollback = numFrames;
+        }
+
+        *state = rb->snapshots[rb->rollbackFrame % ROLLBACK_SNAPSHOTS];
+        for(uint32_t frame = rb->rollbackFrame; frame < rb->frame; frame++)
+        {
+            rb->snapshots[frame % ROLLBACK_SNAPSHOTS] = *state;
+            getRollbackInputs(rb, frame, &inputs);
+            stepFighterGame(state, stage, &inputs);
+        }
+        rb->rollbackFrame = ROLLBACK_NONE;
+    }
+
+    // Save the state, then simulate the next frame
+    rb->snapshots[rb->frame % ROLLBACK_SNAPSHOTS] = *state;
+    getRollbackInputs(rb, rb->frame, &inputs);
+    stepFighterGame(state, stage, &inputs);
+    rb->frame++;
+
+    saveRollbackSyncHash(rb, state, stage);
+    return true;
+}
+
+/**
+ * @brief Get a frame's inputs, if they're final. This is for recording
+ *
+ * @param rb The rollback state
+ * @param frame The frame to get inputs for
+ * @param inputs Where to put the inputs
+ * @return true if both players' input for the frame is confirmed, false if not
+ */
+bool getConfirmedFighterInputs(const fighterRollback_t* rb, uint32_t frame,
+                               fighterInputs_t* inputs)
+{
+    if((frame >= rb->localFrames) || (frame >= rb->remoteFrames) ||
+            (rb->localFrames - frame > ROLLBACK_INPUT_RING) ||
+            (rb->remoteFrames - frame > ROLLBACK_INPUT_RING))
+    {
+        return false;
+    }
+    inputs->btnState[rb->localIdx] = rb->localInputs[frame % ROLLBACK_INPUT_RING];
+    inputs->btnState[1 - rb->localIdx] = rb->remoteInputs[frame % ROLLBACK_INPUT_RING];
+    return true;
+}
+
+/**
+ * @brief Write a little-endian 32 bit integer
+ *
+ * @param dst Where to write it
+ * @param val The integer
+ */
+static void setU32(uint8_t* dst, uint32_t val)
+{
+    dst[0] = (val >> 0) & 0xFF;
+    dst[1] = (val >> 8) & 0xFF;
+    dst[2] = (val >> 16) & 0xFF;
+    dst[3] = (val >> 24) & 0xFF;
+}
+
+/**
+ * @brief Read a little-endian 32 bit integer
+ *
+ * @param src Where to read it from
+ * @return The integer
+ */
+static uint32_t getU32(const uint8_t* src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+/**
+ * @brief Check if a received ESP-NOW packet is a fighter input packet
+ *
+ * @param data The packet
+ * @param len The length of the packet
+ * @return true if it's an input packet, false if it's something else
+ */
+bool isFighterInputPacket(const uint8_t* data, uint8_t len)
+{
+    return (len >= ROLLBACK_HEADER_SIZE) &&
+           (0 == memcmp(data, FIGHTER_INPUT_TAG, sizeof(FIGHTER_INPUT_TAG) - 1));
+}
+
+/**
+ * @brief Build the packet to send this frame, with the oldest local input the
+ * remote hasn't acknowledged
+ *
+ * @param rb The rollback state
+ * @param pkt A buffer of at least ROLLBACK_MAX_PACKET bytes to build it in
+ * @return The length of the packet
+ */
+uint8_t buildFighterInputPacket(fighterRollback_t* rb, uint8_t* pkt)
+{
+    uint32_t firstFrame = rb->remoteAcked;
+    if(rb->localFrames - firstFrame > ROLLBACK_INPUT_RING)
+    {
+        firstFrame = rb->localFrames - ROLLBACK_INPUT_RING;
+    }
+    uint32_t numInputs = rb->localFrames - firstFrame;
+    if(numInputs > ROLLBACK_MAX_PACKET_INPUTS)
+    {
+        numInputs = ROLLBACK_MAX_PACKET_INPUTS;
+    }
+
+    memcpy(&pkt[0], FIGHTER_INPUT_TAG, 4);
+    setU32(&pkt[4], firstFrame);
+    pkt[8] = numInputs;
+    setU32(&pkt[9], rb->remoteFrames);
+    setU32(&pkt[13], rb->frame);
+    pkt[17] = (uint8_t)getRollbackAdvantage(rb);
+    setU32(&pkt[18], rb->syncFrame);
+    setU32(&pkt[22], rb->syncHashes[rb->syncFrame % ROLLBACK_INPUT_RING].hash);
+
+    uint8_t* inputs = &pkt[ROLLBACK_HEADER_SIZE];
+    for(uint32_t i = 0; i < numInputs; i++)
+    {
+        uint16_t btnState = rb->localInputs[(firstFrame + i) % ROLLBACK_INPUT_RING];
+        inputs[(2 * i) + 0] = btnState & 0xFF;
+        inputs[(2 * i) + 1] = (btnState >> 8) & 0xFF;
+    }
+
+    rb->stats.packetsSent++;
+    return ROLLBACK_HEADER_SIZE + (2 * numInputs);
+}
+
+/**
+ * @brief Process a packet from the remote. New remote input is confirmed, and
+ * if it differs from what was predicted for a frame already simulated, the
+ * next advanceFighterRollback() rolls back to that frame
+ *
+ * @param rb The rollback state
+ * @param pkt The packet, which has been checked with isFighterInputPacket()
+ * @param len The length of the packet
+ */
+void receiveFighterInputPacket(fighterRollback_t* rb, const uint8_t* pkt, uint8_t len)
+{
+    uint32_t firstFrame = getU32(&pkt[4]);
+    uint8_t numInputs = pkt[8];
+    if(len < ROLLBACK_HEADER_SIZE + (2 * numInputs))
+    {
+        ESP_LOGW("FTR", "Truncated input packet");
+        return;
+    }
+
+    rb->stats.packetsReceived++;
+    rb->ticksSinceRx = 0;
+
+    // Newer acks and frames replace older ones. Packets can arrive out of order
+    uint32_t acked = getU32(&pkt[9]);
+    if(acked > rb->remoteAcked)
+    {
+        rb->remoteAcked = acked;
+    }
+    uint32_t remoteFrame = getU32(&pkt[13]);
+    if(remoteFrame >= rb->remoteFrame)
+    {
+        rb->remoteFrame = remoteFrame;
+        rb->remoteAdvantage = (int8_t)pkt[17];
+    }
+
+    // Compare the remote's hash to this game's hash of the same frame
+    uint32_t syncFrame = getU32(&pkt[18]);
+    uint32_t syncHash = getU32(&pkt[22]);
+    if((syncFrame == rb->syncHashes[syncFrame % ROLLBACK_INPUT_RING].frame) &&
+            (syncHash != rb->syncHashes[syncFrame % ROLLBACK_INPUT_RING].hash))
+    {
+        rb->stats.desyncs++;
+        ESP_LOGE("FTR", "Desync at frame %u, %08x != %08x", (unsigned int)syncFrame,
+                 (unsigned int)rb->syncHashes[syncFrame % ROLLBACK_INPUT_RING].hash,
+                 (unsigned int)syncHash);
+    }
+
+    // Confirm any new input, in order
+    const uint8_t* inputs = &pkt[ROLLBACK_HEADER_SIZE];
+    for(uint8_t i = 0; i < numInputs; i++)
+    {
+        uint32_t frame = firstFrame + i;
+        if(frame < rb->remoteFrames)
+        {
+            // Already confirmed
+            continue;
+        }
+        else if(frame > rb->remoteFrames)
+        {
+            // There's a gap, which a later packet will fill
+            break;
+        }
+
+        uint16_t btnState = inputs[(2 * i) + 0] | (inputs[(2 * i) + 1] << 8);
+        uint16_t* saved = &rb->remoteInputs[frame % ROLLBACK_INPUT_RING];
+
+        // If this frame was simulated with a different prediction, roll back
+        if((frame < rb->frame) && (btnState != *saved) && (frame < rb->rollbackFrame))
+        {
+            rb->rollbackFrame = frame;
+        }
+        *saved = btnState;
+        rb->remoteFrames++;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef _FIGHTER_ROLLBACK_H_
+#define _FIGHTER_ROLLBACK_H_
+
+#include "mode_fighter.h"
+
+/*
+ * Rollback netcode for a match between two Swadges. Each Swadge runs the whole
+ * match. Remote input which hasn't arrived yet is predicted to be the same as
+ * the last input which did. The state is saved before every frame, so when a
+ * prediction turns out wrong, the state is restored to the first wrong frame
+ * and the frames since are simulated again with the right input.
+ *
+ * Local input is applied ROLLBACK_INPUT_DELAY frames late, which hides that
+ * much latency without rolling back. The game never runs more than
+ * ROLLBACK_MAX_FRAMES ahead of the remote input it has, and waits instead.
+ *
+ * Every frame, each Swadge sends the oldest ROLLBACK_MAX_PACKET_INPUTS of its
+ * inputs which the other hasn't acknowledged yet, so a lost packet is made up
+ * for by the next one. Packets aren't acked or retried, and fit in
+ * P2P_MAX_MSG_LEN, the most ESP-NOW receives. All integers are little-endian:
+ *
+ *   [4]  FIGHTER_INPUT_TAG
+ *   [4]  The frame of the first input
+ *   [1]  The number of inputs
+ *   [4]  The sender has the receiver's input for frames before this
+ *   [4]  The sender's current frame
+ *   [1]  The sender's frame advantage, signed
+ *   [4]  A frame whose state only depends on confirmed input
+ *   [4]  The hash of that frame's state, to detect desyncs
+ *   Then for each input:
+ *     [2]  The sender's button state for the frame
+ *
+ * Input packets share ESP-NOW with p2p messages, which start with the mode's
+ * three character message ID. The tag starts with a NUL, which no message ID
+ * can, so an input packet is never mistaken for a p2p message or vice versa
+ */
+#define FIGHTER_INPUT_TAG "\0FTI"
+
+#define ROLLBACK_MAX_FRAMES   8
+#define ROLLBACK_INPUT_DELAY  2
+#define ROLLBACK_SNAPSHOTS    (ROLLBACK_MAX_FRAMES + 1)
+/* Enough for every input either side can still need, see fighter_rollback.c */
+#define ROLLBACK_INPUT_RING   32
+#define ROLLBACK_HEADER_SIZE  26
+#define ROLLBACK_MAX_PACKET_INPUTS 16
+#define ROLLBACK_MAX_PACKET   (ROLLBACK_HEADER_SIZE + (2 * ROLLBACK_MAX_PACKET_INPUTS))
+
+typedef struct
+{
+    uint32_t packetsSent;
+    uint32_t packetsReceived;
+    uint32_t rollbacks;         ///< The number of times the state was restored
+    uint32_t framesResimulated; ///< Frames simulated again after restoring
+    uint32_t maxRollback;       ///< The most frames simulated again at once
+    uint32_t stalls;            ///< Frames waited because remote input was too late
+    uint32_t syncWaits;         ///< Frames waited to let the remote catch up
+    uint32_t desyncs;           ///< Hashes which didn't match the remote's
+} rollbackStats_t;
+
+typedef struct
+{
+    uint8_t localIdx;      ///< The index of the local fighter. The other is remote
+    uint32_t frame;        ///< The number of frames simulated
+    uint32_t localFrames;  ///< Local input is known for frames before this
+    uint32_t remoteFrames; ///< Remote input is confirmed for frames before this
+    uint32_t remoteAcked;  ///< The remote has local input for frames before this
+    uint32_t remoteFrame;  ///< The remote's frame, as of its latest packet
+    int8_t remoteAdvantage;
+    uint32_t rollbackFrame; ///< The first frame simulated with a wrong prediction
+    uint32_t syncFrame;     ///< The latest frame hashed for desync detection
+    uint8_t syncCooldown;   ///< Frames until waiting for the remote is allowed again
+    uint32_t ticksSinceRx;  ///< Calls to advanceFighterRollback() since a packet arrived
+
+    uint16_t localInputs[ROLLBACK_INPUT_RING];
+    uint16_t remoteInputs[ROLLBACK_INPUT_RING]; ///< Confirmed, or the prediction used
+    struct
+    {
+        uint32_t frame;
+        uint32_t hash;
+    } syncHashes[ROLLBACK_INPUT_RING];
+    fighterGameState_t snapshots[ROLLBACK_SNAPSHOTS]; ///< The state before each frame
+
+    rollbackStats_t stats;
+} fighterRollback_t;
+
+void initFighterRollback(fighterRollback_t* rb, uint8_t localIdx);
+bool advanceFighterRollback(fighterRollback_t* rb, fighterGameState_t* state,
+                            fighterStage_t* stage, uint16_t localBtnState);
+bool getConfirmedFighterInputs(const fighterRollback_t* rb, uint32_t frame,
+                               fighterInputs_t* inputs);
+
+bool isFighterInputPacket(const uint8_t* data, uint8_t len);
+uint8_t buildFighterInputPacket(fighterRollback_t* rb, uint8_t* pkt);
+void receiveFighterInputPacket(fighterRollback_t* rb, const uint8_t* pkt, uint8_t len);
+
+#endif
@@ -21,15 +21,32 @@
 
 #include "mode_fighter.h"
 #include "fighter_json.h"
+#include "fighter_replay.h"
+#include "fighter_rollback.h"
+#include "p2pConnection.h"
+#include "espNowUtils.h"
 #include "bresenham.h"
-#include "linked_list.h"
+#include "arena.h"
+#include "profiler.h"
 #include "led_util.h"
+#include "spiffs_pack.h"
 
 //==============================================================================
 // Constants
 //==============================================================================
 
-#define FRAME_TIME_MS 25 // 20fps
+#define FRAME_TIME_MS 25 // 40fps
+
+// Give up on a versus match after two seconds without hearing from the other Swadge
+#define VERSUS_TIMEOUT_FRAMES (2000 / FRAME_TIME_MS)
+
+// The battlefield is laid out for the 280x240 display
+#define BATTLEFIELD_W 280
+#define BATTLEFIELD_H 240
+
+// 32 bit FNV-1a, for hashing the game state
+#define FNV_OFFSET_BASIS 0x811C9DC5
+#define FNV_PRIME        0x01000193
 
 #define DRAW_DEBUG_BOXES
 
@@ -37,63 +54,96 @@
 // Structs
 //==============================================================================
 
+typedef struct
+{
+    preparedText_t text; ///< The damage percentage, laid out
+    int32_t damage;      ///< The damage the text was laid out for
+} hudDamage_t;
+
 typedef struct
 {
     int64_t frameElapsed;
+    fighterGameState_t state;
+    fighterStage_t stage;
+    uint16_t btnState; ///< The local player's buttons, applied on the next frame
     fighter_t* fighters;
     uint8_t numFighters;
-    list_t projectiles;
-    list_t loadedSprites;
+    p2pInfo p2p;
+    fighterRollback_t* rb; ///< Only used while another Swadge is connected
+    bool isVersus;
+    uint32_t framesRecorded;
+    fighterData_t ftrData;
+    bool isLoaded; ///< false if there weren't fighters to start a match with
     display_t* d;
     font_t mm_font;
+    hudDamage_t hudDamage[2];
 } fightingGame_t;
 
 //==============================================================================
 // Function Prototypes
 //==============================================================================
 
-void fighterEnterMode(display_t* disp);
+void fighterEnterMode(display_t* disp, arena_t* arena);
 void fighterExitMode(void);
 void fighterMainLoop(int64_t elapsedUs);
+void fighterFrameCb(int64_t elapsedUs);
 void fighterButtonCb(buttonEvt_t* evt);
 
-void getHurtbox(fighter_t* ftr, box_t* hurtbox);
+void getHurtbox(const fighter_t* ftr, box_t* hurtbox);
 #define setFighterState(f, st, sp, tm) _setFighterState(f, st, sp, tm, __LINE__);
 void _setFighterState(fighter_t* ftr, fighterState_t newState, wsg_t* newSprite, int32_t timer, uint32_t line);
 void setFighterRelPos(fighter_t * ftr, platformPos_t relPos, const platform_t * touchingPlatform,
     const platform_t * passingThroughPlatform, bool isInAir);
 void checkFighterButtonInput(fighter_t* ftr);
-void updateFighterPosition(fighter_t* f, const platform_t* platforms, uint8_t numPlatforms);
-void checkFighterTimer(fighter_t* ftr);
+void updateFighterPosition(fighter_t* ftr, const fighterStage_t* stage);
+void checkFighterTimer(fighter_t* ftr, uint8_t ftrIdx, projectilePool_t* pool);
 void checkFighterHitboxCollisions(fighter_t* ftr, fighter_t* otherFtr);
-void checkFighterProjectileCollisions(list_t* projectiles);
-void drawFighter(display_t* d, fighter_t* ftr);
-
-void checkProjectileTimer(list_t* projectiles, const platform_t* platforms,
-                          uint8_t numPlatforms);
-
-void drawFighterFrame(display_t* d, const platform_t* platforms,
-                      uint8_t numPlatforms);
-void drawFighterHud(display_t* d, font_t* font, fighter_t* ftr1, fighter_t* ftr2);
+void checkFighterProjectileCollisions(fighterGameState_t* state, collisionGrid_t* fighterGrid);
+void buildFighterGrid(collisionGrid_t* grid, fighter_t* fighters, uint8_t numFighters);
+void drawFighter(display_t* d, const fighter_t* ftr);
+
+void checkProjectileTimer(projectilePool_t* pool, const fighterStage_t* stage);
+void removeProjectile(projectilePool_t* pool, uint8_t idx);
+
+void drawFighterFrame(display_t* d, const fighterGameState_t* state,
+                      const fighterStage_t* stage);
+void drawFighterLoadError(display_t* d, font_t* font);
+static uint32_t hashInt(uint32_t hash, int32_t val);
+static uint32_t hashVector(uint32_t hash, vector_t vec);
+static int32_t getPlatformIdx(const fighterStage_t* stage, const platform_t* platform);
+void drawFighterHud(display_t* d, font_t* font, const fighter_t* ftr1, const fighter_t* ftr2,
+                    hudDamage_t* hudDamage);
+void drawHudDamage(display_t* d, font_t* font, hudDamage_t* hudDamage, int32_t damage,
+                   int16_t xCenter);
 
 // void fighterAccelerometerCb(accel_t* accel);
 // void fighterAudioCb(uint16_t * samples, uint32_t sampleCnt);
 // void fighterTemperatureCb(float tmp_c);
 // void fighterButtonCb(buttonEvt_t* evt);
 // void fighterTouchCb(touch_event_t* evt);
-// void fighterEspNowRecvCb(const uint8_t* mac_addr, const char* data, uint8_t len, int8_t rssi);
-// void fighterEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t status);
+void fighterEspNowRecvCb(const uint8_t* mac_addr, const char* data, uint8_t len, int8_t rssi);
+void fighterEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t status);
 
-// void fighterConCbFn(p2pInfo* p2p, connectionEvt_t evt);
-// void fighterMsgRxCbFn(p2pInfo* p2p, const char* msg, const char* payload, uint8_t len);
+void fighterConCbFn(p2pInfo* p2p, connectionEvt_t evt);
+// void fighterMsgRxCbFn(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload, uint8_t len);
 // void fighterMsgTxCbFn(p2pInfo* p2p, messageStatus_t status);
 
+void startFighterMatch(bool isVersus, uint8_t localIdx);
+void stepFighterVersus(void);
+
 //==============================================================================
 // Variables
 //==============================================================================
 
 static fightingGame_t* f;
 
+// Where the fighter loop's time goes
+PROFILE_SCOPE(profFtrInput, "ftrInput");
+PROFILE_SCOPE(profFtrMove, "ftrMove");
+PROFILE_SCOPE(profFtrTimers, "ftrTimers");
+PROFILE_SCOPE(profFtrCollide, "ftrCollide");
+PROFILE_SCOPE(profFtrDraw, "ftrDraw");
+
 swadgeMode modeFighter =
 {
     .modeName = "Fighter",
@@ -102,12 +152,14 @@ swadgeMode modeFighter =
     .fnMainLoop = fighterMainLoop,
     .fnButtonCallback = fighterButtonCb,
     .fnTouchCallback = NULL, // fighterTouchCb,
-    .wifiMode = NO_WIFI, // ESP_NOW,
-    .fnEspNowRecvCb = NULL, // fighterEspNowRecvCb,
-    .fnEspNowSendCb = NULL, // fighterEspNowSendCb,
+    .wifiMode = ESP_NOW,
+    .fnEspNowRecvCb = fighterEspNowRecvCb,
+    .fnEspNowSendCb = fighterEspNowSendCb,
     .fnAccelerometerCallback = NULL, // fighterAccelerometerCb,
     .fnAudioCallback = NULL, // fighterAudioCb,
     .fnTemperatureCallback = NULL, // fighterTemperatureCb
+    .fnFrameCallback = fighterFrameCb,
+    .frameRate = 1000 / FRAME_TIME_MS,
 };
 
 static const platform_t battlefield[] =
@@ -162,44 +214,45 @@ static const platform_t battlefield[] =
  * Initialize all data needed for the fighter game
  *
  * @param disp The display to draw to
+ * @param arena Memory for the game, which is freed when the mode exits
  */
-void fighterEnterMode(display_t* disp)
+void fighterEnterMode(display_t* disp, arena_t* arena)
 {
     // Allocate base memory for the mode
-    f = malloc(sizeof(fightingGame_t));
-    memset(f, 0, sizeof(fightingGame_t));
+    f = arenaAlloc(arena, sizeof(fightingGame_t));
 
     // Save the display
     f->d = disp;
 
+    // Open the asset pack so everything below is loaded with a single read.
+    // If there is no pack, assets are read from individual files instead
+    bool packOpen = spiffsOpenPack(ASSET_PACK_NAME);
+
     // Load a font
     loadFont("mm.font", &f->mm_font);
 
     // Load fighter data
-    f->fighters = loadJsonFighterData(&(f->numFighters), &(f->loadedSprites));
-    setFighterRelPos(&(f->fighters[0]), NOT_TOUCHING_PLATFORM, NULL, NULL, true);
-    setFighterRelPos(&(f->fighters[1]), NOT_TOUCHING_PLATFORM, NULL, NULL, true);
+    f->fighters = loadFighterData(arena, &f->ftrData, &f->numFighters);
+    f->rb = arenaAlloc(arena, sizeof(fighterRollback_t));
 
-    f->fighters[0].cAttack = NO_ATTACK;
-    f->fighters[1].cAttack = NO_ATTACK;
-
-    // three seconds @ 20fps
-    f->fighters[0].iFrameTimer = 60;
-    f->fighters[0].isInvincible = true;
-    f->fighters[1].iFrameTimer = 60;
-    f->fighters[1].isInvincible = true;
+    // Done loading
+    if(packOpen)
+    {
+        spiffsClosePack();
+    }
 
-    // Set the initial sprites
-    setFighterState((&f->fighters[0]), FS_IDLE, f->fighters[0].idleSprite0, 0);
-    setFighterState((&f->fighters[1]), FS_IDLE, f->fighters[1].idleSprite0, 0);
+    // Play locally until another Swadge connects
+    initBattlefieldStage(&f->stage);
+    startFighterMatch(false, 0);
 
-    // Start both fighters in the middle of the stage
-    f->fighters[0].pos.x = (f->d->w / 2) * SF;
-    f->fighters[1].pos.x = (f->d->w / 2) * SF;
+    // Look for another Swadge to play against
+    p2pInitialize(&f->p2p, "ftr", fighterConCbFn, NULL, -70);
+    p2pStartConnection(&f->p2p);
 
-    // Start with three stocks
-    f->fighters[0].stocks = 3;
-    f->fighters[1].stocks = 3;
+    // Damage is never negative, so the HUD's damage text is laid out when
+    // it's first drawn
+    f->hudDamage[0].damage = -1;
+    f->hudDamage[1].damage = -1;
 
     // Set some LEDs, just because
     static led_t leds[NUM_LEDS] =
@@ -215,28 +268,26 @@ void fighterEnterMode(display_t* disp)
 }
 
 /**
- * Free all data needed for the fighter game
+ * Release everything the fighter game holds outside of its arena. The game,
+ * including its projectiles, and fighter data are freed with the arena
  */
 void fighterExitMode(void)
 {
-    // Free any stray projectiles
-    projectile_t* toFree;
-    while (NULL != (toFree = pop(&f->projectiles)))
-    {
-        free(toFree);
-    }
+    // Stop looking for, or playing against, another Swadge
+    p2pDeinit(&f->p2p);
 
-    // Free fighter data
-    freeFighterData(f->fighters, f->numFighters);
+    // Finish the replay, if one is being recorded
+    stopFighterRecording();
 
-    // Free sprites
-    freeFighterSprites(&(f->loadedSprites));
+    // Free fighter data and sprites
+    freeFighterData(&f->ftrData);
+
+    // Free HUD text
+    freePreparedText(&f->hudDamage[0].text);
+    freePreparedText(&f->hudDamage[1].text);
 
     // Free font
     freeFont(&f->mm_font);
-
-    // Free game data
-    free(f);
 }
 
 /**
@@ -245,7 +296,7 @@ void fighterExitMode(void)
  * @param ftr The fighter to fill a hurtbox for
  * @param hurtbox The hurtbox to fill
  */
-void getHurtbox(fighter_t* ftr, box_t* hurtbox)
+void getHurtbox(const fighter_t* ftr, box_t* hurtbox)
 {
     if(FACING_RIGHT == ftr->dir)
     {
@@ -276,13 +327,8 @@ void _setFighterState(fighter_t* ftr, fighterState_t newState, wsg_t* newSprite,
     if((FS_ATTACK == ftr->state) && (FS_ATTACK != newState) && (ftr->cAttack < NUM_ATTACKS))
     {
         // When leaving attack state, clear all 'attackConnected'
-        ftr->attacks[ftr->cAttack].attackConnected = false;
-        attackFrame_t* atk = ftr->attacks[ftr->cAttack].attackFrames;
-        uint8_t numAttackFrames = ftr->attacks[ftr->cAttack].numAttackFrames;
-        for(uint8_t atkIdx = 0; atkIdx < numAttackFrames; atkIdx++)
-        {
-            atk[atkIdx].attackConnected = false;
-        }
+        ftr->attackConnected = false;
+        ftr->attackFramesConnected = 0;
     }
     else if((FS_DUCKING == ftr->state) && (FS_DUCKING != newState))
     {
@@ -351,8 +397,8 @@ void setFighterRelPos(fighter_t * ftr, platformPos_t relPos, const platform_t *
 
 /**
  * Run the main loop for the fighter game. When the time is ready, this will
- * handle button input synchronously, move fighters, check collisions, manage
- * projectiles, and pretty much everything else
+ * step the game one frame with the latest button input. Rendering is done
+ * separately, in fighterFrameCb()
  *
  * TODO
  *  - Knockback
@@ -363,43 +409,341 @@ void setFighterRelPos(fighter_t * ftr, platformPos_t relPos, const platform_t *
  */
 void fighterMainLoop(int64_t elapsedUs)
 {
+    // Without fighters there's no game to step
+    if(!f->isLoaded)
+    {
+        return;
+    }
+
     // Keep track of time and only calculate frames every FRAME_TIME_MS
     f->frameElapsed += elapsedUs;
     if (f->frameElapsed > (FRAME_TIME_MS * 1000))
     {
         f->frameElapsed -= (FRAME_TIME_MS * 1000);
 
-        // Check fighter button inputs
-        checkFighterButtonInput(&f->fighters[0]);
-        checkFighterButtonInput(&f->fighters[1]);
+        if(f->isVersus)
+        {
+            stepFighterVersus();
+        }
+        else
+        {
+            // The local player is the first fighter. The second has no input
+            fighterInputs_t inputs =
+            {
+                .btnState = {f->btnState, 0},
+            };
+            recordFighterInputs(&inputs);
+            stepFighterGame(&f->state, &f->stage, &inputs);
+        }
+    }
+}
+
+/**
+ * Start a new match, either alone or against another Swadge
+ *
+ * @param isVersus true if another Swadge is connected, false to play alone
+ * @param localIdx The local player's fighter, in a versus match
+ */
+void startFighterMatch(bool isVersus, uint8_t localIdx)
+{
+    f->isLoaded = initFighterGame(&f->state, &f->stage, f->fighters, f->numFighters);
+    if(!f->isLoaded)
+    {
+        // Input packets are ignored unless a versus match is running
+        f->isVersus = false;
+        return;
+    }
+
+    f->isVersus = isVersus;
+    if(isVersus)
+    {
+        initFighterRollback(f->rb, localIdx);
+    }
+    f->framesRecorded = 0;
+    startFighterRecording();
+}
+
+/**
+ * Run a frame of a versus match. The match is advanced with rollback, then this
+ * frame's input packet is sent. If the other Swadge hasn't been heard from in
+ * a while, the match ends and the search for another Swadge starts again
+ */
+void stepFighterVersus(void)
+{
+    advanceFighterRollback(f->rb, &f->state, &f->stage, f->btnState);
 
-        // Move fighters
-        updateFighterPosition(&f->fighters[0], battlefield, sizeof(battlefield) / sizeof(battlefield[0]));
-        updateFighterPosition(&f->fighters[1], battlefield, sizeof(battlefield) / sizeof(battlefield[0]));
+    // Only record input which is final
+    fighterInputs_t inputs;
+    while(getConfirmedFighterInputs(f->rb, f->framesRecorded, &inputs))
+    {
+        recordFighterInputs(&inputs);
+        f->framesRecorded++;
+    }
+
+    uint8_t pkt[ROLLBACK_MAX_PACKET];
+    uint8_t len = buildFighterInputPacket(f->rb, pkt);
+    espNowSend((const char*)pkt, len);
+
+    if(f->rb->ticksSinceRx > VERSUS_TIMEOUT_FRAMES)
+    {
+        const rollbackStats_t* stats = &f->rb->stats;
+        ESP_LOGW("FTR", "Lost the other Swadge after %u frames, %u rollbacks, %u stalls, %u desyncs",
+                 (unsigned int)f->rb->frame, (unsigned int)stats->rollbacks,
+                 (unsigned int)stats->stalls, (unsigned int)stats->desyncs);
+
+        startFighterMatch(false, 0);
+        p2pDeinit(&f->p2p);
+        p2pInitialize(&f->p2p, "ftr", fighterConCbFn, NULL, -70);
+        p2pStartConnection(&f->p2p);
+    }
+}
+
+/**
+ * Set up the battlefield stage, building its broad phase grids. Platforms don't
+ * move, so their grid is only built once. Each platform is an ID in the grid,
+ * so there can be at most GRID_MAX_IDS of them
+ *
+ * @param stage The stage to set up
+ */
+void initBattlefieldStage(fighterStage_t* stage)
+{
+    stage->platforms = battlefield;
+    stage->numPlatforms = sizeof(battlefield) / sizeof(battlefield[0]);
+    stage->bounds.x0 = 0;
+    stage->bounds.y0 = 0;
+    stage->bounds.x1 = BATTLEFIELD_W * SF;
+    stage->bounds.y1 = BATTLEFIELD_H * SF;
+
+    initCollisionGrid(&stage->platformGrid, stage->bounds);
+    for(uint8_t idx = 0; idx < stage->numPlatforms; idx++)
+    {
+        addToCollisionGrid(&stage->platformGrid, stage->platforms[idx].area, idx);
+    }
+    initCollisionGrid(&stage->fighterGrid, stage->bounds);
+}
+
+/**
+ * Start a match, with the first NUM_FIGHTERS fighters in the middle of the
+ * stage
+ *
+ * @param state The game state to start
+ * @param stage The stage the match is played on
+ * @param fighters The loaded fighters, which are copied into the state
+ * @param numFighters The number of loaded fighters
+ * @return true if the match was started, false if there weren't enough fighters
+ */
+bool initFighterGame(fighterGameState_t* state, const fighterStage_t* stage,
+                     const fighter_t* fighters, uint8_t numFighters)
+{
+    memset(state, 0, sizeof(fighterGameState_t));
+    if((NULL == fighters) || (numFighters < NUM_FIGHTERS))
+    {
+        ESP_LOGE("FTR", "Need %d fighters, have %d", NUM_FIGHTERS, (NULL == fighters) ? 0 : numFighters);
+        return false;
+    }
+
+    for(uint8_t i = 0; i < NUM_FIGHTERS; i++)
+    {
+        fighter_t* ftr = &state->fighters[i];
+        *ftr = fighters[i];
+
+        setFighterRelPos(ftr, NOT_TOUCHING_PLATFORM, NULL, NULL, true);
+        ftr->cAttack = NO_ATTACK;
+
+        // three seconds @ 20fps
+        ftr->iFrameTimer = 60;
+        ftr->isInvincible = true;
+
+        // Set the initial sprite
+        setFighterState(ftr, FS_IDLE, ftr->idleSprite0, 0);
+
+        // Start in the middle of the stage
+        ftr->pos.x = (stage->bounds.x0 + stage->bounds.x1) / 2;
+
+        // Start with three stocks
+        ftr->stocks = 3;
+    }
+    return true;
+}
+
+/**
+ * Advance a match by one frame: handle button input, move fighters, check
+ * collisions, manage projectiles, and pretty much everything else. The result
+ * only depends on the state and the inputs, so replaying the same inputs from
+ * the same state always gives the same result
+ *
+ * @param state The game state to advance
+ * @param stage The stage the match is played on
+ * @param inputs The inputs for this frame
+ */
+void stepFighterGame(fighterGameState_t* state, fighterStage_t* stage,
+                     const fighterInputs_t* inputs)
+{
+    fighter_t* ftrs = state->fighters;
+
+    // Check fighter button inputs
+    profileBegin(&profFtrInput);
+    for(uint8_t i = 0; i < NUM_FIGHTERS; i++)
+    {
+        ftrs[i].btnState = inputs->btnState[i];
+        checkFighterButtonInput(&ftrs[i]);
+    }
+    profileEnd(&profFtrInput);
+
+    // Move fighters
+    profileBegin(&profFtrMove);
+    updateFighterPosition(&ftrs[0], stage);
+    updateFighterPosition(&ftrs[1], stage);
+    profileEnd(&profFtrMove);
+
+    // Update timers. This transitions between states and spawns projectiles
+    profileBegin(&profFtrTimers);
+    checkFighterTimer(&ftrs[0], 0, &state->projectiles);
+    checkFighterTimer(&ftrs[1], 1, &state->projectiles);
+
+    // Update projectile timers. This moves projectiles and despawns if necessary
+    checkProjectileTimer(&state->projectiles, stage);
+    profileEnd(&profFtrTimers);
+
+    // Check for collisions between hitboxes and hurtboxes
+    profileBegin(&profFtrCollide);
+    checkFighterHitboxCollisions(&ftrs[0], &ftrs[1]);
+    checkFighterHitboxCollisions(&ftrs[1], &ftrs[0]);
+    // Check for collisions between projectiles and hurtboxes
+    buildFighterGrid(&stage->fighterGrid, ftrs, NUM_FIGHTERS);
+    checkFighterProjectileCollisions(state, &stage->fighterGrid);
+    profileEnd(&profFtrCollide);
+
+    state->frame++;
+}
+
+/**
+ * Add an integer to a hash, a byte at a time from the least significant byte,
+ * so hashes are the same on every platform
+ *
+ * @param hash The hash so far
+ * @param val The integer to add
+ * @return The new hash
+ */
+static uint32_t hashInt(uint32_t hash, int32_t val)
+{
+    uint32_t bytes = (uint32_t)val;
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        hash ^= (bytes & 0xFF);
+        hash *= FNV_PRIME;
+        bytes >>= 8;
+    }
+    return hash;
+}
+
+/**
+ * Add a vector to a hash
+ *
+ * @param hash The hash so far
+ * @param vec The vector to add
+ * @return The new hash
+ */
+static uint32_t hashVector(uint32_t hash, vector_t vec)
+{
+    return hashInt(hashInt(hash, vec.x), vec.y);
+}
 
-        // Update timers. This transitions between states and spawns projectiles
-        checkFighterTimer(&f->fighters[0]);
-        checkFighterTimer(&f->fighters[1]);
+/**
+ * Get the index of a platform on a stage
+ *
+ * @param stage The stage
+ * @param platform A platform on the stage, or NULL
+ * @return The platform's index, or -1 for NULL
+ */
+static int32_t getPlatformIdx(const fighterStage_t* stage, const platform_t* platform)
+{
+    return (NULL == platform) ? -1 : (platform - stage->platforms);
+}
 
-        // Update projectile timers. This moves projectiles and despawns if necessary
-        checkProjectileTimer(&f->projectiles, battlefield, sizeof(battlefield) / sizeof(battlefield[0]));
+/**
+ * Hash everything in the game state which affects how the match plays out.
+ * Pointers are hashed as indices and sprites aren't hashed at all, so the
+ * same match hashes the same in every build and on every platform
+ *
+ * @param state The game state to hash
+ * @param stage The stage the match is played on
+ * @return A 32 bit FNV-1a hash of the state
+ */
+uint32_t hashFighterGame(const fighterGameState_t* state, const fighterStage_t* stage)
+{
+    uint32_t hash = hashInt(FNV_OFFSET_BASIS, state->frame);
 
-        // Check for collisions between hitboxes and hurtboxes
-        checkFighterHitboxCollisions(&f->fighters[0], &f->fighters[1]);
-        checkFighterHitboxCollisions(&f->fighters[1], &f->fighters[0]);
-        // Check for collisions between projectiles and hurtboxes
-        checkFighterProjectileCollisions(&f->projectiles);
+    for(uint8_t i = 0; i < NUM_FIGHTERS; i++)
+    {
+        const fighter_t* ftr = &state->fighters[i];
+        hash = hashVector(hash, ftr->pos);
+        hash = hashVector(hash, ftr->hurtbox_offset);
+        hash = hashVector(hash, ftr->size);
+        hash = hashVector(hash, ftr->velocity);
+        hash = hashInt(hash, ftr->isInAir);
+        hash = hashInt(hash, ftr->ledgeJumped);
+        hash = hashInt(hash, ftr->isInvincible);
+        hash = hashInt(hash, ftr->iFrameTimer);
+        hash = hashInt(hash, ftr->relativePos);
+        hash = hashInt(hash, getPlatformIdx(stage, ftr->touchingPlatform));
+        hash = hashInt(hash, getPlatformIdx(stage, ftr->passingThroughPlatform));
+        hash = hashInt(hash, ftr->numJumpsLeft);
+        hash = hashInt(hash, ftr->prevBtnState);
+        hash = hashInt(hash, ftr->btnState);
+        hash = hashInt(hash, ftr->state);
+        hash = hashInt(hash, ftr->isAerialAttack);
+        hash = hashInt(hash, ftr->cAttack);
+        hash = hashInt(hash, ftr->attackFrame);
+        hash = hashInt(hash, ftr->attackConnected);
+        hash = hashInt(hash, ftr->attackFramesConnected);
+        hash = hashInt(hash, ftr->stateTimer);
+        hash = hashInt(hash, ftr->fallThroughTimer);
+        hash = hashInt(hash, ftr->dir);
+        hash = hashInt(hash, ftr->shortHopTimer);
+        hash = hashInt(hash, ftr->isShortHop);
+        hash = hashInt(hash, ftr->damage);
+        hash = hashInt(hash, ftr->stocks);
+        hash = hashInt(hash, ftr->animTimer);
+    }
 
-        // Render the scene
-        drawFighterFrame(f->d, battlefield, sizeof(battlefield) / sizeof(battlefield[0]));
+    const projectilePool_t* pool = &state->projectiles;
+    hash = hashInt(hash, pool->numProjectiles);
+    for(uint8_t pIdx = 0; pIdx < pool->numProjectiles; pIdx++)
+    {
+        hash = hashInt(hash, pool->owner[pIdx]);
+        hash = hashVector(hash, pool->size[pIdx]);
+        hash = hashVector(hash, pool->pos[pIdx]);
+        hash = hashVector(hash, pool->velo[pIdx]);
+        hash = hashVector(hash, pool->accel[pIdx]);
+        hash = hashVector(hash, pool->knockback[pIdx]);
+        hash = hashInt(hash, pool->duration[pIdx]);
+        hash = hashInt(hash, pool->damage[pIdx]);
+        hash = hashInt(hash, pool->hitstun[pIdx]);
+        hash = hashInt(hash, pool->removeNextFrame[pIdx]);
+        hash = hashInt(hash, pool->dir[pIdx]);
+    }
+    return hash;
+}
 
-        // ESP_LOGI("FTR", "{[%d, %d], [%d, %d], %d}",
-        //     f->fighters[0].hurtbox.x0 / SF,
-        //     f->fighters[0].hurtbox.y0 / SF,
-        //     f->fighters[0].velocity.x,
-        //     f->fighters[0].velocity.y,
-        //     f->fighters[0].relativePos);
+/**
+ * Draw the fighter game when a frame is due. The game is simulated in
+ * fighterMainLoop(), so this only renders the latest state
+ *
+ * @param elapsedUs unused
+ */
+void fighterFrameCb(int64_t elapsedUs __attribute__((unused)))
+{
+    profileBegin(&profFtrDraw);
+    if(f->isLoaded)
+    {
+        drawFighterFrame(f->d, &f->state, &f->stage);
     }
+    else
+    {
+        drawFighterLoadError(f->d, &f->mm_font);
+    }
+    profileEnd(&profFtrDraw);
 }
 
 /**
@@ -408,7 +752,7 @@ void fighterMainLoop(int64_t elapsedUs)
  * @param d   The display to draw to
  * @param ftr The fighter to draw
  */
-void drawFighter(display_t* d, fighter_t* ftr)
+void drawFighter(display_t* d, const fighter_t* ftr)
 {
 #if defined(DRAW_DEBUG_BOXES)
     // Pick the color based on state
@@ -473,7 +817,7 @@ void drawFighter(display_t* d, fighter_t* ftr)
     if(FS_ATTACK == ftr->state)
     {
         // Get a reference to the attack frame
-        attackFrame_t* atk = &ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame];
+        const attackFrame_t* atk = &ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame];
         // Shift the sprite
         spritePos.x += atk->sprite_offset.x;
         spritePos.y += atk->sprite_offset.y;
@@ -489,12 +833,12 @@ void drawFighter(display_t* d, fighter_t* ftr)
     if(FS_ATTACK == ftr->state)
     {
         // Get a reference to the attack frame
-        attackFrame_t* atk = &ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame];
+        const attackFrame_t* atk = &ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame];
 
         // For each hitbox in this frame
         for(uint8_t hbIdx = 0; hbIdx < atk->numHitboxes; hbIdx++)
         {
-            attackHitbox_t* hbx = &atk->hitboxes[hbIdx];
+            const attackHitbox_t* hbx = &getAttackHitboxes(atk)[hbIdx];
 
             // If this isn't a projectile attack, draw it
             if(!hbx->isProjectile)
@@ -528,9 +872,11 @@ void drawFighter(display_t* d, fighter_t* ftr)
  * Manage transitons between fighter attacks.
  * Create a projectile if the attack state transitioned to is one.
  *
- * @param ftr The fighter to to check timers for
+ * @param ftr    The fighter to to check timers for
+ * @param ftrIdx The fighter's index, which owns any projectiles it fires
+ * @param pool   The projectiles, where any new projectiles are spawned
  */
-void checkFighterTimer(fighter_t* ftr)
+void checkFighterTimer(fighter_t* ftr, uint8_t ftrIdx, projectilePool_t* pool)
 {
     // Tick down the iframe timer
     if(ftr->iFrameTimer > 0)
@@ -623,7 +969,7 @@ void checkFighterTimer(fighter_t* ftr)
     if(shouldTransition)
     {
         // Keep a pointer to the current attack frame
-        attackFrame_t* atk = NULL;
+        const attackFrame_t* atk = NULL;
         // Switch on where we're transitioning from
         switch(ftr->state)
         {
@@ -647,7 +993,7 @@ void checkFighterTimer(fighter_t* ftr)
                     // Transition from one attack frame to the next attack frame
                     atk = &ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame];
                     // Set the sprite
-                    setFighterState(ftr, FS_ATTACK, ftr->attacks[ftr->cAttack].attackFrames[ftr->attackFrame].sprite, atk->duration);
+                    setFighterState(ftr, FS_ATTACK, ftr->sprites[atk->sprite], atk->duration);
 
                     // Always copy the iframe value, may be 0
                     ftr->iFrameTimer = atk->iFrames;
@@ -716,44 +1062,45 @@ void checkFighterTimer(fighter_t* ftr)
             ftr->hurtbox_offset.x = atk->hurtbox_offset.x * SF;
             ftr->hurtbox_offset.y = atk->hurtbox_offset.y * SF;
 
-            // Check hitboxes for projectiles. Allocate and link any that are
+            // Check hitboxes for projectiles. Fire any that are
             for(uint8_t hbIdx = 0; hbIdx < atk->numHitboxes; hbIdx++)
             {
-                attackHitbox_t* hbx = &atk->hitboxes[hbIdx];
+                const attackHitbox_t* hbx = &getAttackHitboxes(atk)[hbIdx];
 
                 if(hbx->isProjectile)
                 {
-                    // Allocate the projectile
-                    projectile_t* proj = malloc(sizeof(projectile_t));
+                    // Take the next free slot, if there is one
+                    if(pool->numProjectiles >= MAX_PROJECTILES)
+                    {
+                        break;
+                    }
+                    uint8_t pIdx = pool->numProjectiles++;
 
                     // Copy data from the attack frame to the projectile
-                    proj->sprite = hbx->projSprite;
-                    proj->size   = hbx->hitboxSize;
-                    proj->velo   = hbx->projVelo;
-                    proj->accel  = hbx->projAccel;
+                    pool->sprite[pIdx] = ftr->sprites[hbx->projSprite];
+                    pool->size[pIdx]   = hbx->hitboxSize;
+                    pool->velo[pIdx]   = hbx->projVelo;
+                    pool->accel[pIdx]  = hbx->projAccel;
                     // Adjust position, velocity, and acceleration depending on direction
                     if(FACING_RIGHT == ftr->dir)
                     {
-                        proj->pos.x = ftr->pos.x + hbx->hitboxPos.x;
+                        pool->pos[pIdx].x = ftr->pos.x + hbx->hitboxPos.x;
                     }
                     else
                     {
                         // Reverse
-                        proj->pos.x = ftr->pos.x + ftr->size.x - hbx->hitboxPos.x - proj->size.x;
-                        proj->velo.x = -proj->velo.x;
-                        proj->accel.x = -proj->accel.x;
+                        pool->pos[pIdx].x = ftr->pos.x + ftr->size.x - hbx->hitboxPos.x - pool->size[pIdx].x;
+                        pool->velo[pIdx].x = -pool->velo[pIdx].x;
+                        pool->accel[pIdx].x = -pool->accel[pIdx].x;
                     }
-                    proj->dir             = ftr->dir;
-                    proj->pos.y           = ftr->pos.y + hbx->hitboxPos.y;
-                    proj->duration        = hbx->projDuration;
-                    proj->knockback       = hbx->knockback;
-                    proj->damage          = hbx->damage;
-                    proj->hitstun         = hbx->hitstun;
-                    proj->removeNextFrame = false;
-                    proj->owner           = ftr;
-
-                    // Add the projectile to the list
-                    push(&f->projectiles, proj);
+                    pool->dir[pIdx]             = ftr->dir;
+                    pool->pos[pIdx].y           = ftr->pos.y + hbx->hitboxPos.y;
+                    pool->duration[pIdx]        = hbx->projDuration;
+                    pool->knockback[pIdx]       = hbx->knockback;
+                    pool->damage[pIdx]          = hbx->damage;
+                    pool->hitstun[pIdx]         = hbx->hitstun;
+                    pool->removeNextFrame[pIdx] = false;
+                    pool->owner[pIdx]           = ftrIdx;
                 }
             }
         }
@@ -1007,13 +1354,14 @@ void checkFighterButtonInput(fighter_t* ftr)
  *  - If a collision is found, do a binary search on a line between where the
  *    fighter is and where they're trying to move and move as far as it can
  *
- * @param f            The fighter to move
- * @param platforms    A pointer to platforms to check for collisions
- * @param numPlatforms The number of platforms
+ * @param ftr   The fighter to move
+ * @param stage The stage, whose platforms are checked for collisions
  */
-void updateFighterPosition(fighter_t* ftr, const platform_t* platforms,
-                           uint8_t numPlatforms)
+void updateFighterPosition(fighter_t* ftr, const fighterStage_t* stage)
 {
+    const platform_t* platforms = stage->platforms;
+    const collisionGrid_t* platformGrid = &stage->platformGrid;
+
     // Initial velocity before this frame's calculations
     vector_t v0 = ftr->velocity;
 
@@ -1218,7 +1566,9 @@ void updateFighterPosition(fighter_t* ftr, const platform_t* platforms,
     // Do a quick check to see if the binary search can be avoided altogether
     bool collisionDetected = false;
     bool intersectionDetected = false;
-    for (uint8_t idx = 0; idx < numPlatforms; idx++)
+    uint32_t candidates = queryCollisionGrid(platformGrid, dest_hurtbox);
+    uint8_t idx;
+    while (popCollisionGridId(&candidates, &idx))
     {
         if(boxesCollide(dest_hurtbox, platforms[idx].area))
         {
@@ -1271,13 +1621,25 @@ void updateFighterPosition(fighter_t* ftr, const platform_t* platforms,
         test_hurtbox.x1 = test_hurtbox.x0 + ftr->size.x;
         test_hurtbox.y1 = test_hurtbox.y0 + ftr->size.y;
 
+        // Every test point is between src and dest, so only platforms near
+        // the box covering both can be hit
+        box_t sweep =
+        {
+            .x0 = (src_hurtbox.x0 < dest_hurtbox.x0) ? src_hurtbox.x0 : dest_hurtbox.x0,
+            .y0 = (src_hurtbox.y0 < dest_hurtbox.y0) ? src_hurtbox.y0 : dest_hurtbox.y0,
+            .x1 = (src_hurtbox.x1 > dest_hurtbox.x1) ? src_hurtbox.x1 : dest_hurtbox.x1,
+            .y1 = (src_hurtbox.y1 > dest_hurtbox.y1) ? src_hurtbox.y1 : dest_hurtbox.y1,
+        };
+        uint32_t sweepCandidates = queryCollisionGrid(platformGrid, sweep);
+
         // Binary search between where the fighter is and where the fighter
         // wants to be until it converges
         while(true)
         {
             // Check if there are any collisions at this position
             collisionDetected = false;
-            for (uint8_t idx = 0; idx < numPlatforms; idx++)
+            candidates = sweepCandidates;
+            while (popCollisionGridId(&candidates, &idx))
             {
                 if(ftr->passingThroughPlatform != &platforms[idx] &&
                         boxesCollide(test_hurtbox, platforms[idx].area))
@@ -1344,8 +1706,17 @@ void updateFighterPosition(fighter_t* ftr, const platform_t* platforms,
     box_t hbox;
     getHurtbox(ftr, &hbox);
 
-    // Loop through all platforms to check for touching
-    for (uint8_t idx = 0; idx < numPlatforms; idx++)
+    // Loop through all platforms near enough to be touching. Touching is
+    // checked to the pixel, so look a little past the hurtbox
+    box_t touchArea =
+    {
+        .x0 = hbox.x0 - (2 * SF),
+        .y0 = hbox.y0 - (2 * SF),
+        .x1 = hbox.x1 + (2 * SF),
+        .y1 = hbox.y1 + (2 * SF),
+    };
+    candidates = queryCollisionGrid(platformGrid, touchArea);
+    while (popCollisionGridId(&candidates, &idx))
     {
         // Don't check the platform being passed throughd
         if(ftr->passingThroughPlatform == &platforms[idx])
@@ -1492,7 +1863,7 @@ void updateFighterPosition(fighter_t* ftr, const platform_t* platforms,
         setFighterRelPos(ftr, NOT_TOUCHING_PLATFORM, NULL, NULL, true);
         ftr->cAttack = NO_ATTACK;
         setFighterState(ftr, FS_IDLE, ftr->idleSprite0, 0);
-        ftr->pos.x = (f->d->w / 2) * SF;
+        ftr->pos.x = (stage->bounds.x0 + stage->bounds.x1) / 2;
         ftr->pos.y = 0;
         ftr->velocity.x = 0;
         ftr->velocity.y = 0;
@@ -1519,16 +1890,16 @@ void checkFighterHitboxCollisions(fighter_t* ftr, fighter_t* otherFtr)
     {
         // Get a reference to the attack and frames
         attack_t* atk = &ftr->attacks[ftr->cAttack];
-        attackFrame_t* afrm = &atk->attackFrames[ftr->attackFrame];
+        const attackFrame_t* afrm = &atk->attackFrames[ftr->attackFrame];
 
         // Check for collisions if this frame hasn't connected yet
         // Also make sure that the attack allows multi-frame hits
-        if ((false == (atk->onlyFirstHit && atk->attackConnected)) &&
-                (false == afrm->attackConnected))
+        if ((false == (atk->onlyFirstHit && ftr->attackConnected)) &&
+                (0 == (ftr->attackFramesConnected & (1u << ftr->attackFrame))))
         {
             for(uint8_t hbIdx = 0; hbIdx < afrm->numHitboxes; hbIdx++)
             {
-                attackHitbox_t* hbx = &afrm->hitboxes[hbIdx];
+                const attackHitbox_t* hbx = &getAttackHitboxes(afrm)[hbIdx];
 
                 // If this isn't a projectile attack, check the hitbox
                 if(!hbx->isProjectile)
@@ -1554,8 +1925,8 @@ void checkFighterHitboxCollisions(fighter_t* ftr, fighter_t* otherFtr)
                     if(boxesCollide(relativeHitbox, otherFtrHurtbox))
                     {
                         // Note the attack connected so it doesnt collide twice
-                        atk->attackConnected = true;
-                        afrm->attackConnected = true;
+                        ftr->attackConnected = true;
+                        ftr->attackFramesConnected |= (1u << ftr->attackFrame);
 
                         // Tally the damage
                         otherFtr->damage += hbx->damage;
@@ -1598,35 +1969,38 @@ void checkFighterHitboxCollisions(fighter_t* ftr, fighter_t* otherFtr)
  *
  * Note, once a projectile is fired, it has no owner and can hit either fighter.
  *
- * @param projectiles A list of projectiles to check
+ * @param state       The game state, with the fighters and projectiles to check
+ * @param fighterGrid The fighters' broad phase grid
  */
-void checkFighterProjectileCollisions(list_t* projectiles)
+void checkFighterProjectileCollisions(fighterGameState_t* state, collisionGrid_t* fighterGrid)
 {
+    projectilePool_t* pool = &state->projectiles;
+
     // Check projectile collisions. Iterate through all projectiles
-    node_t* currentNode = projectiles->first;
-    while (currentNode != NULL)
+    uint8_t pIdx = 0;
+    while (pIdx < pool->numProjectiles)
     {
-        projectile_t* proj = currentNode->val;
-
         // Create a hurtbox for this projectile to check for collisions with hurtboxes
         box_t projHurtbox =
         {
-            .x0 = proj->pos.x,
-            .y0 = proj->pos.y,
-            .x1 = proj->pos.x + proj->size.x,
-            .y1 = proj->pos.y + proj->size.y,
+            .x0 = pool->pos[pIdx].x,
+            .y0 = pool->pos[pIdx].y,
+            .x1 = pool->pos[pIdx].x + pool->size[pIdx].x,
+            .y1 = pool->pos[pIdx].y + pool->size[pIdx].y,
         };
 
-        bool removeProjectile = false;
+        bool shouldRemove = false;
 
-        // For each fighter
-        for(uint8_t i = 0; i < f->numFighters; i++)
+        // For each fighter near the projectile
+        uint32_t candidates = queryCollisionGrid(fighterGrid, projHurtbox);
+        uint8_t i;
+        while (popCollisionGridId(&candidates, &i))
         {
             // Get a convenience pointer
-            fighter_t* ftr = &f->fighters[i];
+            fighter_t* ftr = &state->fighters[i];
 
             // Make sure a projectile can't hurt its owner
-            if(ftr != proj->owner)
+            if(i != pool->owner[pIdx])
             {
                 box_t ftrHurtbox;
                 getHurtbox(ftr, &ftrHurtbox);
@@ -1634,23 +2008,23 @@ void checkFighterProjectileCollisions(list_t* projectiles)
                 if(boxesCollide(projHurtbox, ftrHurtbox))
                 {
                     // Tally the damage
-                    ftr->damage += proj->damage;
+                    ftr->damage += pool->damage[pIdx];
 
                     // Apply the knockback, scaled by damage
                     // roughly (1 + (0.02 * dmg))
                     int32_t knockbackScalar = 64 + (ftr->damage);
-                    if(FACING_RIGHT == proj->dir)
+                    if(FACING_RIGHT == pool->dir[pIdx])
                     {
-                        ftr->velocity.x += ((proj->knockback.x * knockbackScalar) / 64);
+                        ftr->velocity.x += ((pool->knockback[pIdx].x * knockbackScalar) / 64);
                     }
                     else
                     {
-                        ftr->velocity.x -= ((proj->knockback.x * knockbackScalar) / 64);
+                        ftr->velocity.x -= ((pool->knockback[pIdx].x * knockbackScalar) / 64);
                     }
-                    ftr->velocity.y += ((proj->knockback.y * knockbackScalar) / 64);
+                    ftr->velocity.y += ((pool->knockback[pIdx].y * knockbackScalar) / 64);
 
                     // Apply hitstun, scaled by defendant's percentage
-                    setFighterState(ftr, FS_HITSTUN, ftr->currentSprite, proj->hitstun * (1 + (ftr->damage / 32)));
+                    setFighterState(ftr, FS_HITSTUN, ftr->currentSprite, pool->hitstun[pIdx] * (1 + (ftr->damage / 32)));
 
                     // Knock the fighter into the air
                     if(!ftr->isInAir)
@@ -1658,151 +2032,215 @@ void checkFighterProjectileCollisions(list_t* projectiles)
                         setFighterRelPos(ftr, NOT_TOUCHING_PLATFORM, NULL, NULL, true);
                     }
 
+                    // Getting hit can change the hurtbox, e.g. when ducking,
+                    // so keep the grid in step for the next projectile
+                    getHurtbox(ftr, &ftrHurtbox);
+                    addToCollisionGrid(fighterGrid, ftrHurtbox, i);
+
                     // Mark this projectile for removal
-                    removeProjectile = true;
+                    shouldRemove = true;
                 }
             }
         }
 
         // If the projectile collided with a fighter, remove it
-        if(removeProjectile)
+        if(shouldRemove)
         {
-            // Iterate while removing this projectile
-            node_t* nextNode = currentNode->next;
-            removeEntry(projectiles, currentNode);
-            currentNode = nextNode;
+            // The last projectile is moved into this slot, so check this slot again
+            removeProjectile(pool, pIdx);
         }
         else
         {
             // Iterate to the next projectile
-            currentNode = currentNode->next;
+            pIdx++;
         }
     }
 }
 
 /**
  * Iterate through all projectiles, checking their timers and collisions.
- * If a projectile collides with a platform or times out, unlink and free it
+ * If a projectile collides with a platform or times out, remove it
  *
- * @param projectiles  A linked list of projectiles to process
- * @param platforms    A pointer to platforms to check for collisions
- * @param numPlatforms The number of platforms
+ * @param pool  The projectiles to process
+ * @param stage The stage, whose platforms are checked for collisions
  */
-void checkProjectileTimer(list_t* projectiles, const platform_t* platforms,
-                          uint8_t numPlatforms)
+void checkProjectileTimer(projectilePool_t* pool, const fighterStage_t* stage)
 {
+    const platform_t* platforms = stage->platforms;
+    const collisionGrid_t* platformGrid = &stage->platformGrid;
+
     // Iterate through all projectiles
-    node_t* currentNode = projectiles->first;
-    while (currentNode != NULL)
+    uint8_t pIdx = 0;
+    while (pIdx < pool->numProjectiles)
     {
-        projectile_t* proj = currentNode->val;
-
         // Decrement this projectile's time-to-live
-        proj->duration--;
+        pool->duration[pIdx]--;
 
         // If the projectile times out or is marked for removal
-        if((0 == proj->duration) || (true == proj->removeNextFrame))
+        if((0 == pool->duration[pIdx]) || (true == pool->removeNextFrame[pIdx]))
         {
-            // Free and remove the projectile, and iterate
-            free(proj);
-            node_t* toRemove = currentNode;
-            currentNode = currentNode->next;
-            removeEntry(projectiles, toRemove);
+            // Remove the projectile. The last projectile is moved into this
+            // slot, so check this slot again
+            removeProjectile(pool, pIdx);
         }
         else
         {
             // Otherwise, update projectile kinematics. Acceleration is constant
-            vector_t v0 = proj->velo;
+            vector_t* velo = &pool->velo[pIdx];
+            vector_t* accel = &pool->accel[pIdx];
+            vector_t* pos = &pool->pos[pIdx];
+            vector_t v0 = *velo;
 
             // Update velocity
-            proj->velo.x = proj->velo.x + (proj->accel.x * FRAME_TIME_MS) / SF;
-            proj->velo.y = proj->velo.y + (proj->accel.y * FRAME_TIME_MS) / SF;
+            velo->x = velo->x + (accel->x * FRAME_TIME_MS) / SF;
+            velo->y = velo->y + (accel->y * FRAME_TIME_MS) / SF;
 
             // Update the position
-            proj->pos.x = proj->pos.x + (((proj->velo.x + v0.x) * FRAME_TIME_MS) / (SF * 2));
-            proj->pos.y = proj->pos.y + (((proj->velo.y + v0.y) * FRAME_TIME_MS) / (SF * 2));
+            pos->x = pos->x + (((velo->x + v0.x) * FRAME_TIME_MS) / (SF * 2));
+            pos->y = pos->y + (((velo->y + v0.y) * FRAME_TIME_MS) / (SF * 2));
 
             // Create a hurtbox for this projectile to check for collisions with platforms
             box_t projHurtbox =
             {
-                .x0 = proj->pos.x,
-                .y0 = proj->pos.y,
-                .x1 = proj->pos.x + proj->size.x,
-                .y1 = proj->pos.y + proj->size.y,
+                .x0 = pos->x,
+                .y0 = pos->y,
+                .x1 = pos->x + pool->size[pIdx].x,
+                .y1 = pos->y + pool->size[pIdx].y,
             };
 
             // Check if this projectile collided with a platform
-            for (uint8_t idx = 0; idx < numPlatforms; idx++)
+            uint32_t candidates = queryCollisionGrid(platformGrid, projHurtbox);
+            uint8_t idx;
+            while (popCollisionGridId(&candidates, &idx))
             {
                 if(boxesCollide(projHurtbox, platforms[idx].area))
                 {
                     // Draw one more frame, then remove the projectile
-                    proj->removeNextFrame = true;
+                    pool->removeNextFrame[pIdx] = true;
                     break;
                 }
             }
 
             // Iterate to the next projectile
-            currentNode = currentNode->next;
+            pIdx++;
         }
     }
 }
 
+/**
+ * Rebuild the broad phase grid of fighters' hurtboxes. Fighters move every
+ * frame, so this is done after they move and before checking projectiles
+ *
+ * @param grid        The grid to rebuild
+ * @param fighters    The fighters to add to the grid
+ * @param numFighters The number of fighters
+ */
+void buildFighterGrid(collisionGrid_t* grid, fighter_t* fighters, uint8_t numFighters)
+{
+    clearCollisionGrid(grid);
+    for(uint8_t i = 0; (i < numFighters) && (i < GRID_MAX_IDS); i++)
+    {
+        box_t hurtbox;
+        getHurtbox(&fighters[i], &hurtbox);
+        addToCollisionGrid(grid, hurtbox, i);
+    }
+}
+
+/**
+ * Remove a projectile by moving the last projectile into its slot. This keeps
+ * the live projectiles packed, but changes their order
+ *
+ * @param pool The projectiles
+ * @param idx The index of the projectile to remove
+ */
+void removeProjectile(projectilePool_t* pool, uint8_t idx)
+{
+    uint8_t last = --pool->numProjectiles;
+    if(idx != last)
+    {
+        pool->owner[idx]           = pool->owner[last];
+        pool->sprite[idx]          = pool->sprite[last];
+        pool->size[idx]            = pool->size[last];
+        pool->pos[idx]             = pool->pos[last];
+        pool->velo[idx]            = pool->velo[last];
+        pool->accel[idx]           = pool->accel[last];
+        pool->knockback[idx]       = pool->knockback[last];
+        pool->duration[idx]        = pool->duration[last];
+        pool->damage[idx]          = pool->damage[last];
+        pool->hitstun[idx]         = pool->hitstun[last];
+        pool->removeNextFrame[idx] = pool->removeNextFrame[last];
+        pool->dir[idx]             = pool->dir[last];
+    }
+}
+
 /**
  * Render the current frame to the display, including fighters, platforms, and
  * projectiles, and HUD
  *
- * @param d The display to draw to
- * @param platforms    A pointer to platforms to draw
- * @param numPlatforms The number of platforms
+ * @param d     The display to draw to
+ * @param state The game state to draw
+ * @param stage The stage, whose platforms are drawn
  */
-void drawFighterFrame(display_t* d, const platform_t* platforms,
-                      uint8_t numPlatforms)
+void drawFighterFrame(display_t* d, const fighterGameState_t* state,
+                      const fighterStage_t* stage)
 {
+    const platform_t* platforms = stage->platforms;
+
     // First clear everything
     d->clearPx();
 
     // Draw all the platforms
-    for (uint8_t idx = 0; idx < numPlatforms; idx++)
+    for (uint8_t idx = 0; idx < stage->numPlatforms; idx++)
     {
         drawBox(d, platforms[idx].area, c555, !platforms[idx].canFallThrough, SF);
     }
 
     // Draw the fighters
-    drawFighter(d, &f->fighters[0]);
-    drawFighter(d, &f->fighters[1]);
+    drawFighter(d, &state->fighters[0]);
+    drawFighter(d, &state->fighters[1]);
 
     // Iterate through all the projectiles
-    node_t* currentNode = f->projectiles.first;
-    while (currentNode != NULL)
+    const projectilePool_t* pool = &state->projectiles;
+    for(uint8_t pIdx = 0; pIdx < pool->numProjectiles; pIdx++)
     {
-        projectile_t* proj = currentNode->val;
-
         // Draw the sprite
-        drawWsg(d, proj->sprite, proj->pos.x / SF, proj->pos.y / SF,
-                FACING_LEFT == proj->dir, false, 0);
+        drawWsg(d, pool->sprite[pIdx], pool->pos[pIdx].x / SF, pool->pos[pIdx].y / SF,
+                FACING_LEFT == pool->dir[pIdx], false, 0);
 
 #if defined(DRAW_DEBUG_BOXES)
         // Draw the projectile box
         box_t projBox =
         {
-            .x0 = proj->pos.x,
-            .y0 = proj->pos.y,
-            .x1 = proj->pos.x + proj->size.x,
-            .y1 = proj->pos.y + proj->size.y,
+            .x0 = pool->pos[pIdx].x,
+            .y0 = pool->pos[pIdx].y,
+            .x1 = pool->pos[pIdx].x + pool->size[pIdx].x,
+            .y1 = pool->pos[pIdx].y + pool->size[pIdx].y,
         };
         drawBox(d, projBox, c050, false, SF);
 #endif
-
-        // Iterate
-        currentNode = currentNode->next;
     }
 
-    drawFighterHud(d, &f->mm_font, &f->fighters[0], &f->fighters[1]);
+    drawFighterHud(d, &f->mm_font, &state->fighters[0], &state->fighters[1], f->hudDamage);
 
     // drawMeleeMenu(d, &f->mm_font);
 }
 
+/**
+ * Draw an error instead of the game when there weren't fighters to play with
+ *
+ * @param d The display to draw to
+ * @param font The font to draw the error with, which may not have loaded either
+ */
+void drawFighterLoadError(display_t* d, font_t* font)
+{
+    d->clearPx();
+    if(NULL != font->bitmaps)
+    {
+        static const char loadErrorStr[] = "Couldn't load fighters";
+        drawText(d, font, c500, loadErrorStr, (d->w - textWidth(font, loadErrorStr)) / 2, (d->h - font->h) / 2);
+    }
+}
+
 /**
  * Draw the HUD, which is just the damage percentages and stock circles
  *
@@ -1810,13 +2248,11 @@ void drawFighterFrame(display_t* d, const platform_t* platforms,
  * @param font The font to use for the damage percentages
  * @param ftr1 The first fighter to draw damage percent for
  * @param ftr2 The second fighter to draw damage percent for
+ * @param hudDamage The laid out damage text for both fighters
  */
-void drawFighterHud(display_t* d, font_t* font, fighter_t* ftr1, fighter_t* ftr2)
+void drawFighterHud(display_t* d, font_t* font, const fighter_t* ftr1, const fighter_t* ftr2,
+                    hudDamage_t* hudDamage)
 {
-    char dmgStr[8];
-    uint16_t tWidth;
-    uint16_t xPos;
-
 #define SR 5
     int16_t stockX = (d->w / 3) - (2 * SR) - 3;
     for(uint8_t stockToDraw = 0; stockToDraw < ftr1->stocks; stockToDraw++)
@@ -1825,10 +2261,7 @@ void drawFighterHud(display_t* d, font_t* font, fighter_t* ftr1, fighter_t* ftr2
         stockX += ((2 * SR) + 3);
     }
 
-    snprintf(dmgStr, sizeof(dmgStr) - 1, "%d%%", ftr1->damage);
-    tWidth = textWidth(font, dmgStr);
-    xPos = (d->w / 3) - (tWidth / 2);
-    drawText(d, font, c555, dmgStr, xPos, d->h - font->h - 2);
+    drawHudDamage(d, font, &hudDamage[0], ftr1->damage, d->w / 3);
 
     stockX = (2 * (d->w / 3)) - (2 * SR) - 3;
     for(uint8_t stockToDraw = 0; stockToDraw < ftr2->stocks; stockToDraw++)
@@ -1837,10 +2270,33 @@ void drawFighterHud(display_t* d, font_t* font, fighter_t* ftr1, fighter_t* ftr2
         stockX += ((2 * SR) + 3);
     }
 
-    snprintf(dmgStr, sizeof(dmgStr) - 1, "%d%%", ftr2->damage);
-    tWidth = textWidth(font, dmgStr);
-    xPos = (2 * (d->w / 3)) - (tWidth / 2);
-    drawText(d, font, c555, dmgStr, xPos, d->h - font->h - 2);
+    drawHudDamage(d, font, &hudDamage[1], ftr2->damage, 2 * (d->w / 3));
+}
+
+/**
+ * Draw a fighter's damage percentage, centered. The text is only laid out
+ * again when the damage changes, which isn't every frame
+ *
+ * @param d The display to draw to
+ * @param font The font to use for the damage percentage
+ * @param hudDamage The laid out text for this fighter's damage
+ * @param damage The fighter's current damage
+ * @param xCenter The X coordinate to center the text on
+ */
+void drawHudDamage(display_t* d, font_t* font, hudDamage_t* hudDamage, int32_t damage,
+                   int16_t xCenter)
+{
+    if(damage != hudDamage->damage)
+    {
+        char dmgStr[8];
+        snprintf(dmgStr, sizeof(dmgStr) - 1, "%d%%", damage);
+        freePreparedText(&hudDamage->text);
+        prepareText(&hudDamage->text, font, dmgStr, true);
+        hudDamage->damage = damage;
+    }
+
+    drawPreparedText(d, &hudDamage->text, c555, xCenter - (hudDamage->text.w / 2),
+                     d->h - font->h - 2);
 }
 
 /**
@@ -1851,5 +2307,57 @@ void drawFighterHud(display_t* d, font_t* font, fighter_t* ftr1, fighter_t* ftr2
 void fighterButtonCb(buttonEvt_t* evt)
 {
     // Save the state to check synchronously
-    f->fighters[0].btnState = evt->state;
+    f->btnState = evt->state;
+}
+
+/**
+ * Handle a received ESP-NOW packet. During a versus match, input packets from
+ * the other Swadge go to rollback. Everything else goes to p2p
+ *
+ * @param mac_addr The MAC address which sent this data
+ * @param data     A pointer to the data received
+ * @param len      The length of the data received
+ * @param rssi     The RSSI for this packet
+ */
+void fighterEspNowRecvCb(const uint8_t* mac_addr, const char* data, uint8_t len, int8_t rssi)
+{
+    if(isFighterInputPacket((const uint8_t*)data, len))
+    {
+        if(f->isVersus && (0 == memcmp(mac_addr, f->p2p.cnc.otherMac, sizeof(f->p2p.cnc.otherMac))))
+        {
+            receiveFighterInputPacket(f->rb, (const uint8_t*)data, len);
+        }
+    }
+    else
+    {
+        p2pRecvCb(&f->p2p, mac_addr, data, len, rssi);
+    }
+}
+
+/**
+ * Pass ESP-NOW transmission status to p2p
+ *
+ * @param mac_addr The MAC address the data was sent to
+ * @param status   Whether the transmission succeeded or failed
+ */
+void fighterEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t status)
+{
+    p2pSendCb(&f->p2p, mac_addr, status);
+}
+
+/**
+ * Start a versus match when another Swadge connects. The Swadge going first
+ * plays the first fighter
+ *
+ * @param p2p The p2p connection
+ * @param evt The connection event
+ */
+void fighterConCbFn(p2pInfo* p2p, connectionEvt_t evt)
+{
+    if(CON_ESTABLISHED == evt)
+    {
+        uint8_t localIdx = (GOING_FIRST == p2pGetPlayOrder(p2p)) ? 0 : 1;
+        ESP_LOGI("FTR", "Connected, playing fighter %d", localIdx);
+        startFighterMatch(true, localIdx);
+    }
 }
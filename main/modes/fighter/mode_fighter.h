@@ -15,6 +15,10 @@
 // Division by a power of 2 has slightly more instructions than rshift, but handles negative numbers properly!
 #define SF (1 << 8) // Scaling factor, a nice power of 2
 
+#define MAX_PROJECTILES 16 // Projectiles in flight at once. More are not fired
+#define MAX_ATTACK_FRAMES 32 // Frames per attack, one bit each in attackFramesConnected
+#define NUM_FIGHTERS 2
+
 typedef enum
 {
     ABOVE_PLATFORM,
@@ -62,47 +66,50 @@ typedef enum
 // Structs
 //==============================================================================
 
+/*
+ * Hitboxes and attack frames are used in place in the compiled fighter data,
+ * so they hold no pointers and their layouts are part of the file format. See
+ * fighter_json.h before changing them. They aren't written to while fighting,
+ * so everything that changes is in fighter_t
+ */
 typedef struct
 {
     vector_t hitboxPos;
     vector_t hitboxSize;
-    uint16_t damage;
     vector_t knockback;
-    uint16_t hitstun;
-
-    bool isProjectile;
-    wsg_t* projSprite;
-    uint16_t projDuration;
     vector_t projVelo;
     vector_t projAccel;
+    uint16_t damage;
+    uint16_t hitstun;
+    uint16_t projDuration;
+    uint16_t projSprite; ///< An index into the fighter's sprites
+    bool isProjectile;
 } attackHitbox_t;
 
 typedef struct
 {
-    wsg_t* sprite;
-    attackHitbox_t* hitboxes;
+    uint32_t hitboxesOffset; ///< From this frame to its hitboxes, see getAttackHitboxes()
     vector_t sprite_offset;
     vector_t hurtbox_offset;
     vector_t hurtbox_size;
     vector_t velocity;
     uint16_t duration;
     uint16_t iFrames;
+    uint16_t sprite; ///< An index into the fighter's sprites
     uint8_t numHitboxes;
-    bool attackConnected;
 } attackFrame_t;
 
 typedef struct
 {
     wsg_t* startupLagSpr;
     wsg_t* endLagSpr;
-    attackFrame_t* attackFrames;
+    const attackFrame_t* attackFrames; ///< In the fighter data, see loadFighterData()
     uint16_t startupLag;
     uint16_t endLag;
     uint16_t landingLag;
     uint16_t iFrames;
     uint8_t numAttackFrames;
     bool onlyFirstHit;
-    bool attackConnected;
 } attack_t;
 
 typedef struct
@@ -150,6 +157,8 @@ typedef struct
     wsg_t* jumpSprite;
     wsg_t* duckSprite;
     wsg_t* landingLagSprite;
+    /* Every sprite in the fighter data, indexed by attack frames and hitboxes */
+    wsg_t** sprites;
     /* Input Tracking */
     int32_t prevBtnState;
     int32_t btnState;
@@ -158,6 +167,8 @@ typedef struct
     bool isAerialAttack;
     attackOrder_t cAttack;
     uint8_t attackFrame;
+    bool attackConnected;           ///< If the current attack has hit
+    uint32_t attackFramesConnected; ///< Which of the current attack's frames have hit, one bit each
     int32_t stateTimer;
     int32_t fallThroughTimer;
     fighterDirection_t dir;
@@ -170,24 +181,63 @@ typedef struct
     wsg_t* currentSprite;
 } fighter_t;
 
+/*
+ * All projectiles in flight, as a struct of arrays. Live projectiles are packed
+ * into [0, numProjectiles), so the free slots are the rest of the arrays. A
+ * projectile is removed by moving the last one into its slot
+ */
 typedef struct
 {
-    fighter_t* owner;
-    wsg_t* sprite;
+    uint8_t numProjectiles;
 
-    vector_t size;
-    vector_t pos;
-    vector_t velo;
-    vector_t accel;
+    uint8_t owner[MAX_PROJECTILES]; ///< The index of the fighter who fired it
+    wsg_t* sprite[MAX_PROJECTILES];
 
-    vector_t knockback;
-    uint16_t duration;
-    uint16_t damage;
-    uint16_t hitstun;
+    vector_t size[MAX_PROJECTILES];
+    vector_t pos[MAX_PROJECTILES];
+    vector_t velo[MAX_PROJECTILES];
+    vector_t accel[MAX_PROJECTILES];
 
-    bool removeNextFrame;
-    fighterDirection_t dir;
-} projectile_t;
+    vector_t knockback[MAX_PROJECTILES];
+    uint16_t duration[MAX_PROJECTILES];
+    uint16_t damage[MAX_PROJECTILES];
+    uint16_t hitstun[MAX_PROJECTILES];
+
+    bool removeNextFrame[MAX_PROJECTILES];
+    fighterDirection_t dir[MAX_PROJECTILES];
+} projectilePool_t;
+
+/*
+ * What a match is played on. It doesn't change during a match, so it isn't part
+ * of fighterGameState_t
+ */
+typedef struct
+{
+    const platform_t* platforms;
+    uint8_t numPlatforms;
+    box_t bounds;                 ///< Fighters spawn at the center of this
+    collisionGrid_t platformGrid; ///< Platforms, by index. Built once
+    collisionGrid_t fighterGrid;  ///< Fighters' hurtboxes. Scratch space, rebuilt every frame
+} fighterStage_t;
+
+/*
+ * Everything which changes during a match. stepFighterGame() advances it one
+ * frame using only this and the inputs, so matches can be replayed exactly. It
+ * can be copied to save and restore it. Its pointers only point at the fighter
+ * data and the stage, which don't change
+ */
+typedef struct
+{
+    uint32_t frame;
+    fighter_t fighters[NUM_FIGHTERS];
+    projectilePool_t projectiles;
+} fighterGameState_t;
+
+/* The inputs for one frame of a match */
+typedef struct
+{
+    uint16_t btnState[NUM_FIGHTERS];
+} fighterInputs_t;
 
 //==============================================================================
 // Extern variables
@@ -195,4 +245,15 @@ typedef struct
 
 extern swadgeMode modeFighter;
 
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+void initBattlefieldStage(fighterStage_t* stage);
+bool initFighterGame(fighterGameState_t* state, const fighterStage_t* stage,
+                     const fighter_t* fighters, uint8_t numFighters);
+void stepFighterGame(fighterGameState_t* state, fighterStage_t* stage,
+                     const fighterInputs_t* inputs);
+uint32_t hashFighterGame(const fighterGameState_t* state, const fighterStage_t* stage);
+
 #endif
\ No newline at end of file
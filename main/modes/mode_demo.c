@@ -24,13 +24,21 @@
 #include "embeddednf.h"
 #include "embeddedout.h"
 
+//==============================================================================
+// Defines
+//==============================================================================
+
+// The p2p message type for the payload echoed back and forth
+#define DEMO_MSG_ECHO 0
+
 //==============================================================================
 // Functions Prototypes
 //==============================================================================
 
-void demoEnterMode(display_t * disp);
+void demoEnterMode(display_t * disp, arena_t * arena);
 void demoExitMode(void);
 void demoMainLoop(int64_t elapsedUs);
+void demoFrameCb(int64_t elapsedUs);
 void demoAccelerometerCb(accel_t* accel);
 void demoAudioCb(uint16_t * samples, uint32_t sampleCnt);
 void demoTemperatureCb(float tmp_c);
@@ -40,7 +48,7 @@ void demoEspNowRecvCb(const uint8_t* mac_addr, const char* data, uint8_t len, in
 void demoEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t status);
 
 void demoConCbFn(p2pInfo* p2p, connectionEvt_t evt);
-void demoMsgRxCbFn(p2pInfo* p2p, const char* msg, const char* payload, uint8_t len);
+void demoMsgRxCbFn(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload, uint8_t len);
 void demoMsgTxCbFn(p2pInfo* p2p, messageStatus_t status);
 
 //==============================================================================
@@ -96,6 +104,8 @@ typedef struct
     uint16_t maxValue;
     uint64_t packetTimer;
     uint16_t packetsRx;
+    int megaIdx;
+    int megaPos;
 } demo_t;
 
 demo_t * demo;
@@ -113,7 +123,9 @@ swadgeMode modeDemo =
     .fnEspNowSendCb = demoEspNowSendCb,
     .fnAccelerometerCallback = demoAccelerometerCb,
     .fnAudioCallback = demoAudioCb,
-    .fnTemperatureCallback = demoTemperatureCb
+    .fnTemperatureCallback = demoTemperatureCb,
+    .fnFrameCallback = demoFrameCb,
+    .frameRate = 0
 };
 
 //==============================================================================
@@ -124,11 +136,10 @@ swadgeMode modeDemo =
  * @brief TODO
  *
  */
-void demoEnterMode(display_t * disp)
+void demoEnterMode(display_t * disp, arena_t * arena)
 {
     // Allocate memory for this mode
-    demo = (demo_t *)malloc(sizeof(demo_t));
-    memset(demo, 0, sizeof(demo_t));
+    demo = (demo_t *)arenaAlloc(arena, sizeof(demo_t));
 
     // Save a pointer to the display
     demo->disp = disp;
@@ -189,8 +200,6 @@ void demoExitMode(void)
     freeFont(&demo->radiostars);
 
     p2pDeinit(&demo->p);
-
-    free(demo);
 }
 
 /**
@@ -218,22 +227,67 @@ void demoMainLoop(int64_t elapsedUs)
     }
 
     // Move megaman sometimes
-    static int megaIdx = 0;
-    static int megaPos = 0;
     static uint64_t megaTime = 0;
     megaTime += elapsedUs;
     if(megaTime >= 150000)
     {
         megaTime -= 150000;
         
-        megaPos += 4;
-        if(megaPos >= demo->disp->w)
+        demo->megaPos += 4;
+        if(demo->megaPos >= demo->disp->w)
+        {
+            demo->megaPos = -demo->megaman[0].w;
+        }
+        demo->megaIdx = (demo->megaIdx + 1) % 9;
+    }
+
+    // Twice a second push out some USB data
+    static uint64_t usbTime = 0;
+    usbTime += elapsedUs;
+    if(usbTime >= 500000)
+    {
+        usbTime -= 500000;
+
+        // Only send data if USB is ready
+        if(tud_ready())
         {
-            megaPos = -demo->megaman[0].w;
+            // Static variables to track button and hat position
+            static hid_gamepad_button_bm_t btnPressed = GAMEPAD_BUTTON_A;
+            static hid_gamepad_hat_t hatDir = GAMEPAD_HAT_CENTERED;
+
+            // Build and send the state over USB
+            hid_gamepad_report_t report =
+            {
+                .buttons = btnPressed,
+                .hat = hatDir
+            };
+            tud_gamepad_report(&report);
+
+            // Move to the next button
+            btnPressed <<= 1;
+            if(btnPressed > GAMEPAD_BUTTON_THUMBR)
+            {
+                btnPressed = GAMEPAD_BUTTON_A;
+            }
+
+            // Move to the next hat dir
+            hatDir++;
+            if(hatDir > GAMEPAD_HAT_UP_LEFT)
+            {
+                hatDir = GAMEPAD_HAT_CENTERED;
+            }
         }
-        megaIdx = (megaIdx + 1) % 9;
     }
+}
 
+/**
+ * @brief Draw the demo when a frame is due. Everything that animates is
+ * updated in demoMainLoop(), so this only draws the latest state
+ *
+ * @param elapsedUs unused
+ */
+void demoFrameCb(int64_t elapsedUs __attribute__((unused)))
+{
     demo->disp->clearPx();
 
     // Draw the spectrum as a bar graph
@@ -255,7 +309,7 @@ void demoMainLoop(int64_t elapsedUs)
     drawText(demo->disp, &demo->radiostars, c500, "hello TFT", 10, 64);
 
     // Draw image
-    drawWsg(demo->disp, &demo->megaman[megaIdx], megaPos, (demo->disp->h-demo->megaman[0].h)/2, false, false, 0);
+    drawWsg(demo->disp, &demo->megaman[demo->megaIdx], demo->megaPos, (demo->disp->h-demo->megaman[0].h)/2, false, false, 0);
 
     // Draw a single white pixel in the middle of the display
     demo->disp->setPx(
@@ -282,44 +336,6 @@ void demoMainLoop(int64_t elapsedUs)
     char accelStr[128];
     sprintf(accelStr, "X: %3d, Y: %3d, Z: %3d", demo->accel.x, demo->accel.y, demo->accel.z);
     drawText(demo->disp, &(demo->ibm_vga8), c055, accelStr, 0, demo->disp->h - demo->ibm_vga8.h);
-
-    // Twice a second push out some USB data
-    static uint64_t usbTime = 0;
-    usbTime += elapsedUs;
-    if(usbTime >= 500000)
-    {
-        usbTime -= 500000;
-
-        // Only send data if USB is ready
-        if(tud_ready())
-        {
-            // Static variables to track button and hat position
-            static hid_gamepad_button_bm_t btnPressed = GAMEPAD_BUTTON_A;
-            static hid_gamepad_hat_t hatDir = GAMEPAD_HAT_CENTERED;
-
-            // Build and send the state over USB
-            hid_gamepad_report_t report =
-            {
-                .buttons = btnPressed,
-                .hat = hatDir
-            };
-            tud_gamepad_report(&report);
-
-            // Move to the next button
-            btnPressed <<= 1;
-            if(btnPressed > GAMEPAD_BUTTON_THUMBR)
-            {
-                btnPressed = GAMEPAD_BUTTON_A;
-            }
-
-            // Move to the next hat dir
-            hatDir++;
-            if(hatDir > GAMEPAD_HAT_UP_LEFT)
-            {
-                hatDir = GAMEPAD_HAT_CENTERED;
-            }
-        }
-    }
 }
 
 /**
@@ -450,7 +466,7 @@ void demoConCbFn(p2pInfo* p2p __attribute__((unused)), connectionEvt_t evt)
                 case GOING_FIRST:
                 {
                     const char randPayload[] = "zb4o5LBYgsmDuyreOtBcPIi8kINXYW0";
-                    p2pSendMsg(p2p, "gst", randPayload, sizeof(randPayload), demoMsgTxCbFn);
+                    p2pSendMsg(p2p, DEMO_MSG_ECHO, (const uint8_t*)randPayload, sizeof(randPayload), demoMsgTxCbFn);
                     break;
                 } 
             }
@@ -470,16 +486,16 @@ void demoConCbFn(p2pInfo* p2p __attribute__((unused)), connectionEvt_t evt)
  * @brief TODO
  *
  * @param p2p
- * @param msg
+ * @param msgType
  * @param payload
  * @param len
  */
-void demoMsgRxCbFn(p2pInfo* p2p, const char* msg, const char* payload, uint8_t len)
+void demoMsgRxCbFn(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload, uint8_t len)
 {
-    ESP_LOGD("DEMO", "%s -> [%d] -> %s", __func__, len, payload);
+    ESP_LOGD("DEMO", "%s -> [%d] -> %.*s", __func__, len, len, (const char*)payload);
 
     // Echo
-    p2pSendMsg(p2p, msg, payload, len, demoMsgTxCbFn);
+    p2pSendMsg(p2p, msgType, payload, len, demoMsgTxCbFn);
 
     if(0 == demo->packetTimer)
     {
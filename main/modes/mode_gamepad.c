@@ -16,8 +16,7 @@
 // Functions Prototypes
 //==============================================================================
 
-void gamepadEnterMode(display_t * disp);
-void gamepadExitMode(void);
+void gamepadEnterMode(display_t * disp, arena_t * arena);
 void gamepadMainLoop(int64_t elapsedUs);
 void gamepadButtonCb(buttonEvt_t* evt);
 void gamepadTouchCb(touch_event_t* evt);
@@ -37,7 +36,7 @@ swadgeMode modeGamepad =
 {
     .modeName = "Gamepad",
     .fnEnterMode = gamepadEnterMode,
-    .fnExitMode = gamepadExitMode,
+    .fnExitMode = NULL,
     .fnMainLoop = gamepadMainLoop,
     .fnButtonCallback = gamepadButtonCb,
     .fnTouchCallback = gamepadTouchCb,
@@ -46,7 +45,9 @@ swadgeMode modeGamepad =
     .fnEspNowSendCb = NULL,
     .fnAccelerometerCallback = NULL,
     .fnAudioCallback = NULL,
-    .fnTemperatureCallback = NULL
+    .fnTemperatureCallback = NULL,
+    .fnFrameCallback = NULL,
+    .frameRate = 0
 };
 
 //==============================================================================
@@ -57,24 +58,15 @@ swadgeMode modeGamepad =
  * @brief TODO
  *
  */
-void gamepadEnterMode(display_t * disp)
+void gamepadEnterMode(display_t * disp, arena_t * arena)
 {
     // Allocate memory for this mode
-    gamepad = (gamepad_t *)calloc(1, sizeof(gamepad_t));
+    gamepad = (gamepad_t *)arenaAlloc(arena, sizeof(gamepad_t));
  
     // Save a pointer to the display
     gamepad->disp = disp;
 }
 
-/**
- * @brief TODO
- *
- */
-void gamepadExitMode(void)
-{
-    free(gamepad);
-}
-
 /**
  * @brief TODO
  *
@@ -12,14 +12,15 @@
 #include "mode_main_menu.h"
 
 #include "meleeMenu.h"
+#include "profiler.h"
 
 //==============================================================================
 // Functions Prototypes
 //==============================================================================
 
-void mainMenuEnterMode(display_t * disp);
+void mainMenuEnterMode(display_t * disp, arena_t * arena);
 void mainMenuExitMode(void);
-void mainMenuMainLoop(int64_t elapsedUs);
+void mainMenuFrameCb(int64_t elapsedUs);
 void mainMenuButtonCb(buttonEvt_t* evt);
 void mainMenuCb(const char* opt);
 
@@ -40,12 +41,15 @@ typedef struct
 
 mainMenu_t * mainMenu;
 
+// The row which toggles the profiling overlay, which is drawn over every mode
+static const char mainMenuProfiler[] = "Profiler";
+
 swadgeMode modeMainMenu =
 {
     .modeName = "mainMenu",
     .fnEnterMode = mainMenuEnterMode,
     .fnExitMode = mainMenuExitMode,
-    .fnMainLoop = mainMenuMainLoop,
+    .fnMainLoop = NULL,
     .fnButtonCallback = mainMenuButtonCb,
     .fnTouchCallback = NULL,
     .wifiMode = NO_WIFI,
@@ -53,7 +57,9 @@ swadgeMode modeMainMenu =
     .fnEspNowSendCb = NULL,
     .fnAccelerometerCallback = NULL,
     .fnAudioCallback = NULL,
-    .fnTemperatureCallback = NULL
+    .fnTemperatureCallback = NULL,
+    .fnFrameCallback = mainMenuFrameCb,
+    .frameRate = 0
 };
 
 //==============================================================================
@@ -64,11 +70,10 @@ swadgeMode modeMainMenu =
  * @brief TODO
  *
  */
-void mainMenuEnterMode(display_t * disp)
+void mainMenuEnterMode(display_t * disp, arena_t * arena)
 {
     // Allocate memory for this mode
-    mainMenu = (mainMenu_t *)malloc(sizeof(mainMenu_t));
-    memset(mainMenu, 0, sizeof(mainMenu_t));
+    mainMenu = (mainMenu_t *)arenaAlloc(arena, sizeof(mainMenu_t));
 
     // Save a pointer to the display
     mainMenu->disp = disp;
@@ -82,6 +87,7 @@ void mainMenuEnterMode(display_t * disp)
     {
         addRowToMeleeMenu(mainMenu->menu, swadgeModes[idx]->modeName);
     }
+    addRowToMeleeMenu(mainMenu->menu, mainMenuProfiler);
 }
 
 
@@ -93,15 +99,14 @@ void mainMenuExitMode(void)
 {
     deinitMeleeMenu(mainMenu->menu);
     freeFont(&mainMenu->meleeMenuFont);
-    free(mainMenu);
 }
 
 /**
- * @brief TODO
+ * @brief Draw the menu when a frame is due
  *
- * @param elapsedUs
+ * @param elapsedUs unused
  */
-void mainMenuMainLoop(int64_t elapsedUs __attribute__((unused)))
+void mainMenuFrameCb(int64_t elapsedUs __attribute__((unused)))
 {
     drawMeleeMenu(mainMenu->disp, mainMenu->menu);
 }
@@ -144,6 +149,12 @@ void mainMenuButtonCb(buttonEvt_t* evt)
  */
 void mainMenuCb(const char* opt)
 {
+    if(opt == mainMenuProfiler)
+    {
+        setProfileOverlay(!isProfileOverlayEnabled());
+        return;
+    }
+
     uint8_t numSwadgeModes = getNumSwadgeModes();
     for(uint8_t idx = 1; idx < numSwadgeModes; idx++)
     {
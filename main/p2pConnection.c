@@ -1,36 +1,47 @@
 /* PlantUML documentation
 
+Messages are shown as [message type, sequence number, destination MAC]
+ACKs are shown as [ACK, next sequence number expected, destination MAC] {selective ACKs}
+
 == Connection ==
 
 group Part 1
-"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "p2p_con" (broadcast)
-"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "p2p_str_00_AB:AB:AB:AB:AB:AB"
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[CON, 0, FF:FF:FF:FF:FF:FF]" (broadcast)
+"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "[STR, 0, AB:AB:AB:AB:AB:AB]"
 note left: Stop Broadcasting, set p2p->cnc.rxGameStartMsg
-"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "p2p_ack_00_12:12:12:12:12:12"
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[ACK, 1, 12:12:12:12:12:12] {}"
 note right: set p2p->cnc.rxGameStartAck
 end
 
 group Part 2
-"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "p2p_con" (broadcast)
-"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "p2p_str_01_12:12:12:12:12:12"
-note right: Stop Broadcasting, set p2p->cnc.rxGameStartMsg, become CLIENT
-"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "p2p_ack_01_AB:AB:AB:AB:AB:AB"
-note left: set p2p->cnc.rxGameStartAck, become SERVER
+"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "[CON, 0, FF:FF:FF:FF:FF:FF]" (broadcast)
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[STR, 0, 12:12:12:12:12:12]"
+note right: Stop Broadcasting, set p2p->cnc.rxGameStartMsg
+"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "[ACK, 1, AB:AB:AB:AB:AB:AB] {}"
+note left: set p2p->cnc.rxGameStartAck
 end
 
+note over "Swadge_AB:AB:AB:AB:AB:AB", "Swadge_12:12:12:12:12:12" : The lower MAC goes first
+
 == Unreliable Communication Example ==
 
-group Retries & Sequence Numbers
-"Swadge_AB:AB:AB:AB:AB:AB" ->x "Swadge_12:12:12:12:12:12" : "p2p_cnt_04_12:12:12:12:12:12_up"
+group Sliding Window, Retries & Sequence Numbers
+"Swadge_AB:AB:AB:AB:AB:AB" ->x "Swadge_12:12:12:12:12:12" : "[mode type, 4, 12:12:12:12:12:12] payload"
 note right: msg not received
-"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "p2p_cnt_04_12:12:12:12:12:12_up"
-note left: first retry, up to five retries
-"Swadge_12:12:12:12:12:12" ->x "Swadge_AB:AB:AB:AB:AB:AB" : "p2p_ack_04_AB:AB:AB:AB:AB:AB"
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[mode type, 5, 12:12:12:12:12:12] payload"
+note left: sent without waiting for 4 to be acked, up to P2P_WINDOW_SIZE in flight
+note right: early, buffer it until 4 arrives
+"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "[ACK, 4, AB:AB:AB:AB:AB:AB] {5}"
+note left: 5 is acked, 4 is not
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[mode type, 4, 12:12:12:12:12:12] payload"
+note left: 4's retry timer expires, only 4 is sent again
+note right: hand 4 then 5 to the mode
+"Swadge_12:12:12:12:12:12" ->x "Swadge_AB:AB:AB:AB:AB:AB" : "[ACK, 6, AB:AB:AB:AB:AB:AB] {}"
 note left: ack not received
-"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "p2p_cnt_04_12:12:12:12:12:12_up"
-note left: second retry
-note right: duplicate seq num, ignore message
-"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "p2p_ack_05_AB:AB:AB:AB:AB:AB"
+"Swadge_AB:AB:AB:AB:AB:AB" ->  "Swadge_12:12:12:12:12:12" : "[mode type, 4, 12:12:12:12:12:12] payload"
+note left: second retry, give up after RETRY_TIME_US
+note right: old seq num, ack again but ignore message
+"Swadge_12:12:12:12:12:12" ->  "Swadge_AB:AB:AB:AB:AB:AB" : "[ACK, 6, AB:AB:AB:AB:AB:AB] {}"
 end
 
 */
@@ -56,43 +67,58 @@ end
 // The time we'll spend retrying messages
 #define RETRY_TIME_US 3000000
 
+// Retransmission timeouts, computed from the round trip time like RFC 6298.
+// Before the RTT is measured, wait 1ms for transmission plus 69ms (the
+// measured worst case). The RFC's 1s minimum is far too slow for ESP-NOW,
+// but not retrying for a few frames keeps a busy main loop from looking like
+// lost messages. The maximum leaves room for a few retries in RETRY_TIME_US
+#define INITIAL_RTO_US 70000
+#define MIN_RTO_US     30000
+#define MAX_RTO_US     500000
+// The timers are all millisecond, the RFC's G
+#define CLOCK_GRANULARITY_US 1000
+
 // Time to wait between connection events and game rounds.
 // Transmission can be 3s (see above), the round @ 12ms period is 3.636s
 // (240 steps of rotation + (252/4) steps of decay) * 12ms
 #define FAILURE_RESTART_US 8000000
 
-// Indices into messages
-#define CMD_IDX 4
-#define SEQ_IDX 8
-#define MAC_IDX 11
-#define EXT_IDX 29
+// Selective ACKs are a uint32_t, one bit per message after the first missing one
+#if P2P_WINDOW_SIZE > 33
+#error "P2P_WINDOW_SIZE is too large for selective ACKs"
+#endif
 
 //==============================================================================
 // Variables
 //==============================================================================
 
-// Messages to send.
-const char p2pConnectionMsgFmt[] = "%s_con";
-const char p2pNoPayloadMsgFmt[]  = "%s_%s_%02d_%02X:%02X:%02X:%02X:%02X:%02X";
-const char p2pPayloadMsgFmt[]    = "%s_%s_%02d_%02X:%02X:%02X:%02X:%02X:%02X_%s";
-const char p2pMacFmt[] = "%02X:%02X:%02X:%02X:%02X:%02X";
+// The destination of broadcasts
+static const uint8_t p2pBroadcastMac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
 
 //==============================================================================
 // Function Prototypes
 //==============================================================================
 
 void p2pConnectionTimeout(void* arg);
-void p2pTxAllRetriesTimeout(void* arg);
 void p2pTxRetryTimeout(void* arg);
 void p2pRestart(void* arg);
+static void p2pResetState(p2pInfo* p2p, const char* msgId, p2pConCbFn conCbFn,
+                          p2pMsgRxCbFn msgRxCbFn, int8_t connectionRssi);
 void p2pStartRestartTimer(void* arg);
 void p2pProcConnectionEvt(p2pInfo* p2p, connectionEvt_t event);
 void p2pGameStartAckRecv(void* arg);
+void p2pStartMsgTxCbFn(p2pInfo* p2p, messageStatus_t status);
 void p2pSendAckToMac(p2pInfo* p2p, const uint8_t* mac_addr);
-void p2pSendMsgEx(p2pInfo* p2p, char* msg, uint16_t len,
-                  bool shouldAck, void (*success)(void*), void (*failure)(void*));
-void p2pModeMsgSuccess(void* arg);
-void p2pModeMsgFailure(void* arg);
+void p2pRecvAck(p2pInfo* p2p, uint16_t seqNum, uint32_t selectiveAcks);
+void p2pAdvanceRxWindow(p2pInfo* p2p, const uint8_t* mac_addr, uint16_t seqNum);
+uint8_t p2pBuildMsg(p2pInfo* p2p, uint8_t* msg, uint8_t msgType, uint16_t seqNum,
+                    const uint8_t* dstMac, const uint8_t* payload, uint8_t len);
+bool p2pSendMsgEx(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload,
+                  uint8_t len, p2pMsgTxCbFn msgTxCbFn);
+void p2pTransmitSlot(p2pInfo* p2p, p2pTxSlot_t* slot, int64_t nowUs);
+void p2pUpdateRto(p2pInfo* p2p, uint32_t rttUs);
+void p2pStartTxRetryTimer(p2pInfo* p2p);
+void p2pAdvanceTxWindow(p2pInfo* p2p);
 
 //==============================================================================
 // Functions
@@ -116,63 +142,9 @@ void p2pInitialize(p2pInfo* p2p, char* msgId, p2pConCbFn conCbFn,
                    p2pMsgRxCbFn msgRxCbFn, int8_t connectionRssi)
 {
     ESP_LOGD("P2P", "%s", __func__);
-    // Make sure everything is zero!
-    memset(p2p, 0, sizeof(p2pInfo));
-
-    // Set the callback functions for connection and message events
-    p2p->conCbFn = conCbFn;
-    p2p->msgRxCbFn = msgRxCbFn;
-
-    // Set the initial sequence number at 255 so that a 0 received is valid.
-    p2p->cnc.lastSeqNum = 255;
-
-    // Set the connection Rssi, the higher the value, the closer the swadges
-    // need to be.
-    p2p->connectionRssi = connectionRssi;
-
-    // Set the three character message ID
-    memcpy(p2p->msgId, msgId, sizeof(p2p->msgId));
+    p2pResetState(p2p, msgId, conCbFn, msgRxCbFn, connectionRssi);
 
-    // Get and save the string form of our MAC address
-    uint8_t mymac[6];
-    esp_wifi_get_mac(WIFI_IF_STA, mymac);
-    snprintf(p2p->cnc.macStr, sizeof(p2p->cnc.macStr), p2pMacFmt,
-             mymac[0],
-             mymac[1],
-             mymac[2],
-             mymac[3],
-             mymac[4],
-             mymac[5]);
-
-    // Set up the connection message
-    snprintf(p2p->conMsg, sizeof(p2p->conMsg), p2pConnectionMsgFmt,
-             p2p->msgId);
-
-    // Set up dummy ACK message
-    snprintf(p2p->ackMsg, sizeof(p2p->ackMsg), p2pNoPayloadMsgFmt,
-             p2p->msgId,
-             "ack",
-             0,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF);
-
-    // Set up dummy start message
-    snprintf(p2p->startMsg, sizeof(p2p->startMsg), p2pNoPayloadMsgFmt,
-             p2p->msgId,
-             "str",
-             0,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF,
-             0xFF);
-
-    // Set up a timer for acking messages
+    // Set up a timer for retrying messages which aren't acked
     esp_timer_create_args_t p2pTxRetryTimeoutArgs =
     {
         .callback = p2pTxRetryTimeout,
@@ -183,17 +155,6 @@ void p2pInitialize(p2pInfo* p2p, char* msgId, p2pConCbFn conCbFn,
     };
     esp_timer_create(&p2pTxRetryTimeoutArgs, &p2p->tmr.TxRetry);
 
-    // Set up a timer for when a message never gets ACKed
-    esp_timer_create_args_t p2pTxAllRetriesTimeoutArgs =
-    {
-        .callback = p2pTxAllRetriesTimeout,
-        .arg = p2p,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "p2ptart",
-        .skip_unhandled_events = false,
-    };
-    esp_timer_create(&p2pTxAllRetriesTimeoutArgs, &p2p->tmr.TxAllRetries);
-
     // Set up a timer to restart after abject failure
     esp_timer_create_args_t p2pRestartArgs =
     {
@@ -217,6 +178,42 @@ void p2pInitialize(p2pInfo* p2p, char* msgId, p2pConCbFn conCbFn,
     esp_timer_create(&p2pConnectionTimeoutArgs, &p2p->tmr.Connection);
 }
 
+/**
+ * Reset all the state to start connecting from scratch, and set what
+ * p2pInitialize() was given. This doesn't create or delete the timers, and the
+ * handles in p2p are cleared, so the caller must keep them
+ *
+ * @param p2p           The p2pInfo struct with all the state information
+ * @param msgId         A three character, null terminated message ID
+ * @param conCbFn       Called when connection events occur
+ * @param msgRxCbFn     Called when a packet is received for the swadge mode
+ * @param connectionRssi The strength needed to start a connection
+ */
+static void p2pResetState(p2pInfo* p2p, const char* msgId, p2pConCbFn conCbFn,
+                          p2pMsgRxCbFn msgRxCbFn, int8_t connectionRssi)
+{
+    // Make sure everything is zero! Both sides start sending and receiving
+    // at sequence number 0, the start message
+    memset(p2p, 0, sizeof(p2pInfo));
+
+    // Set the callback functions for connection and message events
+    p2p->conCbFn = conCbFn;
+    p2p->msgRxCbFn = msgRxCbFn;
+
+    // Set the connection Rssi, the higher the value, the closer the swadges
+    // need to be.
+    p2p->connectionRssi = connectionRssi;
+
+    // Set the three character message ID
+    memcpy(p2p->msgId, msgId, sizeof(p2p->msgId));
+
+    // Get and save our MAC address, to check the destination of messages
+    esp_wifi_get_mac(WIFI_IF_STA, p2p->cnc.myMac);
+
+    // Nothing is known about the round trip time yet
+    p2p->stats.rtoUs = INITIAL_RTO_US;
+}
+
 /**
  * Start the connection process by sending broadcasts and notify the mode
  *
@@ -234,18 +231,24 @@ void p2pStartConnection(p2pInfo* p2p)
 }
 
 /**
- * Stop up all timers
+ * Stop and delete all timers. p2pInitialize() must be called again before
+ * p2p is used
  *
  * @param p2p The p2pInfo struct with all the state information
  */
 void p2pDeinit(p2pInfo* p2p)
 {
     ESP_LOGD("P2P", "%s", __func__);
-
-    esp_timer_stop(p2p->tmr.Connection);
-    esp_timer_stop(p2p->tmr.TxRetry);
-    esp_timer_stop(p2p->tmr.Reinit);
-    esp_timer_stop(p2p->tmr.TxAllRetries);
+    esp_timer_handle_t* timers[] = {&p2p->tmr.Connection, &p2p->tmr.TxRetry, &p2p->tmr.Reinit};
+    for(uint8_t i = 0; i < sizeof(timers) / sizeof(timers[0]); i++)
+    {
+        if(NULL != *timers[i])
+        {
+            esp_timer_stop(*timers[i]);
+            esp_timer_delete(*timers[i]);
+            *timers[i] = NULL;
+        }
+    }
 }
 
 /**
@@ -260,10 +263,12 @@ void p2pDeinit(p2pInfo* p2p)
 void p2pConnectionTimeout(void* arg)
 {
     ESP_LOGD("P2P", "%s", __func__);
-
     p2pInfo* p2p = (p2pInfo*)arg;
+
     // Send a connection broadcast
-    p2pSendMsgEx(p2p, p2p->conMsg, strlen(p2p->conMsg) + 1, false, NULL, NULL);
+    uint8_t conMsg[sizeof(p2pHeader_t)];
+    uint8_t len = p2pBuildMsg(p2p, conMsg, P2P_MSG_CON, 0, p2pBroadcastMac, NULL, 0);
+    espNowSend((const char*)conMsg, len);
 
     // esp_random returns a 32 bit number, so this is [500ms,1500ms]
     uint32_t timeoutUs = 1000 * (100 * (5 + (esp_random() % 11)));
@@ -274,201 +279,369 @@ void p2pConnectionTimeout(void* arg)
 }
 
 /**
- * Retries sending a message to be acked
+ * Retries sending every message whose retry time has passed, and gives up on
+ * messages which have been retried for RETRY_TIME_US
  *
- * Called from the tmr.TxRetry timer. The timer is set when a message to be
- * ACKed is sent and cleared when an ACK is received
+ * Called from the tmr.TxRetry timer. The timer is set for the earliest retry
+ * time of all the messages which haven't been acked yet
  *
  * @param arg The p2pInfo struct with all the state information
  */
 void p2pTxRetryTimeout(void* arg)
 {
     ESP_LOGD("P2P", "%s", __func__);
-
     p2pInfo* p2p = (p2pInfo*)arg;
 
-    if(p2p->ack.msgToAckLen > 0)
+    // Failure callbacks are called after the window is updated, because they
+    // may send more messages or restart the connection
+    p2pMsgTxCbFn failedCbs[P2P_WINDOW_SIZE];
+    uint8_t numFailed = 0;
+
+    bool isBackedOff = false;
+    int64_t nowUs = esp_timer_get_time();
+    for(uint16_t seqNum = p2p->tx.baseSeqNum; seqNum != p2p->tx.nextSeqNum; seqNum++)
+    {
+        p2pTxSlot_t* slot = &p2p->tx.slots[seqNum % P2P_WINDOW_SIZE];
+        if(!slot->inUse || nowUs < slot->retryUs)
+        {
+            continue;
+        }
+
+        if(nowUs - slot->firstSentUs >= RETRY_TIME_US)
+        {
+            // Give up on this message. The receiver skips over it once
+            // messages after it arrive
+            ESP_LOGD("P2P", "Message totally failed %u", seqNum);
+            failedCbs[numFailed++] = slot->msgTxCbFn;
+            slot->inUse = false;
+            p2p->stats.msgsFailed++;
+        }
+        else
+        {
+            // Double the timeout once per expiry, not once per message, so
+            // a window of lost messages doesn't back off all the way
+            if(!isBackedOff)
+            {
+                isBackedOff = true;
+                p2p->stats.rtoUs *= 2;
+                if(p2p->stats.rtoUs > MAX_RTO_US)
+                {
+                    p2p->stats.rtoUs = MAX_RTO_US;
+                }
+            }
+
+            ESP_LOGD("P2P", "Retrying message %u", seqNum);
+            slot->isRetransmitted = true;
+            p2p->stats.retransmits++;
+            p2pTransmitSlot(p2p, slot, nowUs);
+        }
+    }
+
+    p2pAdvanceTxWindow(p2p);
+    p2pStartTxRetryTimer(p2p);
+
+    // Call the failure functions
+    for(uint8_t i = 0; i < numFailed; i++)
     {
-        ESP_LOGD("P2P", "Retrying message \"%s\"", p2p->ack.msgToAck);
-        p2pSendMsgEx(p2p, p2p->ack.msgToAck, p2p->ack.msgToAckLen + 1, true, p2p->ack.SuccessFn, p2p->ack.FailureFn);
+        if(NULL != failedCbs[i])
+        {
+            failedCbs[i](p2p, MSG_FAILED);
+        }
     }
 }
 
 /**
- * Stops a message transmission attempt after all retries have been exhausted
- * and calls p2p->ack.FailureFn() if a function was given
- *
- * Called from the tmr.TxAllRetries timer. The timer is set when a message to
- * be ACKed is sent for the first time and cleared when the message is ACKed.
+ * Send a message from one Swadge to another. This must not be called before
+ * the CON_ESTABLISHED event occurs. Message addressing, ACKing, and retries
+ * all happen automatically. Up to P2P_WINDOW_SIZE messages may wait for ACKs
+ * at once, and they are received in the order they were sent
  *
- * @param arg The p2pInfo struct with all the state information
+ * @param p2p       The p2pInfo struct with all the state information
+ * @param msgType   The mode's message type, any value below P2P_MSG_CON
+ * @param payload   An optional message payload, may be NULL
+ * @param len       The length of the optional payload, up to P2P_MAX_DATA_LEN.
+ *                  May be 0
+ * @param msgTxCbFn A callback function when this message is ACKed or dropped
+ * @return true if the message was sent, false if it was too long or
+ *         P2P_WINDOW_SIZE messages are already waiting for ACKs
  */
-void p2pTxAllRetriesTimeout(void* arg)
+bool p2pSendMsg(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload,
+                uint8_t len, p2pMsgTxCbFn msgTxCbFn)
 {
     ESP_LOGD("P2P", "%s", __func__);
 
-    p2pInfo* p2p = (p2pInfo*)arg;
+    if(len > P2P_MAX_DATA_LEN)
+    {
+        ESP_LOGE("P2P", "Payload too long, %d > %d", len, (int)P2P_MAX_DATA_LEN);
+        return false;
+    }
 
-    // Disarm all timers
-    esp_timer_stop(p2p->tmr.TxRetry);
-    esp_timer_stop(p2p->tmr.TxAllRetries);
+    return p2pSendMsgEx(p2p, msgType, payload, len, msgTxCbFn);
+}
 
-    // Call the failure function
-    ESP_LOGD("P2P", "Message totally failed \"%s\"", p2p->ack.msgToAck);
-    if(NULL != p2p->ack.FailureFn)
+/**
+ * Build a message, a header followed by the payload
+ *
+ * @param p2p     The p2pInfo struct with all the state information
+ * @param msg     The buffer to build the message in, at least P2P_MAX_MSG_LEN
+ *                bytes if there is a payload
+ * @param msgType The message type
+ * @param seqNum  The sequence number
+ * @param dstMac  The MAC to send the message to
+ * @param payload The payload, may be NULL
+ * @param len     The length of the payload, up to P2P_MAX_DATA_LEN
+ * @return The length of the message
+ */
+uint8_t p2pBuildMsg(p2pInfo* p2p, uint8_t* msg, uint8_t msgType, uint16_t seqNum,
+                    const uint8_t* dstMac, const uint8_t* payload, uint8_t len)
+{
+    p2pHeader_t* hdr = (p2pHeader_t*)msg;
+    memcpy(hdr->modeId, p2p->msgId, sizeof(hdr->modeId));
+    hdr->msgType = msgType;
+    hdr->seqNum = seqNum;
+    memcpy(hdr->dstMac, dstMac, sizeof(hdr->dstMac));
+
+    if(NULL == payload)
     {
-        p2p->ack.FailureFn(p2p);
+        len = 0;
     }
-
-    // Clear out the ack variables
-    memset(&p2p->ack, 0, sizeof(p2p->ack));
+    else
+    {
+        memcpy(&msg[sizeof(p2pHeader_t)], payload, len);
+    }
+    return sizeof(p2pHeader_t) + len;
 }
 
 /**
- * Send a message from one Swadge to another. This must not be called before
- * the CON_ESTABLISHED event occurs. Message addressing, ACKing, and retries
- * all happen automatically
+ * Send a message to the other Swadge which must be ACKed, with the next
+ * sequence number. It is retried until it's ACKed or RETRY_TIME_US passes
  *
  * @param p2p       The p2pInfo struct with all the state information
- * @param msg       The mandatory three char message type
- * @param payload   An optional message payload string, may be NULL, up to 32 chars
- * @param len       The length of the optional message payload string. May be 0
- * @param msgTxCbFn A callback function when this message is ACKed or dropped
+ * @param msgType   The message type
+ * @param payload   The payload, may be NULL
+ * @param len       The length of the payload, up to P2P_MAX_DATA_LEN
+ * @param msgTxCbFn A callback function when this message is ACKed or dropped.
+ *                  May be NULL
+ * @return true if the message was sent, false if the window is full
  */
-void p2pSendMsg(p2pInfo* p2p, const char* msg, const char* payload,
-                uint16_t len, p2pMsgTxCbFn msgTxCbFn)
+bool p2pSendMsgEx(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload,
+                  uint8_t len, p2pMsgTxCbFn msgTxCbFn)
 {
-    ESP_LOGD("P2P", "%s", __func__);
+    if((uint16_t)(p2p->tx.nextSeqNum - p2p->tx.baseSeqNum) >= P2P_WINDOW_SIZE)
+    {
+        ESP_LOGW("P2P", "%d messages already waiting for ACKs", P2P_WINDOW_SIZE);
+        return false;
+    }
+
+    uint16_t seqNum = p2p->tx.nextSeqNum++;
+    ESP_LOGD("P2P", "%12s: type %02X, seq %u", __func__, msgType, seqNum);
+
+    p2pTxSlot_t* slot = &p2p->tx.slots[seqNum % P2P_WINDOW_SIZE];
+    slot->inUse = true;
+    slot->len = p2pBuildMsg(p2p, slot->msg, msgType, seqNum, p2p->cnc.otherMac, payload, len);
+    slot->msgTxCbFn = msgTxCbFn;
+    slot->firstSentUs = esp_timer_get_time();
+    slot->isRetransmitted = false;
+    p2p->stats.msgsSent++;
+    p2pTransmitSlot(p2p, slot, slot->firstSentUs);
+    p2pStartTxRetryTimer(p2p);
+    return true;
+}
 
-    char builtMsg[P2P_MAX_MSG_LEN] = {0};
+/**
+ * Transmit a message waiting for an ACK and set when it should be retried
+ *
+ * @param p2p   The p2pInfo struct with all the state information
+ * @param slot  The message to transmit
+ * @param nowUs The current time
+ */
+void p2pTransmitSlot(p2pInfo* p2p, p2pTxSlot_t* slot, int64_t nowUs)
+{
+    // Wait for the retransmission timeout, then add some randomness
+    // [0ms to 15ms random] so nearby Swadges don't retry in lockstep
+    slot->lastSentUs = nowUs;
+    slot->retryUs = nowUs + p2p->stats.rtoUs + 1000 * (esp_random() & 0b1111);
+    espNowSend((const char*)slot->msg, slot->len);
+
+    uint32_t numTx = p2p->stats.msgsSent + p2p->stats.retransmits;
+    p2p->stats.lossPct = (100 * (uint64_t)p2p->stats.retransmits) / numTx;
+}
 
-    if(NULL == payload || len == 0)
+/**
+ * Measure the round trip time and compute the retransmission timeout from
+ * it, as in RFC 6298. This also clears any backoff
+ *
+ * @param p2p   The p2pInfo struct with all the state information
+ * @param rttUs The time between sending a message once and it being acked
+ */
+void p2pUpdateRto(p2pInfo* p2p, uint32_t rttUs)
+{
+    p2pStats_t* stats = &p2p->stats;
+    if(0 == stats->rttSamples)
     {
-        snprintf(builtMsg, sizeof(builtMsg), p2pNoPayloadMsgFmt,
-                 p2p->msgId,
-                 msg,
-                 0, // sequence number
-                 p2p->cnc.otherMac[0],
-                 p2p->cnc.otherMac[1],
-                 p2p->cnc.otherMac[2],
-                 p2p->cnc.otherMac[3],
-                 p2p->cnc.otherMac[4],
-                 p2p->cnc.otherMac[5]);
+        stats->srttUs = rttUs;
+        stats->rttVarUs = rttUs / 2;
     }
     else
     {
-        snprintf(builtMsg, sizeof(builtMsg), p2pPayloadMsgFmt,
-                 p2p->msgId,
-                 msg,
-                 0, // sequence number, filled in later
-                 p2p->cnc.otherMac[0],
-                 p2p->cnc.otherMac[1],
-                 p2p->cnc.otherMac[2],
-                 p2p->cnc.otherMac[3],
-                 p2p->cnc.otherMac[4],
-                 p2p->cnc.otherMac[5],
-                 payload);
-    }
-
-    p2p->msgTxCbFn = msgTxCbFn;
-    p2pSendMsgEx(p2p, builtMsg, strlen(builtMsg) + 1, true, p2pModeMsgSuccess, p2pModeMsgFailure);
+        // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, then SRTT = 7/8 SRTT + 1/8 R
+        uint32_t errUs = (stats->srttUs > rttUs) ? (stats->srttUs - rttUs) : (rttUs - stats->srttUs);
+        stats->rttVarUs = (3 * stats->rttVarUs + errUs) / 4;
+        stats->srttUs = (7 * stats->srttUs + rttUs) / 8;
+    }
+    stats->rttSamples++;
+
+    // RTO = SRTT + max(G, 4 * RTTVAR)
+    uint32_t varUs = 4 * stats->rttVarUs;
+    if(varUs < CLOCK_GRANULARITY_US)
+    {
+        varUs = CLOCK_GRANULARITY_US;
+    }
+    stats->rtoUs = stats->srttUs + varUs;
+    if(stats->rtoUs < MIN_RTO_US)
+    {
+        stats->rtoUs = MIN_RTO_US;
+    }
+    else if(stats->rtoUs > MAX_RTO_US)
+    {
+        stats->rtoUs = MAX_RTO_US;
+    }
+    ESP_LOGD("P2P", "RTT %uus, SRTT %uus, RTTVAR %uus, RTO %uus", (unsigned int)rttUs,
+             (unsigned int)stats->srttUs, (unsigned int)stats->rttVarUs, (unsigned int)stats->rtoUs);
 }
 
 /**
- * Callback function for when a message sent by the Swadge mode, not during
- * the connection process, is ACKed
+ * Start the tmr.TxRetry timer for the earliest retry time of all the messages
+ * which haven't been acked, or stop it if there aren't any
  *
- * @param arg The p2pInfo struct with all the state information
+ * @param p2p The p2pInfo struct with all the state information
  */
-void p2pModeMsgSuccess(void* arg)
+void p2pStartTxRetryTimer(p2pInfo* p2p)
 {
-    ESP_LOGD("P2P", "%s", __func__);
+    esp_timer_stop(p2p->tmr.TxRetry);
 
-    p2pInfo* p2p = (p2pInfo*)arg;
-    if(NULL != p2p->msgTxCbFn)
+    bool isWaiting = false;
+    int64_t retryUs = 0;
+    for(uint16_t seqNum = p2p->tx.baseSeqNum; seqNum != p2p->tx.nextSeqNum; seqNum++)
+    {
+        p2pTxSlot_t* slot = &p2p->tx.slots[seqNum % P2P_WINDOW_SIZE];
+        if(slot->inUse && (!isWaiting || slot->retryUs < retryUs))
+        {
+            isWaiting = true;
+            retryUs = slot->retryUs;
+        }
+    }
+
+    if(isWaiting)
     {
-        p2p->msgTxCbFn(p2p, MSG_ACKED);
+        // The timers are all millisecond, so wait at least 1ms
+        int64_t waitUs = retryUs - esp_timer_get_time();
+        if(waitUs < 1000)
+        {
+            waitUs = 1000;
+        }
+        ESP_LOGD("P2P", "ack timer set for %dus", (int)waitUs);
+        esp_timer_start_once(p2p->tmr.TxRetry, waitUs);
     }
 }
 
 /**
- * Callback function for when a message sent by the Swadge mode, not during
- * the connection process, is dropped
+ * Slide the transmit window past every message at its start which has been
+ * acked or given up on, making room to send more
  *
- * @param arg The p2pInfo struct with all the state information
+ * @param p2p The p2pInfo struct with all the state information
  */
-void p2pModeMsgFailure(void* arg)
+void p2pAdvanceTxWindow(p2pInfo* p2p)
 {
-    ESP_LOGD("P2P", "%s", __func__);
-
-    p2pInfo* p2p = (p2pInfo*)arg;
-    if(NULL != p2p->msgTxCbFn)
+    while(p2p->tx.baseSeqNum != p2p->tx.nextSeqNum &&
+            !p2p->tx.slots[p2p->tx.baseSeqNum % P2P_WINDOW_SIZE].inUse)
     {
-        p2p->msgTxCbFn(p2p, MSG_FAILED);
+        p2p->tx.baseSeqNum++;
     }
 }
 
 /**
- * Wrapper for sending an ESP-NOW message. Handles ACKing and retries for
- * non-broadcast style messages
+ * Process an ACK. Every message before seqNum is acked, as is every message
+ * after it with a bit set in selectiveAcks. Messages which weren't acked, but
+ * were sent a round trip before a message which was, are probably lost, so
+ * they're sent again without waiting for the retransmission timeout
  *
- * @param p2p       The p2pInfo struct with all the state information
- * @param msg       The message to send, may contain destination MAC
- * @param len       The length of the message to send
- * @param shouldAck true if this message should be acked, false if we don't care
- * @param success   A callback function if the message is acked. May be NULL
- * @param failure   A callback function if the message isn't acked. May be NULL
+ * @param p2p           The p2pInfo struct with all the state information
+ * @param seqNum        The next sequence number the other Swadge expects
+ * @param selectiveAcks Bit i acks the message seqNum + 1 + i
  */
-void p2pSendMsgEx(p2pInfo* p2p, char* msg, uint16_t len,
-                  bool shouldAck, void (*success)(void*), void (*failure)(void*))
+void p2pRecvAck(p2pInfo* p2p, uint16_t seqNum, uint32_t selectiveAcks)
 {
-    ESP_LOGD("P2P", "%12s: %s", __func__, msg);
+    // Success callbacks are called after the window is updated, because they
+    // may send more messages
+    p2pMsgTxCbFn ackedCbs[P2P_WINDOW_SIZE];
+    uint8_t numAcked = 0;
 
-    // If this is a first time message and longer than a connection message
-    if( (p2p->ack.msgToAck != msg) && strlen(p2p->conMsg) < len)
+    int64_t nowUs = esp_timer_get_time();
+    for(uint16_t ackSeqNum = p2p->tx.baseSeqNum; ackSeqNum != p2p->tx.nextSeqNum; ackSeqNum++)
     {
-        // Insert a sequence number
-        msg[SEQ_IDX + 0] = '0' + (p2p->cnc.mySeqNum / 10);
-        msg[SEQ_IDX + 1] = '0' + (p2p->cnc.mySeqNum % 10);
+        p2pTxSlot_t* slot = &p2p->tx.slots[ackSeqNum % P2P_WINDOW_SIZE];
+        if(!slot->inUse)
+        {
+            continue;
+        }
 
-        // Increment the sequence number, 0-99
-        p2p->cnc.mySeqNum++;
-        if(100 == p2p->cnc.mySeqNum)
+        // Signed, so sequence numbers can wrap around
+        int16_t offset = (int16_t)(ackSeqNum - seqNum);
+        if(offset < 0 || (offset > 0 && offset <= 32 && (selectiveAcks & (1u << (offset - 1)))))
         {
-            p2p->cnc.mySeqNum = 0;
+            ESP_LOGD("P2P", "ACK received for %u", ackSeqNum);
+            ackedCbs[numAcked++] = slot->msgTxCbFn;
+            slot->inUse = false;
+            p2p->stats.msgsAcked++;
+
+            // Karn's algorithm, an ACK for a retransmitted message could be
+            // for any of its transmissions, so only time the others
+            if(!slot->isRetransmitted)
+            {
+                p2pUpdateRto(p2p, nowUs - slot->firstSentUs);
+            }
         }
     }
 
-    if(shouldAck)
+    // Find the newest message which was acked by this ACK or an earlier one
+    uint16_t newestAcked = p2p->tx.baseSeqNum;
+    bool isAnyAcked = false;
+    for(uint16_t ackSeqNum = p2p->tx.baseSeqNum; ackSeqNum != p2p->tx.nextSeqNum; ackSeqNum++)
     {
-        // Set the state to wait for an ack
-        p2p->ack.isWaitingForAck = true;
+        if(!p2p->tx.slots[ackSeqNum % P2P_WINDOW_SIZE].inUse)
+        {
+            newestAcked = ackSeqNum;
+            isAnyAcked = true;
+        }
+    }
 
-        // If this is not a retry
-        if(p2p->ack.msgToAck != msg)
+    // Retry the messages before it which should have been acked by now. This
+    // needs a round trip time to judge by, so wait for the first sample
+    bool canFastRetransmit = isAnyAcked && p2p->stats.rttSamples > 0;
+    for(uint16_t ackSeqNum = p2p->tx.baseSeqNum; canFastRetransmit && ackSeqNum != newestAcked; ackSeqNum++)
+    {
+        p2pTxSlot_t* slot = &p2p->tx.slots[ackSeqNum % P2P_WINDOW_SIZE];
+        if(slot->inUse && nowUs - slot->lastSentUs > p2p->stats.srttUs)
         {
-            ESP_LOGD("P2P", "sending for the first time");
+            ESP_LOGD("P2P", "Retrying message %u, later messages were acked", ackSeqNum);
+            slot->isRetransmitted = true;
+            p2p->stats.retransmits++;
+            p2pTransmitSlot(p2p, slot, nowUs);
+        }
+    }
 
-            // Store the message for potential retries
-            memcpy(p2p->ack.msgToAck, msg, len);
-            p2p->ack.msgToAckLen = len;
-            p2p->ack.SuccessFn = success;
-            p2p->ack.FailureFn = failure;
+    p2pAdvanceTxWindow(p2p);
+    p2pStartTxRetryTimer(p2p);
 
-            // Start a timer to retry for 3s total
-            esp_timer_stop(p2p->tmr.TxAllRetries);
-            esp_timer_start_once(p2p->tmr.TxAllRetries, RETRY_TIME_US);
-        }
-        else
+    // Call the success functions
+    for(uint8_t i = 0; i < numAcked; i++)
+    {
+        if(NULL != ackedCbs[i])
         {
-            ESP_LOGD("P2P", "this is a retry");
+            ackedCbs[i](p2p, MSG_ACKED);
         }
-
-        // Mark the time this transmission started, the retry timer gets
-        // started in p2pSendCb()
-        p2p->ack.timeSentUs = esp_timer_get_time();
     }
-    espNowSend(msg, len);
 }
 
 /**
@@ -479,46 +652,40 @@ void p2pSendMsgEx(p2pInfo* p2p, char* msg, uint16_t len,
  * @param data     The data
  * @param len      The length of the data
  * @param rssi     The rssi of the received data
- * @return false if the message was processed here,
- *         true if the message should be processed by the swadge mode
  */
 void p2pRecvCb(p2pInfo* p2p, const uint8_t* mac_addr, const char* data, uint8_t len, int8_t rssi)
 {
-    ESP_LOGD("P2P", "%12s - From %02X:%02X:%02X:%02X:%02X:%02X - %s", __func__,
+    ESP_LOGD("P2P", "%12s - From %02X:%02X:%02X:%02X:%02X:%02X - %d bytes", __func__,
                 mac_addr[0],
                 mac_addr[1],
                 mac_addr[2],
                 mac_addr[3],
                 mac_addr[4],
                 mac_addr[5],
-                data);
-
-    // Ignore the null terminator when checking the length
-    len--;
+                len);
 
     // Check if this message matches our message ID
-    if(len < CMD_IDX ||
-            (0 != memcmp(data, p2p->conMsg, CMD_IDX)))
+    const p2pHeader_t* hdr = (const p2pHeader_t*)data;
+    if(len < sizeof(p2pHeader_t) || len > P2P_MAX_MSG_LEN ||
+            (0 != memcmp(hdr->modeId, p2p->msgId, sizeof(hdr->modeId))))
     {
-        // This message is too short, or does not match our message ID
+        // This message is the wrong size, or does not match our message ID
         ESP_LOGD("P2P", "DISCARD: Not a message for '%s'", p2p->msgId);
         return;
     }
 
-    // If this message has a MAC, check it
-    if(len >= strlen(p2p->ackMsg) &&
-            0 != memcmp(&data[MAC_IDX], p2p->cnc.macStr, strlen(p2p->cnc.macStr)))
+    // Broadcasts are for everyone. Anything else has to be for us
+    if(P2P_MSG_CON != hdr->msgType &&
+            0 != memcmp(hdr->dstMac, p2p->cnc.myMac, sizeof(p2p->cnc.myMac)))
     {
         // This MAC isn't for us
         ESP_LOGD("P2P", "DISCARD: Not for our MAC.");
-        ESP_LOGD("P2P", "         Our MAC: %s", p2p->cnc.macStr);
-        ESP_LOGD("P2P", "         rx  MAC: %s", &data[MAC_IDX]);
         return;
     }
 
     // If this is anything besides a broadcast, check the other MAC
     if(p2p->cnc.otherMacReceived &&
-            len > strlen(p2p->conMsg) &&
+            P2P_MSG_CON != hdr->msgType &&
             0 != memcmp(mac_addr, p2p->cnc.otherMac, sizeof(p2p->cnc.otherMac)))
     {
         // This isn't from the other known swadge
@@ -526,142 +693,157 @@ void p2pRecvCb(p2pInfo* p2p, const uint8_t* mac_addr, const char* data, uint8_t
         return;
     }
 
-    // By here, we know the received message matches our message ID, either a
-    // broadcast or for us. If this isn't an ack message, ack it
-    if(len >= SEQ_IDX &&
-            0 != memcmp(data, p2p->ackMsg, SEQ_IDX))
-    {
-        p2pSendAckToMac(p2p, mac_addr);
-    }
+    const uint8_t* payload = (const uint8_t*)&data[sizeof(p2pHeader_t)];
+    uint8_t payloadLen = len - sizeof(p2pHeader_t);
 
-    // After ACKing the message, check the sequence number to see if we should
-    // process it or ignore it (we already did!)
-    if(len >= strlen(p2p->ackMsg))
+    switch(hdr->msgType)
     {
-        // Extract the sequence number
-        uint8_t theirSeq = 0;
-        theirSeq += (data[SEQ_IDX + 0] - '0') * 10;
-        theirSeq += (data[SEQ_IDX + 1] - '0');
-
-        // Check it against the last known sequence number
-        if(theirSeq == p2p->cnc.lastSeqNum)
+        case P2P_MSG_ACK:
         {
-            ESP_LOGD("P2P", "DISCARD: Duplicate sequence number");
+            // ACKs can be received in any state
+            uint32_t selectiveAcks = 0;
+            if(payloadLen >= sizeof(selectiveAcks))
+            {
+                memcpy(&selectiveAcks, payload, sizeof(selectiveAcks));
+            }
+            p2pRecvAck(p2p, hdr->seqNum, selectiveAcks);
             return;
         }
-        else
+        case P2P_MSG_CON:
         {
-            p2p->cnc.lastSeqNum = theirSeq;
-            ESP_LOGD("P2P", "Store lastSeqNum %d", p2p->cnc.lastSeqNum);
-        }
-    }
-
-    // Check if this is an ACK
-    bool isAck = strlen(p2p->ackMsg) == len &&
-                0 == memcmp(data, p2p->ackMsg, SEQ_IDX);
-
-    // ACKs can be received in any state
-    if(p2p->ack.isWaitingForAck && isAck)
-    {
-        ESP_LOGD("P2P", "ACK Received when waiting for one");
-
-        // Save the function pointer to call it after clearing ACK vars
-        void (*tmpSuccessFn)(void*) = p2p->ack.SuccessFn;
-
-        // Clear ack timeout variables
-        esp_timer_stop(p2p->tmr.TxRetry);
-        // Disarm the whole transmission ack timer
-        esp_timer_stop(p2p->tmr.TxAllRetries);
-        // Clear out ACK variables
-        memset(&p2p->ack, 0, sizeof(p2p->ack));
+            // Received another broadcast, Check if this RSSI is strong enough
+            if(!p2p->cnc.isConnected &&
+                    !p2p->cnc.broadcastReceived &&
+                    rssi > p2p->connectionRssi)
+            {
+                // We received a broadcast, don't allow another
+                p2p->cnc.broadcastReceived = true;
 
-        p2p->ack.isWaitingForAck = false;
+                // Save the other ESP's MAC
+                memcpy(p2p->cnc.otherMac, mac_addr, sizeof(p2p->cnc.otherMac));
+                p2p->cnc.otherMacReceived = true;
 
-        // Call the callback after clearing out variables
-        if(NULL != tmpSuccessFn)
-        { 
-            tmpSuccessFn(p2p);
+                // Send a message to that ESP to start the game. If it's acked,
+                // call p2pGameStartAckRecv(), if not reinit with p2pRestart()
+                p2pSendMsgEx(p2p, P2P_MSG_STR, NULL, 0, p2pStartMsgTxCbFn);
+            }
+            return;
+        }
+        default:
+        {
+            break;
         }
-
-        // Ack handled
-        return;
     }
-    else if(p2p->ack.isWaitingForAck || isAck)
+
+    // Until the connection is established, only the start message is
+    // accepted. Mode messages aren't ACKed, so they'll be retried
+    if(!p2p->cnc.isConnected && P2P_MSG_STR != hdr->msgType)
     {
-        // Don't process anything else when waiting for or receiving an ack
+        ESP_LOGD("P2P", "DISCARD: Not connected yet");
         return;
     }
 
-    if(false == p2p->cnc.isConnected)
+    // Signed, so sequence numbers can wrap around
+    int16_t offset = (int16_t)(hdr->seqNum - p2p->rx.baseSeqNum);
+    if(offset < 0)
     {
-        // Received another broadcast, Check if this RSSI is strong enough
-        if(!p2p->cnc.broadcastReceived &&
-                rssi > p2p->connectionRssi &&
-                strlen(p2p->conMsg) == len &&
-                0 == memcmp(data, p2p->conMsg, len))
+        // Already handed to the mode, the ACK must have been lost
+        ESP_LOGD("P2P", "DISCARD: Old sequence number %u", hdr->seqNum);
+    }
+    else
+    {
+        if(offset >= P2P_WINDOW_SIZE)
         {
+            // The other Swadge can only send this after giving up on the
+            // messages more than a window before it, so stop waiting for them
+            p2pAdvanceRxWindow(p2p, mac_addr, hdr->seqNum - (P2P_WINDOW_SIZE - 1));
+        }
 
-            // We received a broadcast, don't allow another
-            p2p->cnc.broadcastReceived = true;
+        p2pRxSlot_t* slot = &p2p->rx.slots[hdr->seqNum % P2P_WINDOW_SIZE];
+        if(slot->isReceived)
+        {
+            ESP_LOGD("P2P", "DISCARD: Duplicate sequence number %u", hdr->seqNum);
+        }
+        else
+        {
+            slot->isReceived = true;
+            slot->msgType = hdr->msgType;
+            slot->len = payloadLen;
+            memcpy(slot->payload, payload, payloadLen);
+        }
+    }
 
-            // Save the other ESP's MAC
-            memcpy(p2p->cnc.otherMac, mac_addr, sizeof(p2p->cnc.otherMac));
-            p2p->cnc.otherMacReceived = true;
+    // Ack it, even if it's a duplicate, in case the last ack was lost. Then
+    // hand any messages which are now in order to the mode
+    p2pAdvanceRxWindow(p2p, mac_addr, p2p->rx.baseSeqNum);
+}
 
-            // Send a message to that ESP to start the game.
-            snprintf(p2p->startMsg, sizeof(p2p->startMsg), p2pNoPayloadMsgFmt,
-                     p2p->msgId,
-                     "str",
-                     0,
-                     mac_addr[0],
-                     mac_addr[1],
-                     mac_addr[2],
-                     mac_addr[3],
-                     mac_addr[4],
-                     mac_addr[5]);
+/**
+ * Slide the receive window up to seqNum, skipping messages which never
+ * arrived, then past every message which has. ACK the new window, then hand
+ * the messages passed over to the mode in order
+ *
+ * @param p2p      The p2pInfo struct with all the state information
+ * @param mac_addr The MAC of the swadge that sent the messages
+ * @param seqNum   The sequence number to slide the window up to, at least
+ */
+void p2pAdvanceRxWindow(p2pInfo* p2p, const uint8_t* mac_addr, uint16_t seqNum)
+{
+    // Messages are copied out first, because the mode may send more
+    p2pRxSlot_t inOrder[P2P_WINDOW_SIZE];
+    uint8_t numInOrder = 0;
 
-            // If it's acked, call p2pGameStartAckRecv(), if not reinit with p2pRestart()
-            p2pSendMsgEx(p2p, p2p->startMsg, strlen(p2p->startMsg) + 1, true, p2pGameStartAckRecv, p2pRestart);
+    while(true)
+    {
+        p2pRxSlot_t* slot = &p2p->rx.slots[p2p->rx.baseSeqNum % P2P_WINDOW_SIZE];
+        if(slot->isReceived)
+        {
+            inOrder[numInOrder++] = *slot;
+            slot->isReceived = false;
         }
-        // Received a response to our broadcast
-        else if (!p2p->cnc.rxGameStartMsg &&
-                 strlen(p2p->startMsg) == len &&
-                 0 == memcmp(data, p2p->startMsg, SEQ_IDX))
+        else if((int16_t)(seqNum - p2p->rx.baseSeqNum) > 0)
         {
-            ESP_LOGD("P2P", "Game start message received, ACKing");
-
-            // This is another swadge trying to start a game, which means
-            // they received our p2p->conMsg. First disable our p2p->conMsg
-            esp_timer_stop(p2p->tmr.Connection);
-
-            // And process this connection event
-            p2pProcConnectionEvt(p2p, RX_GAME_START_MSG);
+            ESP_LOGD("P2P", "Skipping lost message %u", p2p->rx.baseSeqNum);
         }
-        return;
+        else
+        {
+            break;
+        }
+        p2p->rx.baseSeqNum++;
     }
-    else if(len >= EXT_IDX)
+
+    p2pSendAckToMac(p2p, mac_addr);
+
+    for(uint8_t i = 0; i < numInOrder; i++)
     {
-        ESP_LOGD("P2P", "cnc.isconnected is true");
-        // Let the mode handle it
-        if(NULL != p2p->msgRxCbFn)
+        if(false == p2p->cnc.isConnected)
         {
-            ESP_LOGD("P2P", "letting mode handle message");
+            // Received a response to our broadcast
+            if (P2P_MSG_STR == inOrder[i].msgType && !p2p->cnc.rxGameStartMsg)
+            {
+                ESP_LOGD("P2P", "Game start message received, ACKing");
 
-            // Null terminate the message type
-            char ntMsgType[4];
-            ntMsgType[0] = data[CMD_IDX];
-            ntMsgType[1] = data[CMD_IDX + 1];
-            ntMsgType[2] = data[CMD_IDX + 2];
-            ntMsgType[3] = 0;
+                // This is another swadge trying to start a game, which means
+                // they received our broadcast. First disable our broadcasts
+                esp_timer_stop(p2p->tmr.Connection);
 
-            // Call the callback
-            p2p->msgRxCbFn(p2p, ntMsgType, &data[EXT_IDX], len - EXT_IDX + 1);
+                // And process this connection event
+                p2pProcConnectionEvt(p2p, RX_GAME_START_MSG);
+            }
+        }
+        else if(P2P_MSG_STR != inOrder[i].msgType && NULL != p2p->msgRxCbFn)
+        {
+            // Let the mode handle it
+            ESP_LOGD("P2P", "letting mode handle message");
+            p2p->msgRxCbFn(p2p, inOrder[i].msgType, inOrder[i].payload, inOrder[i].len);
         }
     }
 }
 
 /**
- * Helper function to send an ACK message to the given MAC
+ * Helper function to send an ACK message to the given MAC. It ACKs every
+ * message before p2p->rx.baseSeqNum, and selectively ACKs the ones after it
+ * which have arrived
  *
  * @param p2p      The p2pInfo struct with all the state information
  * @param mac_addr The MAC to address this ACK to
@@ -670,21 +852,41 @@ void p2pSendAckToMac(p2pInfo* p2p, const uint8_t* mac_addr)
 {
     ESP_LOGD("P2P", "%s", __func__);
 
-    snprintf(p2p->ackMsg, sizeof(p2p->ackMsg), p2pNoPayloadMsgFmt,
-             p2p->msgId,
-             "ack",
-             0,
-             mac_addr[0],
-             mac_addr[1],
-             mac_addr[2],
-             mac_addr[3],
-             mac_addr[4],
-             mac_addr[5]);
-    p2pSendMsgEx(p2p, p2p->ackMsg, strlen(p2p->ackMsg) + 1, false, NULL, NULL);
+    uint32_t selectiveAcks = 0;
+    for(uint8_t i = 0; i < P2P_WINDOW_SIZE - 1; i++)
+    {
+        if(p2p->rx.slots[(uint16_t)(p2p->rx.baseSeqNum + 1 + i) % P2P_WINDOW_SIZE].isReceived)
+        {
+            selectiveAcks |= (1u << i);
+        }
+    }
+
+    uint8_t ackMsg[sizeof(p2pHeader_t) + sizeof(selectiveAcks)];
+    uint8_t len = p2pBuildMsg(p2p, ackMsg, P2P_MSG_ACK, p2p->rx.baseSeqNum, mac_addr,
+                              (const uint8_t*)&selectiveAcks, sizeof(selectiveAcks));
+    espNowSend((const char*)ackMsg, len);
+}
+
+/**
+ * Callback function for when the start message is ACKed or dropped
+ *
+ * @param p2p    The p2pInfo struct with all the state information
+ * @param status Whether the start message was ACKed
+ */
+void p2pStartMsgTxCbFn(p2pInfo* p2p, messageStatus_t status)
+{
+    if(MSG_ACKED == status)
+    {
+        p2pGameStartAckRecv(p2p);
+    }
+    else
+    {
+        p2pRestart(p2p);
+    }
 }
 
 /**
- * This is called when p2p->startMsg is acked and processes the connection event
+ * This is called when the start message is acked and processes the connection event
  *
  * @param arg The p2pInfo struct with all the state information
  */
@@ -700,7 +902,7 @@ void p2pGameStartAckRecv(void* arg)
  * Two steps are necessary to establish a connection in no particular order.
  * 1. This swadge has to receive a start message from another swadge
  * 2. This swadge has to receive an ack to a start message sent to another swadge
- * The order of events determines who is the 'client' and who is the 'server'
+ * Once both have happened, the Swadge with the lower MAC goes first
  *
  * @param p2p   The p2pInfo struct with all the state information
  * @param event The event that occurred
@@ -714,22 +916,12 @@ void p2pProcConnectionEvt(p2pInfo* p2p, connectionEvt_t event)
     {
         case RX_GAME_START_MSG:
         {
-            // Already received the ack, become the client
-            if(!p2p->cnc.rxGameStartMsg && p2p->cnc.rxGameStartAck)
-            {
-                p2p->cnc.playOrder = GOING_SECOND;
-            }
             // Mark this event
             p2p->cnc.rxGameStartMsg = true;
             break;
         }
         case RX_GAME_START_ACK:
         {
-            // Already received the msg, become the server
-            if(!p2p->cnc.rxGameStartAck && p2p->cnc.rxGameStartMsg)
-            {
-                p2p->cnc.playOrder = GOING_FIRST;
-            }
             // Mark this event
             p2p->cnc.rxGameStartAck = true;
             break;
@@ -756,6 +948,18 @@ void p2pProcConnectionEvt(p2pInfo* p2p, connectionEvt_t event)
 
         p2p->cnc.isConnected = true;
 
+        // The order of events can't decide who goes first. When both start
+        // messages cross in flight, each Swadge receives the other's start
+        // message before the ACK to its own. Both Swadges agree on the MACs
+        if(0 > memcmp(p2p->cnc.myMac, p2p->cnc.otherMac, sizeof(p2p->cnc.myMac)))
+        {
+            p2p->cnc.playOrder = GOING_FIRST;
+        }
+        else
+        {
+            p2p->cnc.playOrder = GOING_SECOND;
+        }
+
         // tell the mode it's connected
         if(NULL != p2p->conCbFn)
         {
@@ -786,8 +990,9 @@ void p2pStartRestartTimer(void* arg)
 }
 
 /**
- * Restart by deiniting then initing. Persist the msgId and p2p->conCbFn
- * fields
+ * Restart by resetting all the state. Persist the msgId and p2p->conCbFn
+ * fields. This is called from tmr.Reinit, so the timers are stopped and kept
+ * rather than deleted and created again
  *
  * @param arg The p2pInfo struct with all the state information
  */
@@ -802,19 +1007,30 @@ void p2pRestart(void* arg)
         p2p->conCbFn(p2p, CON_LOST);
     }
 
+    esp_timer_stop(p2p->tmr.Connection);
+    esp_timer_stop(p2p->tmr.TxRetry);
+    esp_timer_stop(p2p->tmr.Reinit);
+    esp_timer_handle_t txRetry = p2p->tmr.TxRetry;
+    esp_timer_handle_t connection = p2p->tmr.Connection;
+    esp_timer_handle_t reinit = p2p->tmr.Reinit;
+
     char msgId[4] = {0};
     strncpy(msgId, p2p->msgId, sizeof(msgId));
-    p2pDeinit(p2p);
-    p2pInitialize(p2p, msgId, p2p->conCbFn, p2p->msgRxCbFn, p2p->connectionRssi);
+    p2pResetState(p2p, msgId, p2p->conCbFn, p2p->msgRxCbFn, p2p->connectionRssi);
+
+    p2p->tmr.TxRetry = txRetry;
+    p2p->tmr.Connection = connection;
+    p2p->tmr.Reinit = reinit;
 }
 
 /**
  * This must be called by whatever function is registered to the Swadge mode's
  * fnEspNowSendCb
  *
- * This is called after an attempted transmission. If it was successful, and the
- * message should be acked, start a retry timer. If it wasn't successful, just
- * try again
+ * This is called after an attempted transmission. Retry times are set when
+ * messages are sent, so this only needs to handle failures. If the
+ * transmission wasn't successful, try the oldest message waiting for an ACK
+ * again soon
  *
  * @param p2p      The p2pInfo struct with all the state information
  * @param mac_addr unused
@@ -829,35 +1045,18 @@ void p2pSendCb(p2pInfo* p2p, const uint8_t* mac_addr __attribute__((unused)),
     {
         case ESP_NOW_SEND_SUCCESS:
         {
-            if(0 != p2p->ack.timeSentUs)
-            {
-                uint32_t transmissionTimeUs = esp_timer_get_time() - p2p->ack.timeSentUs;
-                ESP_LOGD("P2P", "Transmission time %dus", transmissionTimeUs);
-                // The timers are all millisecond, so make sure that
-                // transmissionTimeUs is at least 1ms
-                if(transmissionTimeUs < 1000)
-                {
-                    transmissionTimeUs = 1000;
-                }
-
-                // Round it to the nearest Ms, add 69ms (the measured worst case)
-                // then add some randomness [0ms to 15ms random]
-                uint32_t waitTimeUs = 1000 * (((transmissionTimeUs + 500) / 1000) + 69 + (esp_random() & 0b1111));
-
-                // Start the timer
-                ESP_LOGD("P2P", "ack timer set for %dus", waitTimeUs);
-                esp_timer_start_once(p2p->tmr.TxRetry, waitTimeUs);
-            }
             break;
         }
         default:
         case ESP_NOW_SEND_FAIL:
         {
-            // If a message is stored
-            if(p2p->ack.msgToAckLen > 0)
+            // If a message is waiting for an ACK
+            p2pTxSlot_t* slot = &p2p->tx.slots[p2p->tx.baseSeqNum % P2P_WINDOW_SIZE];
+            if(p2p->tx.baseSeqNum != p2p->tx.nextSeqNum && slot->inUse)
             {
                 // try again in 1ms
-                esp_timer_start_once(p2p->tmr.TxRetry, 1000);
+                slot->retryUs = esp_timer_get_time() + 1000;
+                p2pStartTxRetryTimer(p2p);
             }
             break;
         }
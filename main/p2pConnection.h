@@ -10,6 +10,39 @@
 
 #define P2P_MAX_MSG_LEN 64
 
+/*
+ * Up to this many acked messages can be in flight at once. Each is retried on
+ * its own until it's acked. The receiver buffers messages which arrive early
+ * and hands them to the mode in order
+ */
+#define P2P_WINDOW_SIZE 8
+
+/*
+ * Every p2p message starts with this header, followed by the payload, if any.
+ * Integers are little-endian, like both the Swadge and the emulator.
+ *
+ * An ACK's seqNum is the next sequence number its sender expects, which acks
+ * every message before it. Its payload is a uint32_t where bit i acks the
+ * message seqNum + 1 + i, which arrived before the messages ahead of it
+ */
+typedef struct __attribute__((packed))
+{
+    char modeId[3];    ///< The mode's message ID, not NULL terminated
+    uint8_t msgType;   ///< A p2pMsgType_t, or a mode's own message type
+    uint16_t seqNum;   ///< For ACKs, the next sequence number expected
+    uint8_t dstMac[6]; ///< All 0xFF for broadcasts
+} p2pHeader_t;
+
+#define P2P_MAX_DATA_LEN (P2P_MAX_MSG_LEN - sizeof(p2pHeader_t))
+
+/* Message types which p2p uses itself. Modes can use any value below these */
+typedef enum
+{
+    P2P_MSG_CON = 0xFD, ///< A broadcast looking for another Swadge
+    P2P_MSG_STR = 0xFE, ///< A request to start a connection
+    P2P_MSG_ACK = 0xFF, ///< An acknowledgement of a message
+} p2pMsgType_t;
+
 typedef enum
 {
     NOT_SET,
@@ -35,35 +68,75 @@ typedef enum
 typedef struct _p2pInfo p2pInfo;
 
 typedef void (*p2pConCbFn)(p2pInfo* p2p, connectionEvt_t);
-typedef void (*p2pMsgRxCbFn)(p2pInfo* p2p, const char* msg, const char* payload, uint8_t len);
+typedef void (*p2pMsgRxCbFn)(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload, uint8_t len);
 typedef void (*p2pMsgTxCbFn)(p2pInfo* p2p, messageStatus_t status);
 
+// A message which has been sent and is waiting for an ACK
+typedef struct
+{
+    bool inUse;
+    uint8_t msg[P2P_MAX_MSG_LEN];
+    uint8_t len;
+    int64_t firstSentUs; ///< When the message was first sent
+    int64_t lastSentUs;  ///< When the message was last sent
+    int64_t retryUs;     ///< When the message is sent again if it isn't acked
+    bool isRetransmitted; ///< Retransmitted messages aren't used to measure RTT
+    p2pMsgTxCbFn msgTxCbFn;
+} p2pTxSlot_t;
+
+// Statistics about the connection, reset when p2p is initialized
+typedef struct
+{
+    uint32_t srttUs;      ///< The smoothed round trip time, 0 until measured
+    uint32_t rttVarUs;    ///< The round trip time variation
+    uint32_t rtoUs;       ///< The retransmission timeout, including backoff
+    uint32_t rttSamples;  ///< The number of round trip times measured
+    uint32_t msgsSent;    ///< Messages sent for the first time
+    uint32_t retransmits; ///< Messages sent again because they weren't acked
+    uint32_t msgsAcked;
+    uint32_t msgsFailed;  ///< Messages given up on after RETRY_TIME_US
+    uint8_t lossPct;      ///< The percentage of transmissions which were retransmits
+} p2pStats_t;
+
+// A message which arrived before the ones ahead of it
+typedef struct
+{
+    bool isReceived;
+    uint8_t msgType;
+    uint8_t len;
+    uint8_t payload[P2P_MAX_DATA_LEN];
+} p2pRxSlot_t;
+
 // Variables to track acking messages
 typedef struct _p2pInfo
 {
-    // Messages that every mode uses
+    // The three character message ID, NULL terminated
     char msgId[4];
-    char conMsg[8];
-    char ackMsg[32];
-    char startMsg[32];
 
     // Callback function pointers
     p2pConCbFn conCbFn;
     p2pMsgRxCbFn msgRxCbFn;
-    p2pMsgTxCbFn msgTxCbFn;
 
     int8_t connectionRssi;
 
-    // Variables used for acking and retrying messages
+    // Variables used for acking and retrying messages, indexed by
+    // sequence number modulo P2P_WINDOW_SIZE
     struct
     {
-        bool isWaitingForAck;
-        char msgToAck[P2P_MAX_MSG_LEN];
-        uint16_t msgToAckLen;
-        uint32_t timeSentUs;
-        void (*SuccessFn)(void*);
-        void (*FailureFn)(void*);
-    } ack;
+        uint16_t baseSeqNum; ///< The oldest message which isn't acked yet
+        uint16_t nextSeqNum; ///< The sequence number of the next message sent
+        p2pTxSlot_t slots[P2P_WINDOW_SIZE];
+    } tx;
+
+    // Variables used for receiving messages in order, indexed by sequence
+    // number modulo P2P_WINDOW_SIZE
+    struct
+    {
+        uint16_t baseSeqNum; ///< The next message to hand to the mode
+        p2pRxSlot_t slots[P2P_WINDOW_SIZE];
+    } rx;
+
+    p2pStats_t stats;
 
     // Connection state variables
     struct
@@ -73,18 +146,15 @@ typedef struct _p2pInfo
         bool rxGameStartMsg;
         bool rxGameStartAck;
         playOrder_t playOrder;
-        char macStr[18];
+        uint8_t myMac[6];
         uint8_t otherMac[6];
         bool otherMacReceived;
-        uint8_t mySeqNum;
-        uint8_t lastSeqNum;
     } cnc;
 
     // The timers used for connection and acking
     struct
     {
         esp_timer_handle_t TxRetry;
-        esp_timer_handle_t TxAllRetries;
         esp_timer_handle_t Connection;
         esp_timer_handle_t Reinit;
     } tmr;
@@ -107,7 +177,7 @@ void p2pDeinit(p2pInfo* p2p);
 
 void p2pStartConnection(p2pInfo* p2p);
 
-void p2pSendMsg(p2pInfo* p2p, const char* msg, const char* payload, uint16_t len, p2pMsgTxCbFn msgTxCbFn);
+bool p2pSendMsg(p2pInfo* p2p, uint8_t msgType, const uint8_t* payload, uint8_t len, p2pMsgTxCbFn msgTxCbFn);
 void p2pSendCb(p2pInfo* p2p, const uint8_t* mac_addr, esp_now_send_status_t status);
 void p2pRecvCb(p2pInfo* p2p, const uint8_t* mac_addr, const char* data, uint8_t len, int8_t rssi);
 
@@ -9,6 +9,7 @@
 #include "btn.h"
 #include "touch_sensor.h"
 #include "display.h"
+#include "arena.h"
 
 #define NUM_LEDS 6
 
@@ -35,10 +36,13 @@ typedef struct _swadgeMode
      * This function is called when this mode is started. It should initialize
      * any necessary variables.
      * disp should be saved and used for later draw calls.
+     * Memory allocated from arena doesn't need to be freed. All of it is freed
+     * at once after fnExitMode() returns.
      * 
      * @param disp The display to draw to
+     * @param arena Memory for this mode, which lasts until the mode exits
      */
-    void (*fnEnterMode)(display_t * disp);
+    void (*fnEnterMode)(display_t * disp, arena_t * arena);
 
     /**
      * This function is called when the mode is exited. It should clean up
@@ -124,10 +128,36 @@ typedef struct _swadgeMode
      * @param status   The status of the transmission
      */
     void (*fnEspNowSendCb)(const uint8_t* mac_addr, esp_now_send_status_t status);
+
+    /**
+     * This function is called when it's time to draw a frame, frameRate times
+     * per second. The display is flushed as soon as it returns, so everything
+     * drawn here is shown. Modes which draw in fnMainLoop() instead may draw
+     * frames which are never shown.
+     *
+     * @param elapsedUs The time elapsed since the last frame
+     */
+    void (*fnFrameCallback)(int64_t elapsedUs);
+
+    /**
+     * This is a setting, not a function pointer. The number of frames per
+     * second to draw and flush, or 0 for DEFAULT_FRAME_RATE. It can be changed
+     * while the mode runs with setFrameRate()
+     */
+    uint16_t frameRate;
 } swadgeMode;
 
+typedef struct
+{
+    uint32_t switches;        ///< Modes switched since boot
+    int64_t lastUs;           ///< How long the last switch took
+    int64_t lastPeripheralUs; ///< How much of the last switch was spent on peripherals
+    int64_t maxUs;            ///< The longest a switch has taken
+} modeSwitchStats_t;
+
 uint8_t getNumSwadgeModes(void);
 void overrideToSwadgeMode( swadgeMode* mode );
 void switchToSwadgeMode(uint8_t mode);
+void getModeSwitchStats(modeSwitchStats_t * stats);
 
 #endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <unistd.h>
+#include <stdint.h>
 
 #include "sdkconfig.h"
 
@@ -15,7 +16,6 @@
 #include "esp_timer.h"
 #include "esp_efuse.h"
 #include "esp_log.h"
-#include "esp_sleep.h"
 
 #include "swadge_esp32.h"
 
@@ -43,6 +43,8 @@
 #include "p2pConnection.h"
 
 #include "display.h"
+#include "frame_scheduler.h"
+#include "profiler.h"
 
 #include "advanced_usb_control.h"
 
@@ -61,11 +63,62 @@
 #include "hal/memprot_ll.h"
 #endif
 
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* How often the main loop's polled sources run. Buttons, touch, and ESP-NOW
+ * notify the main task instead, so they're handled as soon as they arrive */
+#define MAIN_LOOP_PERIOD_US       5000
+#define ACCEL_PERIOD_US          10000
+#define AUDIO_PERIOD_US          10000
+#define TEMPERATURE_PERIOD_US  1000000
+
+//==============================================================================
+// Enums
+//==============================================================================
+
+typedef enum
+{
+    SRC_ESP_NOW,
+    SRC_INPUT,
+    SRC_ACCEL,
+    SRC_TEMPERATURE,
+    SRC_AUDIO,
+    SRC_MAIN_LOOP,
+    NUM_LOOP_SOURCES
+} loopSourceIdx_t;
+
+typedef enum
+{
+    PERIPH_MIC,
+    PERIPH_ACCEL,
+    PERIPH_ESP_NOW,
+    NUM_PERIPHERALS
+} peripheral_t;
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+typedef struct
+{
+    int64_t periodUs; ///< How often the source runs, or 0 to run it whenever the main task wakes
+    int64_t tNextUs;  ///< When the source is next due, or INT64_MAX if the mode doesn't use it
+} loopSource_t;
+
 //==============================================================================
 // Function Prototypes
 //==============================================================================
 
 void mainSwadgeTask(void * arg);
+static void resetLoopSources(void);
+static bool isLoopSourceDue(loopSourceIdx_t src, int64_t tNowUs);
+static void waitForLoopEvent(void);
+static void acquirePeripheral(peripheral_t periph);
+static void releasePeripheral(peripheral_t periph);
+static void acquireModePeripherals(const swadgeMode * mode);
+static void releaseModePeripherals(const swadgeMode * mode);
 void swadgeModeEspNowRecvCb(const uint8_t* mac_addr, const char* data, 
     uint8_t len, int8_t rssi);
 void swadgeModeEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t status);
@@ -83,9 +136,38 @@ swadgeMode* swadgeModes[] =
     0,
 };
 
-static RTC_DATA_ATTR uint8_t pendingSwadgeModeIdx = 0;
+static uint8_t pendingSwadgeModeIdx = 0;
 static uint8_t swadgeModeIdx = 0;
 static bool shouldSwitchSwadgeMode = false;
+static modeSwitchStats_t modeSwitchStats = {0};
+
+// Memory for the current mode, all of which is freed when the mode exits
+static arena_t modeArena = {0};
+
+// The number of modes using each peripheral. Peripherals are brought up when
+// the first user acquires them and torn down when the last one releases them
+static uint8_t peripheralRefs[NUM_PERIPHERALS] = {0};
+static bool accelInitialized = false;
+
+// Everything the main loop services, and when
+static loopSource_t loopSources[NUM_LOOP_SOURCES] =
+{
+    [SRC_ESP_NOW]     = {.periodUs = 0},
+    [SRC_INPUT]       = {.periodUs = 0},
+    [SRC_ACCEL]       = {.periodUs = ACCEL_PERIOD_US},
+    [SRC_TEMPERATURE] = {.periodUs = TEMPERATURE_PERIOD_US},
+    [SRC_AUDIO]       = {.periodUs = AUDIO_PERIOD_US},
+    [SRC_MAIN_LOOP]   = {.periodUs = MAIN_LOOP_PERIOD_US},
+};
+
+// Where the main loop's time goes
+PROFILE_SCOPE(profEspNow, "espnow");
+PROFILE_SCOPE(profSensors, "sensors");
+PROFILE_SCOPE(profInput, "input");
+PROFILE_SCOPE(profAudio, "audio");
+PROFILE_SCOPE(profMainLoop, "mainLoop");
+PROFILE_SCOPE(profDraw, "draw");
+PROFILE_SCOPE(profFlush, "flush");
 
 //==============================================================================
 // Functions
@@ -116,6 +198,208 @@ void swadgeModeEspNowSendCb(const uint8_t* mac_addr, esp_now_send_status_t statu
     }
 }
 
+/**
+ * @brief Schedule the main loop's polled sources for the current mode. Sources
+ * the mode doesn't use are never due, so they don't wake the main loop
+ */
+static void resetLoopSources(void)
+{
+    swadgeMode * mode = swadgeModes[swadgeModeIdx];
+    bool used[NUM_LOOP_SOURCES] =
+    {
+        [SRC_ACCEL]       = accelInitialized && (NULL != mode->fnAccelerometerCallback),
+        [SRC_TEMPERATURE] = (NULL != mode->fnTemperatureCallback),
+        [SRC_AUDIO]       = (NULL != mode->fnAudioCallback),
+        // Always run, for the buzzer and the emulator's timers
+        [SRC_MAIN_LOOP]   = true,
+    };
+
+    int64_t tNowUs = esp_timer_get_time();
+    for(uint8_t i = 0; i < NUM_LOOP_SOURCES; i++)
+    {
+        loopSources[i].tNextUs = used[i] ? tNowUs : INT64_MAX;
+    }
+}
+
+/**
+ * @brief Check if a main loop source should run now. Event sources run every
+ * time the main loop wakes. Polled sources run on a fixed period, and periods
+ * which pass entirely while the loop is busy are skipped
+ *
+ * @param src The source to check
+ * @param tNowUs The current time, in microseconds
+ * @return true if the source should run, false if it shouldn't
+ */
+static bool isLoopSourceDue(loopSourceIdx_t src, int64_t tNowUs)
+{
+    loopSource_t * source = &loopSources[src];
+    if(0 == source->periodUs)
+    {
+        return true;
+    }
+    if(tNowUs < source->tNextUs)
+    {
+        return false;
+    }
+    source->tNextUs += (((tNowUs - source->tNextUs) / source->periodUs) + 1) * source->periodUs;
+    return true;
+}
+
+/**
+ * @brief Block the main task until the next polled source or frame is due, or
+ * until an event source notifies it
+ */
+static void waitForLoopEvent(void)
+{
+    int64_t tWakeUs = getNextFrameTime();
+    for(uint8_t i = 0; i < NUM_LOOP_SOURCES; i++)
+    {
+        if((0 != loopSources[i].periodUs) && (loopSources[i].tNextUs < tWakeUs))
+        {
+            tWakeUs = loopSources[i].tNextUs;
+        }
+    }
+
+    int64_t tWaitUs = tWakeUs - esp_timer_get_time();
+    if(0 < tWaitUs)
+    {
+        // Round up to whole ticks so the wait doesn't end just before the deadline
+        const int64_t usPerTick = portTICK_PERIOD_MS * 1000;
+        ulTaskNotifyTake(pdTRUE, (TickType_t)((tWaitUs + usPerTick - 1) / usPerTick));
+    }
+}
+
+/**
+ * @brief Take a reference to a peripheral, initializing it if nothing was
+ * using it
+ *
+ * @param periph The peripheral to acquire
+ */
+static void acquirePeripheral(peripheral_t periph)
+{
+    if(0 < peripheralRefs[periph]++)
+    {
+        return;
+    }
+
+    switch(periph)
+    {
+        case PERIPH_MIC:
+        {
+            /* Since the ADC2 is shared with the WIFI module, which has higher
+             * priority, reading operation of adc2_get_raw() will fail between
+             * esp_wifi_start() and esp_wifi_stop(). Use the return code to see
+             * whether the reading is successful.
+             */
+            static uint16_t adc1_chan_mask = BIT(2);
+            static uint16_t adc2_chan_mask = 0;
+            static adc_channel_t channel[] = {ADC1_CHANNEL_7}; // GPIO_NUM_8
+            continuous_adc_init(adc1_chan_mask, adc2_chan_mask, channel, sizeof(channel) / sizeof(adc_channel_t));
+            continuous_adc_start();
+            break;
+        }
+        case PERIPH_ACCEL:
+        {
+            /* Initialize i2c peripherals */
+            i2c_master_init(
+                GPIO_NUM_17, // SDA
+                GPIO_NUM_18, // SCL
+                GPIO_PULLUP_DISABLE, 1000000);
+            accelInitialized = QMA6981_setup();
+            break;
+        }
+        case PERIPH_ESP_NOW:
+        {
+            espNowInit(&swadgeModeEspNowRecvCb, &swadgeModeEspNowSendCb);
+            break;
+        }
+        case NUM_PERIPHERALS:
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Drop a reference to a peripheral, deinitializing it if nothing else is
+ * using it
+ *
+ * @param periph The peripheral to release
+ */
+static void releasePeripheral(peripheral_t periph)
+{
+    if(0 < --peripheralRefs[periph])
+    {
+        return;
+    }
+
+    switch(periph)
+    {
+        case PERIPH_MIC:
+        {
+            continuous_adc_deinit();
+            break;
+        }
+        case PERIPH_ACCEL:
+        {
+            i2c_master_deinit();
+            accelInitialized = false;
+            break;
+        }
+        case PERIPH_ESP_NOW:
+        {
+            espNowDeinit();
+            break;
+        }
+        case NUM_PERIPHERALS:
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Acquire every peripheral a mode uses
+ *
+ * @param mode The mode to acquire peripherals for
+ */
+static void acquireModePeripherals(const swadgeMode * mode)
+{
+    if(NULL != mode->fnAudioCallback)
+    {
+        acquirePeripheral(PERIPH_MIC);
+    }
+    if(NULL != mode->fnAccelerometerCallback)
+    {
+        acquirePeripheral(PERIPH_ACCEL);
+    }
+    if(ESP_NOW == mode->wifiMode)
+    {
+        acquirePeripheral(PERIPH_ESP_NOW);
+    }
+}
+
+/**
+ * @brief Release every peripheral a mode uses
+ *
+ * @param mode The mode to release peripherals for
+ */
+static void releaseModePeripherals(const swadgeMode * mode)
+{
+    if(NULL != mode->fnAudioCallback)
+    {
+        releasePeripheral(PERIPH_MIC);
+    }
+    if(NULL != mode->fnAccelerometerCallback)
+    {
+        releasePeripheral(PERIPH_ACCEL);
+    }
+    if(ESP_NOW == mode->wifiMode)
+    {
+        releasePeripheral(PERIPH_ESP_NOW);
+    }
+}
+
 /**
  * Invoked when received GET_REPORT control request
  * Application must fill buffer report's content and return its length.
@@ -264,25 +548,6 @@ void app_main(void)
  */
 void mainSwadgeTask(void * arg __attribute((unused)))
 {
-#if !defined(EMU)
-    /* Check why this ESP woke up */
-    switch (esp_sleep_get_wakeup_cause())
-    {
-        case ESP_SLEEP_WAKEUP_TIMER:
-        {
-            /* Use the pending mode */
-            swadgeModeIdx = pendingSwadgeModeIdx;
-            break;
-        }
-        default:
-        {
-            /* Reset swadgeModeIdx */
-            swadgeModeIdx = 0;
-            break;
-        }
-    }
-#endif
-
     /* Initialize internal NVS */
     initNvs(true);
 
@@ -313,35 +578,6 @@ void mainSwadgeTask(void * arg __attribute((unused)))
     initLeds(GPIO_NUM_39, RMT_CHANNEL_0, NUM_LEDS);
     buzzer_init(GPIO_NUM_40, RMT_CHANNEL_1);
 
-#if !defined(EMU)
-    if(NULL != swadgeModes[swadgeModeIdx]->fnAudioCallback)
-#endif
-    {
-        /* Since the ADC2 is shared with the WIFI module, which has higher
-         * priority, reading operation of adc2_get_raw() will fail between
-         * esp_wifi_start() and esp_wifi_stop(). Use the return code to see
-         * whether the reading is successful.
-         */
-        static uint16_t adc1_chan_mask = BIT(2);
-        static uint16_t adc2_chan_mask = 0;
-        static adc_channel_t channel[] = {ADC1_CHANNEL_7}; // GPIO_NUM_8
-        continuous_adc_init(adc1_chan_mask, adc2_chan_mask, channel, sizeof(channel) / sizeof(adc_channel_t));
-        continuous_adc_start();
-    }
-
-    bool accelInitialized = false;
-#if !defined(EMU)
-    if(NULL != swadgeModes[swadgeModeIdx]->fnAccelerometerCallback)
-#endif
-    {
-        /* Initialize i2c peripherals */
-        i2c_master_init(
-            GPIO_NUM_17, // SDA
-            GPIO_NUM_18, // SCL
-            GPIO_PULLUP_DISABLE, 1000000);
-        accelInitialized = QMA6981_setup();
-    }
-
 #ifdef OLED_ENABLED
     display_t oledDisp;
     initOLED(&oledDisp, true, GPIO_NUM_21);
@@ -357,25 +593,42 @@ void mainSwadgeTask(void * arg __attribute((unused)))
             GPIO_NUM_34, // cs
             GPIO_NUM_38, // rst
             GPIO_NUM_7); // backlight (dummy GPIO for now)
+#if defined(CONFIG_TFT_ASYNC_FLUSH)
+    setTftAsyncFlush(true);
+#endif
 
     /* Initialize USB peripheral */
     tinyusb_config_t tusb_cfg = {};
     tinyusb_driver_install(&tusb_cfg);
 
-    /* Initialize Wifi peripheral */
-#if !defined(EMU)
-    if(ESP_NOW == swadgeModes[swadgeModeIdx]->wifiMode)
-#endif
+    /* Initialize the ADC, i2c, and Wifi peripherals the mode uses. The
+     * emulator's are cheap, so it holds a reference to all of them */
+#if defined(EMU)
+    for(uint8_t i = 0; i < NUM_PERIPHERALS; i++)
     {
-        espNowInit(&swadgeModeEspNowRecvCb, &swadgeModeEspNowSendCb);
+        acquirePeripheral(i);
     }
+#endif
+    acquireModePeripherals(swadgeModes[swadgeModeIdx]);
+
+    /* Wake the main loop when input arrives, rather than polling for it */
+    TaskHandle_t mainTask = xTaskGetCurrentTaskHandle();
+    setButtonNotifyTask(mainTask);
+    setTouchNotifyTask(mainTask);
+    setEspNowNotifyTask(mainTask);
 
     /* Enter the swadge mode */
+    initFrameScheduler(swadgeModes[swadgeModeIdx]->frameRate);
+    resetLoopSources();
     if(NULL != swadgeModes[swadgeModeIdx]->fnEnterMode)
     {
-        swadgeModes[swadgeModeIdx]->fnEnterMode(&tftDisp);
+        swadgeModes[swadgeModeIdx]->fnEnterMode(&tftDisp, &modeArena);
     }
 
+    // When the mode's event loop last ran. Reset when a mode is entered, so the
+    // first call doesn't include the previous mode's time or the switch
+    int64_t tLastCallUs = esp_timer_get_time();
+
     /* Loop forever! */
 #if defined(EMU)
     while(threadsShouldRun)
@@ -383,14 +636,19 @@ void mainSwadgeTask(void * arg __attribute((unused)))
     while(true)
 #endif
     {
+        int64_t tNowUs = esp_timer_get_time();
+
         // Process ESP NOW
-        if(ESP_NOW == swadgeModes[swadgeModeIdx]->wifiMode)
+        profileBegin(&profEspNow);
+        if((ESP_NOW == swadgeModes[swadgeModeIdx]->wifiMode) && isLoopSourceDue(SRC_ESP_NOW, tNowUs))
         {
             checkEspNowRxQueue();
         }
-        
+        profileEnd(&profEspNow);
+
         // Process Accelerometer
-        if(accelInitialized && NULL != swadgeModes[swadgeModeIdx]->fnAccelerometerCallback)
+        profileBegin(&profSensors);
+        if(isLoopSourceDue(SRC_ACCEL, tNowUs))
         {
             accel_t accel = {0};
             QMA6981_poll(&accel);
@@ -398,33 +656,39 @@ void mainSwadgeTask(void * arg __attribute((unused)))
         }
 
         // Process temperature sensor
-        if(NULL != swadgeModes[swadgeModeIdx]->fnTemperatureCallback)
+        if(isLoopSourceDue(SRC_TEMPERATURE, tNowUs))
         {
             swadgeModes[swadgeModeIdx]->fnTemperatureCallback(readTemperatureSensor());
         }
+        profileEnd(&profSensors);
 
-        // Process button presses
-        buttonEvt_t bEvt = {0};
-        if(checkButtonQueue(&bEvt))
+        // Process every queued button press and touch event
+        profileBegin(&profInput);
+        if(isLoopSourceDue(SRC_INPUT, tNowUs))
         {
-            if(NULL != swadgeModes[swadgeModeIdx]->fnButtonCallback)
+            buttonEvt_t bEvt = {0};
+            while(checkButtonQueue(&bEvt))
             {
-                swadgeModes[swadgeModeIdx]->fnButtonCallback(&bEvt);
+                if(NULL != swadgeModes[swadgeModeIdx]->fnButtonCallback)
+                {
+                    swadgeModes[swadgeModeIdx]->fnButtonCallback(&bEvt);
+                }
             }
-        }
 
-        // Process touch events
-        touch_event_t tEvt = {0};
-        if(checkTouchSensor(&tEvt))
-        {
-            if(NULL != swadgeModes[swadgeModeIdx]->fnTouchCallback)
+            touch_event_t tEvt = {0};
+            while(checkTouchSensor(&tEvt))
             {
-                swadgeModes[swadgeModeIdx]->fnTouchCallback(&tEvt);
+                if(NULL != swadgeModes[swadgeModeIdx]->fnTouchCallback)
+                {
+                    swadgeModes[swadgeModeIdx]->fnTouchCallback(&tEvt);
+                }
             }
         }
+        profileEnd(&profInput);
 
         // Process ADC samples
-        if(NULL != swadgeModes[swadgeModeIdx]->fnAudioCallback)
+        profileBegin(&profAudio);
+        if(isLoopSourceDue(SRC_AUDIO, tNowUs))
         {
             uint16_t adcSamps[BYTES_PER_READ / sizeof(adc_digi_output_data_t)];
             uint32_t sampleCnt = 0;
@@ -433,88 +697,123 @@ void mainSwadgeTask(void * arg __attribute((unused)))
                 swadgeModes[swadgeModeIdx]->fnAudioCallback(adcSamps, sampleCnt);
             }
         }
+        profileEnd(&profAudio);
 
         // Run the mode's event loop
-        static int64_t tLastCallUs = 0;
-        if(0 == tLastCallUs)
+        if(isLoopSourceDue(SRC_MAIN_LOOP, tNowUs))
         {
-            tLastCallUs = esp_timer_get_time();
-        }
-        else
-        {
-            int64_t tNowUs = esp_timer_get_time();
             int64_t tElapsedUs = tNowUs - tLastCallUs;
             tLastCallUs = tNowUs;
 
+            profileBegin(&profMainLoop);
             if(NULL != swadgeModes[swadgeModeIdx]->fnMainLoop)
             {
                 swadgeModes[swadgeModeIdx]->fnMainLoop(tElapsedUs);
             }
+            profileEnd(&profMainLoop);
 
 #if defined(EMU)
             check_esp_timer(tElapsedUs);
 #endif
         }
 
-        // Update outputs
+        // Draw and flush a frame when one is due, so nothing the mode draws in
+        // its frame callback is thrown away
+        int64_t tFrameElapsedUs = 0;
+        if(checkFrameDue(esp_timer_get_time(), &tFrameElapsedUs))
+        {
+            profileBegin(&profDraw);
+            if(NULL != swadgeModes[swadgeModeIdx]->fnFrameCallback)
+            {
+                swadgeModes[swadgeModeIdx]->fnFrameCallback(tFrameElapsedUs);
+            }
+            profileEnd(&profDraw);
+            drawProfileOverlay(&tftDisp);
+
+            profileBegin(&profFlush);
 #ifdef OLED_ENABLED
-        oledDisp.drawDisplay(true);
+            oledDisp.drawDisplay(true);
 #endif
-        tftDisp.drawDisplay(true);
+            tftDisp.drawDisplay(true);
+            profileEnd(&profFlush);
+            profileEndFrame();
+        }
+
+        // Update outputs
         buzzer_check_next_note();
 
         /* If the mode should be switched, do it now */
         if(shouldSwitchSwadgeMode)
         {
-#if defined(EMU)
-            int force_soft = 1;
-#else
-            int force_soft = 0;
-#endif
-            if( force_soft || 
-                pendingSwadgeModeIdx == 0 ||
-                pendingSwadgeModeIdx == getNumSwadgeModes() )
-            {
-                // Exit the current mode
-                if(NULL != swadgeModes[swadgeModeIdx]->fnExitMode)
-                {
-                    swadgeModes[swadgeModeIdx]->fnExitMode();
-                }
+            int64_t tSwitchStartUs = esp_timer_get_time();
+            swadgeMode * prevMode = swadgeModes[swadgeModeIdx];
+            swadgeMode * nextMode = swadgeModes[pendingSwadgeModeIdx];
 
-                // Switch the mode IDX
-                swadgeModeIdx = pendingSwadgeModeIdx;
-                shouldSwitchSwadgeMode = false;
+            // Exit the current mode, and silence anything it left running
+            if(NULL != prevMode->fnExitMode)
+            {
+                prevMode->fnExitMode();
+            }
+            ESP_LOGI("MODE", "%s used at most %u bytes of mode memory", prevMode->modeName,
+                (unsigned int)modeArena.highWater);
+            arenaReset(&modeArena);
+            modeArena.highWater = 0;
+            buzzer_stop();
+            led_t leds[NUM_LEDS] = {{0}};
+            setLeds(leds, NUM_LEDS);
+
+            // Acquire the next mode's peripherals before releasing the current
+            // mode's, so the ones they share stay up
+            int64_t tPeriphStartUs = esp_timer_get_time();
+            acquireModePeripherals(nextMode);
+            releaseModePeripherals(prevMode);
+            int64_t tPeriphUs = esp_timer_get_time() - tPeriphStartUs;
+
+            // Switch the mode IDX
+            swadgeModeIdx = pendingSwadgeModeIdx;
+            shouldSwitchSwadgeMode = false;
 
-                // Enter the next mode
-                if(NULL != swadgeModes[swadgeModeIdx]->fnEnterMode)
-                {
-                    swadgeModes[swadgeModeIdx]->fnEnterMode(&tftDisp);
-                }
+            // Enter the next mode
+            initFrameScheduler(nextMode->frameRate);
+            resetLoopSources();
+            if(NULL != nextMode->fnEnterMode)
+            {
+                nextMode->fnEnterMode(&tftDisp, &modeArena);
             }
-            else
+            tLastCallUs = esp_timer_get_time();
+
+            // Measure how long the switch took
+            int64_t tSwitchUs = esp_timer_get_time() - tSwitchStartUs;
+            modeSwitchStats.switches++;
+            modeSwitchStats.lastUs = tSwitchUs;
+            modeSwitchStats.lastPeripheralUs = tPeriphUs;
+            if(tSwitchUs > modeSwitchStats.maxUs)
             {
-                // Deep sleep, wake up, and switch to pendingSwadgeModeIdx
-                esp_sleep_enable_timer_wakeup(1);
-                esp_deep_sleep_start();
+                modeSwitchStats.maxUs = tSwitchUs;
             }
+            ESP_LOGI("MODE", "Switched to %s in %lldus (%lldus for peripherals)",
+                nextMode->modeName, (long long)tSwitchUs, (long long)tPeriphUs);
         }
 
-        // Yield to let the rest of the RTOS run
-        taskYIELD();
-        // Note, the RTOS tick rate can be changed in idf.py menuconfig
-        // (100hz by default)
+        // Sleep until something is due, letting the rest of the RTOS run.
+        // Deadlines are rounded to RTOS ticks, so the tick rate is raised to
+        // 1000hz in idf.py menuconfig (100hz by default)
+        waitForLoopEvent();
     }
 
-    if(NULL != swadgeModes[swadgeModeIdx]->fnAudioCallback)
+    if(NULL != swadgeModes[swadgeModeIdx]->fnExitMode)
     {
-        continuous_adc_stop();
-        continuous_adc_deinit();
+        swadgeModes[swadgeModeIdx]->fnExitMode();
     }
+    arenaReset(&modeArena);
 
-    if(NULL != swadgeModes[swadgeModeIdx]->fnExitMode)
+    releaseModePeripherals(swadgeModes[swadgeModeIdx]);
+#if defined(EMU)
+    for(uint8_t i = 0; i < NUM_PERIPHERALS; i++)
     {
-        swadgeModes[swadgeModeIdx]->fnExitMode();
+        releasePeripheral(i);
     }
+#endif
 
 #if defined(EMU)
     esp_timer_deinit();
@@ -529,6 +828,17 @@ uint8_t getNumSwadgeModes(void)
     return ARRAY_SIZE(swadgeModes)-1;
 }
 
+/**
+ * @brief Get how long switching modes has taken, from exiting the old mode to
+ * returning from the new mode's fnEnterMode()
+ *
+ * @param stats Returns the statistics
+ */
+void getModeSwitchStats(modeSwitchStats_t * stats)
+{
+    *stats = modeSwitchStats;
+}
+
 /**
  * Set up variables to synchronously switch the swadge mode in the main loop
  * 
@@ -0,0 +1,106 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "arena.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+/* Allocations are aligned for any type, including int64_t and double */
+#define ARENA_ALIGN 8
+#define ALIGN_UP(x) (((x) + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1))
+
+//==============================================================================
+// Structs
+//==============================================================================
+
+struct arenaChunk
+{
+    arenaChunk_t * next;
+    size_t size; ///< Bytes of data in this chunk
+    size_t used; ///< Bytes of data allocated from this chunk
+    // The data follows the header
+};
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Allocate zeroed memory from an arena. It stays allocated until the
+ * arena is reset. Requests larger than ARENA_CHUNK_SIZE get a chunk to
+ * themselves
+ *
+ * @param arena The arena to allocate from
+ * @param size The number of bytes to allocate
+ * @return A pointer to the memory, or NULL if the heap is exhausted
+ */
+void * arenaAlloc(arena_t * arena, size_t size)
+{
+    size = ALIGN_UP(size);
+
+    // Start a new chunk if this doesn't fit in the current one
+    arenaChunk_t * chunk = arena->chunks;
+    if((NULL == chunk) || (chunk->size - chunk->used < size))
+    {
+        size_t chunkSize = (size > ARENA_CHUNK_SIZE) ? size : ARENA_CHUNK_SIZE;
+        chunk = malloc(ALIGN_UP(sizeof(arenaChunk_t)) + chunkSize);
+        if(NULL == chunk)
+        {
+            ESP_LOGE("ARENA", "Couldn't allocate %u bytes", (unsigned int)size);
+            return NULL;
+        }
+        chunk->size = chunkSize;
+        chunk->used = 0;
+        arena->reserved += chunkSize;
+
+        // A chunk for a single large request is full as soon as it's made, so
+        // keep allocating from the current chunk afterwards
+        if((chunkSize > ARENA_CHUNK_SIZE) && (NULL != arena->chunks))
+        {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        else
+        {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+    }
+
+    uint8_t * mem = (uint8_t *)chunk + ALIGN_UP(sizeof(arenaChunk_t)) + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    if(arena->used > arena->highWater)
+    {
+        arena->highWater = arena->used;
+    }
+
+    memset(mem, 0, size);
+    return mem;
+}
+
+/**
+ * @brief Free everything allocated from an arena at once, returning its chunks
+ * to the heap. The arena can be allocated from again afterwards
+ *
+ * @param arena The arena to reset
+ */
+void arenaReset(arena_t * arena)
+{
+    while(NULL != arena->chunks)
+    {
+        arenaChunk_t * next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    arena->used = 0;
+    arena->reserved = 0;
+}
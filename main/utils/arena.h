@@ -0,0 +1,29 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Memory is taken from the heap in chunks of at least this many bytes */
+#define ARENA_CHUNK_SIZE 4096
+
+typedef struct arenaChunk arenaChunk_t;
+
+/*
+ * A region allocator. Allocations are carved out of large chunks and can't be
+ * freed individually. Instead, everything is freed at once with arenaReset().
+ * Each swadge mode is handed one in fnEnterMode(), which is reset after the
+ * mode's fnExitMode() returns
+ */
+typedef struct
+{
+    arenaChunk_t * chunks; ///< The chunk being allocated from, then older ones
+    size_t used;           ///< Bytes allocated, including alignment
+    size_t reserved;       ///< Bytes taken from the heap
+    size_t highWater;      ///< The most bytes ever allocated at once
+} arena_t;
+
+void * arenaAlloc(arena_t * arena, size_t size);
+void arenaReset(arena_t * arena);
+
+#endif
@@ -0,0 +1,236 @@
+//==============================================================================
+// Includes
+//==============================================================================
+
+#include <stdio.h>
+
+#if defined(EMU)
+#include <time.h>
+#else
+#include "sdkconfig.h"
+#include "hal/cpu_hal.h"
+#endif
+
+#include "asset_cache.h"
+#include "profiler.h"
+
+//==============================================================================
+// Defines
+//==============================================================================
+
+#if defined(EMU)
+    /* The emulator counts nanoseconds from CLOCK_MONOTONIC */
+    #define PROFILE_TICKS_PER_US 1000
+#else
+    /* The Swadge counts CPU cycles */
+    #define PROFILE_TICKS_PER_US CONFIG_ESP32S2_DEFAULT_CPU_FREQ_MHZ
+#endif
+
+#define OVERLAY_FONT "tom_thumb.font"
+
+//==============================================================================
+// Variables
+//==============================================================================
+
+// Every scope which has been begun, in the order they were first begun
+static profScope_t * scopes = NULL;
+static profScope_t ** lastScope = &scopes;
+
+// The whole frame, from one profileEndFrame() to the next
+static profScope_t frameScope = {.name = "frame"};
+static uint32_t windowFrames = 0;
+
+static bool overlayEnabled = false;
+static font_t * overlayFont = NULL;
+
+//==============================================================================
+// Function Prototypes
+//==============================================================================
+
+static uint32_t getProfileTicks(void);
+static void registerScope(profScope_t * scope);
+static void accumulateScope(profScope_t * scope);
+
+//==============================================================================
+// Functions
+//==============================================================================
+
+/**
+ * @brief Read the profiling clock. It wraps, so only differences are meaningful
+ *
+ * @return The current time, in ticks
+ */
+static uint32_t getProfileTicks(void)
+{
+#if defined(EMU)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((ts.tv_sec * 1000000000ull) + ts.tv_nsec);
+#else
+    return cpu_hal_get_cycle_count();
+#endif
+}
+
+/**
+ * @brief Add a scope to the end of the list of scopes
+ *
+ * @param scope The scope to add
+ */
+static void registerScope(profScope_t * scope)
+{
+    scope->registered = true;
+    scope->next = NULL;
+    scope->winMin = UINT32_MAX;
+    *lastScope = scope;
+    lastScope = &scope->next;
+}
+
+/**
+ * @brief Start timing a scope. Scopes register themselves the first time they
+ * are begun
+ *
+ * @param scope The scope to time
+ */
+void profileBegin(profScope_t * scope)
+{
+    if(!scope->registered)
+    {
+        registerScope(scope);
+    }
+    scope->tBegin = getProfileTicks();
+}
+
+/**
+ * @brief Stop timing a scope and add the time to this frame's total
+ *
+ * @param scope The scope to stop timing
+ */
+void profileEnd(profScope_t * scope)
+{
+    scope->frameTicks += getProfileTicks() - scope->tBegin;
+}
+
+/**
+ * @brief Add a scope's total for this frame to the window, and publish the
+ * window if it's complete
+ *
+ * @param scope The scope to update
+ */
+static void accumulateScope(profScope_t * scope)
+{
+    if(scope->frameTicks < scope->winMin)
+    {
+        scope->winMin = scope->frameTicks;
+    }
+    if(scope->frameTicks > scope->winMax)
+    {
+        scope->winMax = scope->frameTicks;
+    }
+    scope->winSum += scope->frameTicks;
+    scope->frameTicks = 0;
+
+    if(PROFILE_WINDOW <= windowFrames)
+    {
+        scope->minUs = scope->winMin / PROFILE_TICKS_PER_US;
+        scope->avgUs = (scope->winSum / PROFILE_WINDOW) / PROFILE_TICKS_PER_US;
+        scope->maxUs = scope->winMax / PROFILE_TICKS_PER_US;
+        scope->winMin = UINT32_MAX;
+        scope->winMax = 0;
+        scope->winSum = 0;
+    }
+}
+
+/**
+ * @brief Mark the end of a frame. Each scope's time this frame is added to the
+ * window, and every PROFILE_WINDOW frames the windows are published. This is
+ * called by the main loop whenever a frame is flushed
+ */
+void profileEndFrame(void)
+{
+    // The frame scope runs from one call to the next
+    if(frameScope.registered)
+    {
+        profileEnd(&frameScope);
+    }
+    else
+    {
+        registerScope(&frameScope);
+    }
+
+    windowFrames++;
+    for(profScope_t * scope = scopes; NULL != scope; scope = scope->next)
+    {
+        accumulateScope(scope);
+    }
+    if(PROFILE_WINDOW <= windowFrames)
+    {
+        windowFrames = 0;
+    }
+
+    frameScope.tBegin = getProfileTicks();
+}
+
+/**
+ * @return The first registered scope. The rest follow through next
+ */
+const profScope_t * getProfileScopes(void)
+{
+    return scopes;
+}
+
+/**
+ * @brief Enable or disable drawing the profiling overlay
+ *
+ * @param enable true to draw the overlay, false to stop
+ */
+void setProfileOverlay(bool enable)
+{
+    overlayEnabled = enable;
+    if(!enable && (NULL != overlayFont))
+    {
+        releaseFont(overlayFont);
+        overlayFont = NULL;
+    }
+}
+
+/**
+ * @return true if the profiling overlay is drawn, false if it isn't
+ */
+bool isProfileOverlayEnabled(void)
+{
+    return overlayEnabled;
+}
+
+/**
+ * @brief Draw the last complete window of every scope in the top left corner of
+ * the display, as min / avg / max microseconds per frame
+ *
+ * @param disp The display to draw to
+ */
+void drawProfileOverlay(display_t * disp)
+{
+    if(!overlayEnabled)
+    {
+        return;
+    }
+    if(NULL == overlayFont)
+    {
+        overlayFont = cacheFont(OVERLAY_FONT);
+        if(NULL == overlayFont)
+        {
+            overlayEnabled = false;
+            return;
+        }
+    }
+
+    int16_t y = 1;
+    for(profScope_t * scope = scopes; NULL != scope; scope = scope->next)
+    {
+        char line[48];
+        snprintf(line, sizeof(line), "%-10.10s %5u %5u %5u", scope->name,
+            (unsigned int)scope->minUs, (unsigned int)scope->avgUs, (unsigned int)scope->maxUs);
+        fillDisplayArea(disp, 0, y - 1, textWidth(overlayFont, line) + 2, y + overlayFont->h + 1, c000);
+        drawText(disp, overlayFont, c555, line, 1, y);
+        y += overlayFont->h + 2;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "display.h"
+
+/* Per-frame times are summarized over this many frames */
+#define PROFILE_WINDOW 60
+
+/*
+ * A named section of code to time. Declare one statically with PROFILE_SCOPE()
+ * and wrap the code in profileBegin() and profileEnd(). Time is accumulated for
+ * every frame, then the min, average, and max of the per-frame totals are
+ * published every PROFILE_WINDOW frames
+ */
+typedef struct profScope
+{
+    const char * name;
+    struct profScope * next; ///< The next registered scope
+    bool registered;
+    uint32_t tBegin;         ///< Ticks when the scope was last begun
+    uint32_t frameTicks;     ///< Ticks spent in this scope this frame
+    // The window so far, in ticks
+    uint32_t winMin;
+    uint32_t winMax;
+    uint64_t winSum;
+    // The last complete window, in microseconds
+    uint32_t minUs;
+    uint32_t avgUs;
+    uint32_t maxUs;
+} profScope_t;
+
+#define PROFILE_SCOPE(var, scopeName) static profScope_t var = {.name = (scopeName)}
+
+void profileBegin(profScope_t * scope);
+void profileEnd(profScope_t * scope);
+void profileEndFrame(void);
+const profScope_t * getProfileScopes(void);
+
+void setProfileOverlay(bool enable);
+bool isProfileOverlayEnabled(void);
+void drawProfileOverlay(display_t * disp);
+
+#endif
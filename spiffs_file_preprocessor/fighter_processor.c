@@ -0,0 +1,413 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fighter_processor.h"
+#include "cJSON.h"
+#include "fileUtils.h"
+
+/* These must match main/modes/fighter/fighter_json.h and mode_fighter.h */
+#define FIGHTER_DATA_MAGIC   "SWFT"
+#define FIGHTER_DATA_VERSION 1
+#define FIGHTER_SF           256
+#define NUM_ATTACKS          9
+#define MAX_ATTACK_FRAMES    32
+#define MAX_SPRITES          255
+
+/* Record sizes, which are the sizes of the firmware's structs */
+#define HEADER_LEN  20
+#define ATTACK_LEN  20
+#define FIGHTER_LEN (48 + (NUM_ATTACKS * ATTACK_LEN))
+#define FRAME_LEN   44
+#define HITBOX_LEN  52
+
+/**
+ * @brief The compiled file, which is filled in place once its layout is known
+ */
+typedef struct
+{
+    uint8_t *buf;
+    const char **spriteNames;
+    uint32_t numSprites;
+    bool failed; ///< Set if anything couldn't be compiled
+} fighterOut_t;
+
+/**
+ * @brief Write a 16 bit integer, little-endian like the firmware reads it
+ *
+ * @param buf The buffer to write to
+ * @param off The offset to write at
+ * @param val The value to write
+ */
+static void setU16(uint8_t *buf, uint32_t off, uint16_t val)
+{
+    buf[off + 0] = LO_BYTE(val);
+    buf[off + 1] = HI_BYTE(val);
+}
+
+/**
+ * @brief Write a 32 bit integer, little-endian like the firmware reads it
+ *
+ * @param buf The buffer to write to
+ * @param off The offset to write at
+ * @param val The value to write
+ */
+static void setU32(uint8_t *buf, uint32_t off, uint32_t val)
+{
+    setU16(buf, off, val & 0xFFFF);
+    setU16(buf, off + 2, val >> 16);
+}
+
+/**
+ * @brief Get an integer field from a JSON object
+ *
+ * @param obj The object
+ * @param key The field's name
+ * @return The field's value, or 0 if it's missing
+ */
+static int32_t getInt(const cJSON *obj, const char *key)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    return cJSON_IsNumber(item) ? item->valueint : 0;
+}
+
+/**
+ * @brief Get a boolean field from a JSON object
+ *
+ * @param obj The object
+ * @param key The field's name
+ * @return The field's value, or false if it's missing
+ */
+static bool getBool(const cJSON *obj, const char *key)
+{
+    return cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(obj, key));
+}
+
+/**
+ * @brief Get the index of a sprite named by a field of a JSON object, adding
+ * the sprite to the table if it's new
+ *
+ * @param out The compiled file, with the sprite table
+ * @param obj The object
+ * @param key The field's name
+ * @return The sprite's index, or 0 if the field is missing or the sprite
+ *         couldn't be added, which marks the file as failed
+ */
+static uint16_t getSprite(fighterOut_t *out, const cJSON *obj, const char *key)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(obj, key);
+    if (!cJSON_IsString(item))
+    {
+        return 0;
+    }
+
+    /* Sprite 0 is no sprite, so the table starts at 1 */
+    for (uint32_t i = 1; i < out->numSprites; i++)
+    {
+        if (0 == strcmp(out->spriteNames[i], item->valuestring))
+        {
+            return i;
+        }
+    }
+    if (out->numSprites >= MAX_SPRITES)
+    {
+        fprintf(stderr, "Too many fighter sprites, at most %d, can't add %s\n", MAX_SPRITES - 1, item->valuestring);
+        out->failed = true;
+        return 0;
+    }
+    const char **names = realloc(out->spriteNames, sizeof(char *) * (out->numSprites + 1));
+    if (NULL == names)
+    {
+        fprintf(stderr, "Failed to allocate fighter sprite names\n");
+        out->failed = true;
+        return 0;
+    }
+    out->spriteNames = names;
+    out->spriteNames[out->numSprites] = item->valuestring;
+    return out->numSprites++;
+}
+
+/**
+ * @brief Read a whole text file into a NUL terminated string
+ *
+ * @param infile The file to read
+ * @param size Returns the size of the file
+ * @return The file's contents, which must be freed, or NULL if it couldn't be
+ *         read
+ */
+static char *readTextFile(const char *infile, long *size)
+{
+    FILE *fp = fopen(infile, "rb");
+    if (NULL == fp)
+    {
+        fprintf(stderr, "Failed to open %s\n", infile);
+        return NULL;
+    }
+
+    long sz = -1;
+    if (0 == fseek(fp, 0L, SEEK_END))
+    {
+        sz = ftell(fp);
+    }
+    char *str = NULL;
+    if ((0 <= sz) && (0 == fseek(fp, 0L, SEEK_SET)))
+    {
+        str = malloc(sz + 1);
+    }
+    if ((NULL == str) || ((0 < sz) && (1 != fread(str, sz, 1, fp))))
+    {
+        fprintf(stderr, "Failed to read %s\n", infile);
+        free(str);
+        fclose(fp);
+        return NULL;
+    }
+    str[sz] = 0;
+    fclose(fp);
+
+    *size = sz;
+    return str;
+}
+
+/**
+ * @brief Compile fighter JSON into the flat binary format the fighter mode
+ * loads with one read, see main/modes/fighter/fighter_json.h. Attack frames and
+ * hitboxes are written exactly as the firmware's structs lay them out, so it
+ * can use them in place
+ *
+ * @param infile The JSON file to compile
+ * @param outdir The directory to write the compiled file to
+ * @return FIGHTERS_COMPILED if the file was compiled, NOT_FIGHTERS if it isn't
+ *         fighter JSON, or FIGHTERS_FAILED if it couldn't be read, compiled,
+ *         or written, after printing why
+ */
+fighterResult_t process_fighters(const char *infile, const char *outdir)
+{
+    /* Read input file */
+    long sz = 0;
+    char *jsonInStr = readTextFile(infile, &sz);
+    if (NULL == jsonInStr)
+    {
+        return FIGHTERS_FAILED;
+    }
+
+    cJSON *json = cJSON_Parse(jsonInStr);
+    free(jsonInStr);
+    if (NULL == json)
+    {
+        fprintf(stderr, "%s isn't valid JSON\n", infile);
+        return FIGHTERS_FAILED;
+    }
+    const cJSON *fighters = cJSON_GetObjectItemCaseSensitive(json, "fighters");
+    if (!cJSON_IsArray(fighters))
+    {
+        cJSON_Delete(json);
+        return NOT_FIGHTERS;
+    }
+
+    /* Count everything and collect the sprites to lay out the file */
+    fighterOut_t out = {.numSprites = 1};
+    out.spriteNames = calloc(1, sizeof(char *));
+    if (NULL == out.spriteNames)
+    {
+        fprintf(stderr, "Failed to allocate fighter sprite names\n");
+        cJSON_Delete(json);
+        return FIGHTERS_FAILED;
+    }
+    uint32_t numFighters = cJSON_GetArraySize(fighters);
+    uint32_t numFrames = 0;
+    uint32_t numHitboxes = 0;
+    const cJSON *fighter;
+    cJSON_ArrayForEach(fighter, fighters)
+    {
+        const cJSON *attacks = cJSON_GetObjectItemCaseSensitive(fighter, "attacks");
+        if (NUM_ATTACKS != cJSON_GetArraySize(attacks))
+        {
+            fprintf(stderr, "%s: a fighter has %d attacks, not %d\n", infile, cJSON_GetArraySize(attacks), NUM_ATTACKS);
+        }
+        const cJSON *attack;
+        cJSON_ArrayForEach(attack, attacks)
+        {
+            const cJSON *frames = cJSON_GetObjectItemCaseSensitive(attack, "attack_frames");
+            if (cJSON_GetArraySize(frames) > MAX_ATTACK_FRAMES)
+            {
+                fprintf(stderr, "%s: an attack has %d frames, more than %d\n", infile, cJSON_GetArraySize(frames), MAX_ATTACK_FRAMES);
+                out.failed = true;
+            }
+            numFrames += cJSON_GetArraySize(frames);
+            const cJSON *frame;
+            cJSON_ArrayForEach(frame, frames)
+            {
+                numHitboxes += cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(frame, "hitboxes"));
+            }
+        }
+    }
+
+    /* Sprites are found while filling in records, so their table goes last */
+    uint32_t fightersOff = HEADER_LEN;
+    uint32_t framesOff = fightersOff + (numFighters * FIGHTER_LEN);
+    uint32_t hitboxesOff = framesOff + (numFrames * FRAME_LEN);
+    uint32_t spriteTableOff = hitboxesOff + (numHitboxes * HITBOX_LEN);
+    out.buf = calloc(1, spriteTableOff + (MAX_SPRITES * 4));
+    if ((NULL == out.buf) || out.failed)
+    {
+        if (NULL == out.buf)
+        {
+            fprintf(stderr, "Failed to allocate %s's compiled data\n", infile);
+        }
+        free(out.buf);
+        free(out.spriteNames);
+        cJSON_Delete(json);
+        return FIGHTERS_FAILED;
+    }
+
+    /* Fill in the fighters, their attacks, frames, and hitboxes */
+    uint32_t ftrOff = fightersOff;
+    uint32_t frmOff = framesOff;
+    uint32_t hbxOff = hitboxesOff;
+    cJSON_ArrayForEach(fighter, fighters)
+    {
+        setU32(out.buf, ftrOff +  0, getInt(fighter, "gravity"));
+        setU32(out.buf, ftrOff +  4, getInt(fighter, "jump_velo"));
+        setU32(out.buf, ftrOff +  8, getInt(fighter, "run_accel"));
+        setU32(out.buf, ftrOff + 12, getInt(fighter, "run_decel"));
+        setU32(out.buf, ftrOff + 16, getInt(fighter, "run_max_velo"));
+        setU32(out.buf, ftrOff + 20, FIGHTER_SF * getInt(fighter, "size_x"));
+        setU32(out.buf, ftrOff + 24, FIGHTER_SF * getInt(fighter, "size_y"));
+        setU16(out.buf, ftrOff + 28, getInt(fighter, "landing_lag"));
+        out.buf[ftrOff + 30] = getInt(fighter, "nJumps");
+        setU16(out.buf, ftrOff + 32, getSprite(&out, fighter, "idle_spr_0"));
+        setU16(out.buf, ftrOff + 34, getSprite(&out, fighter, "idle_spr_1"));
+        setU16(out.buf, ftrOff + 36, getSprite(&out, fighter, "run_spr_0"));
+        setU16(out.buf, ftrOff + 38, getSprite(&out, fighter, "run_spr_1"));
+        setU16(out.buf, ftrOff + 40, getSprite(&out, fighter, "jump_spr"));
+        setU16(out.buf, ftrOff + 42, getSprite(&out, fighter, "duck_spr"));
+        setU16(out.buf, ftrOff + 44, getSprite(&out, fighter, "land_lag_spr"));
+
+        uint32_t atkIdx = 0;
+        const cJSON *attack;
+        cJSON_ArrayForEach(attack, cJSON_GetObjectItemCaseSensitive(fighter, "attacks"))
+        {
+            if (atkIdx >= NUM_ATTACKS)
+            {
+                break;
+            }
+            uint32_t atkOff = ftrOff + 48 + (atkIdx++ * ATTACK_LEN);
+            const cJSON *frames = cJSON_GetObjectItemCaseSensitive(attack, "attack_frames");
+            setU32(out.buf, atkOff +  0, frmOff);
+            setU16(out.buf, atkOff +  4, getInt(attack, "startupLag"));
+            setU16(out.buf, atkOff +  6, getInt(attack, "endLag"));
+            setU16(out.buf, atkOff +  8, getInt(attack, "landing_lag"));
+            setU16(out.buf, atkOff + 10, getInt(attack, "iframe_timer"));
+            setU16(out.buf, atkOff + 12, getSprite(&out, attack, "startupLagSpr"));
+            setU16(out.buf, atkOff + 14, getSprite(&out, attack, "endLagSpr"));
+            out.buf[atkOff + 16] = cJSON_GetArraySize(frames);
+            out.buf[atkOff + 17] = getBool(attack, "onlyFirstHit");
+
+            const cJSON *frame;
+            cJSON_ArrayForEach(frame, frames)
+            {
+                const cJSON *hitboxes = cJSON_GetObjectItemCaseSensitive(frame, "hitboxes");
+                /* The hitbox offset is relative to the frame */
+                setU32(out.buf, frmOff +  0, hbxOff - frmOff);
+                setU32(out.buf, frmOff +  4, getInt(frame, "sprite_offset_x"));
+                setU32(out.buf, frmOff +  8, getInt(frame, "sprite_offset_y"));
+                setU32(out.buf, frmOff + 12, getInt(frame, "hurtbox_offset_x"));
+                setU32(out.buf, frmOff + 16, getInt(frame, "hurtbox_offset_y"));
+                setU32(out.buf, frmOff + 20, getInt(frame, "hurtbox_size_x"));
+                setU32(out.buf, frmOff + 24, getInt(frame, "hurtbox_size_y"));
+                setU32(out.buf, frmOff + 28, getInt(frame, "velo_x"));
+                setU32(out.buf, frmOff + 32, getInt(frame, "velo_y"));
+                setU16(out.buf, frmOff + 36, getInt(frame, "duration"));
+                setU16(out.buf, frmOff + 38, getInt(frame, "iframe_timer"));
+                setU16(out.buf, frmOff + 40, getSprite(&out, frame, "sprite"));
+                out.buf[frmOff + 42] = cJSON_GetArraySize(hitboxes);
+                frmOff += FRAME_LEN;
+
+                const cJSON *hitbox;
+                cJSON_ArrayForEach(hitbox, hitboxes)
+                {
+                    setU32(out.buf, hbxOff +  0, FIGHTER_SF * getInt(hitbox, "relativePos_x"));
+                    setU32(out.buf, hbxOff +  4, FIGHTER_SF * getInt(hitbox, "relativePos_y"));
+                    setU32(out.buf, hbxOff +  8, FIGHTER_SF * getInt(hitbox, "size_x"));
+                    setU32(out.buf, hbxOff + 12, FIGHTER_SF * getInt(hitbox, "size_y"));
+                    setU32(out.buf, hbxOff + 16, getInt(hitbox, "knockback_x"));
+                    setU32(out.buf, hbxOff + 20, getInt(hitbox, "knockback_y"));
+                    setU32(out.buf, hbxOff + 24, getInt(hitbox, "projectileVelo_x"));
+                    setU32(out.buf, hbxOff + 28, getInt(hitbox, "projectileVelo_y"));
+                    setU32(out.buf, hbxOff + 32, getInt(hitbox, "projectileAccel_x"));
+                    setU32(out.buf, hbxOff + 36, getInt(hitbox, "projectileAccel_y"));
+                    setU16(out.buf, hbxOff + 40, getInt(hitbox, "damage"));
+                    setU16(out.buf, hbxOff + 42, getInt(hitbox, "hitstun"));
+                    setU16(out.buf, hbxOff + 44, getInt(hitbox, "projectileDuration"));
+                    setU16(out.buf, hbxOff + 46, getSprite(&out, hitbox, "projectileSprite"));
+                    out.buf[hbxOff + 48] = getBool(hitbox, "isProjectile");
+                    hbxOff += HITBOX_LEN;
+                }
+            }
+        }
+        ftrOff += FIGHTER_LEN;
+    }
+
+    if (out.failed)
+    {
+        fprintf(stderr, "Failed to compile %s\n", infile);
+        free(out.buf);
+        free(out.spriteNames);
+        cJSON_Delete(json);
+        return FIGHTERS_FAILED;
+    }
+
+    /* Now that all the sprites are known, fill in the header and name table */
+    memcpy(out.buf, FIGHTER_DATA_MAGIC, 4);
+    setU16(out.buf, 4, FIGHTER_DATA_VERSION);
+    out.buf[6] = numFighters;
+    out.buf[7] = out.numSprites;
+    setU16(out.buf, 8, FRAME_LEN);
+    setU16(out.buf, 10, HITBOX_LEN);
+    setU32(out.buf, 12, spriteTableOff);
+    setU32(out.buf, 16, fightersOff);
+
+    uint32_t namesOff = spriteTableOff + (out.numSprites * 4);
+    uint32_t nameOff = namesOff;
+    for (uint32_t i = 1; i < out.numSprites; i++)
+    {
+        setU32(out.buf, spriteTableOff + (i * 4), nameOff);
+        nameOff += strlen(out.spriteNames[i]) + 1;
+    }
+
+    /* Write the file, with the names after the records */
+    char outFilePath[128] = {0};
+    strcat(outFilePath, outdir);
+    strcat(outFilePath, "/");
+    strcat(outFilePath, get_filename(infile));
+    char *dotptr = strrchr(outFilePath, '.');
+    strcpy(dotptr, ".ftr");
+
+    FILE *outFile = fopen(outFilePath, "wb");
+    bool written = (NULL != outFile) && (1 == fwrite(out.buf, namesOff, 1, outFile));
+    for (uint32_t i = 1; written && i < out.numSprites; i++)
+    {
+        written = (1 == fwrite(out.spriteNames[i], strlen(out.spriteNames[i]) + 1, 1, outFile));
+    }
+    if ((NULL != outFile) && (0 != fclose(outFile)))
+    {
+        written = false;
+    }
+
+    free(out.buf);
+    free(out.spriteNames);
+    cJSON_Delete(json);
+
+    if (!written)
+    {
+        fprintf(stderr, "Failed to write %s\n", outFilePath);
+        remove(outFilePath);
+        return FIGHTERS_FAILED;
+    }
+
+    printf("%s:\n  Source file size: %ld\n  FTR   file size: %u\n",
+           infile, sz, nameOff);
+    return FIGHTERS_COMPILED;
+}
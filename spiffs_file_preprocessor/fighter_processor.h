@@ -0,0 +1,13 @@
+#ifndef _FIGHTER_PROCESSOR_H_
+#define _FIGHTER_PROCESSOR_H_
+
+typedef enum
+{
+    FIGHTERS_COMPILED, ///< The file was fighter JSON and was compiled
+    NOT_FIGHTERS,      ///< The file isn't fighter JSON, so should be copied
+    FIGHTERS_FAILED,   ///< The file couldn't be read, compiled, or written
+} fighterResult_t;
+
+fighterResult_t process_fighters(const char *infile, const char *outdir);
+
+#endif
\ No newline at end of file
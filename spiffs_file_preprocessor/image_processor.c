@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -20,6 +21,11 @@
 
 #define CLAMP(x,l,u) ((x) < l ? l : ((x) > u ? u : (x)))
 
+/* Set in the width header for run-length encoded WSGs, must match display.h */
+#define WSG_RLE_FLAG 0x8000
+/* The palette index which means 'transparent' */
+#define PAL_TRANSPARENT (6 * 6 * 6)
+
 typedef struct
 {
 	uint8_t r;
@@ -102,6 +108,57 @@ void spreadError(pixel_t **img, int x, int y, int w, int h,
 	}
 }
 
+/**
+ * @brief Run-length encode the transparency in a palette buffer. Each row is
+ * written as pairs of (skip, run) bytes, where skip is a number of transparent
+ * pixels and run is a number of opaque pixels, each pair followed by the run's
+ * pixels. Pairs are written until the row is w pixels long
+ *
+ * @param paletteBuf The palette buffer to encode, w * h pixels
+ * @param w The width of the image
+ * @param h The height of the image
+ * @param rleSize Returns the size of the encoded buffer
+ * @return The encoded buffer, which must be free()'d
+ */
+static unsigned char * rleEncodeTransparency(const unsigned char * paletteBuf,
+	int w, int h, uint32_t * rleSize)
+{
+	/* Every pair covers at least one pixel, so this is never exceeded */
+	unsigned char * rleBuf = malloc(h * 3 * (w + 1));
+	uint32_t rleIdx = 0;
+	for (int y = 0; y < h; y++)
+	{
+		const unsigned char * row = &paletteBuf[y * w];
+		int x = 0;
+		while (x < w)
+		{
+			/* Count transparent pixels */
+			int skip = 0;
+			while ((x + skip < w) && (skip < UINT8_MAX) && (PAL_TRANSPARENT == row[x + skip]))
+			{
+				skip++;
+			}
+			x += skip;
+
+			/* Then count opaque pixels */
+			int run = 0;
+			while ((x + run < w) && (run < UINT8_MAX) && (PAL_TRANSPARENT != row[x + run]))
+			{
+				run++;
+			}
+
+			/* Write the pair, then the opaque pixels */
+			rleBuf[rleIdx++] = skip;
+			rleBuf[rleIdx++] = run;
+			memcpy(&rleBuf[rleIdx], &row[x], run);
+			rleIdx += run;
+			x += run;
+		}
+	}
+	*rleSize = rleIdx;
+	return rleBuf;
+}
+
 /**
  * @brief TODO
  *
@@ -252,7 +309,7 @@ void process_image(const char *infile, const char *outdir)
 				else
 				{
 					/* This invalid value means 'transparent' */
-					paletteBuf[paletteBufIdx++] = 6 * 6 * 6;
+					paletteBuf[paletteBufIdx++] = PAL_TRANSPARENT;
 				}
 			}
 		}
@@ -264,6 +321,22 @@ void process_image(const char *infile, const char *outdir)
 		}
 		free(image8b);
 
+		/* If run-length encoding the transparency is smaller, use that instead */
+		uint32_t rleSize = 0;
+		unsigned char * rleBuf = rleEncodeTransparency(paletteBuf, w, h, &rleSize);
+		uint16_t wHdr = w;
+		if (rleSize < paletteBufSize)
+		{
+			free(paletteBuf);
+			paletteBuf = rleBuf;
+			paletteBufSize = rleSize;
+			wHdr |= WSG_RLE_FLAG;
+		}
+		else
+		{
+			free(rleBuf);
+		}
+
 		/* Compress the palette-ized image */
 		uint32_t outputSize = sizeof(uint8_t) * (4 + paletteBufSize);
 		uint8_t * output = malloc(outputSize);
@@ -277,8 +350,8 @@ void process_image(const char *infile, const char *outdir)
 		/* Encode the dimension header */
 		uint8_t imgDimHdr[] =
 		{
-			HI_BYTE(w),
-			LO_BYTE(w),
+			HI_BYTE(wHdr),
+			LO_BYTE(wHdr),
 			HI_BYTE(h),
 			LO_BYTE(h)
 		};
@@ -0,0 +1,190 @@
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "pack_processor.h"
+#include "fileUtils.h"
+
+/* These must match components/hdw-spiffs/spiffs_pack.h */
+#define PACK_MAGIC       "SWPK"
+#define PACK_VERSION     1
+#define PACK_NAME_LEN    32
+#define PACK_HEADER_LEN  8
+#define PACK_ENTRY_LEN   (PACK_NAME_LEN + 8)
+
+/* Data for each file starts on a four byte boundary */
+#define PACK_ALIGN(x) (((x) + 3) & ~3)
+
+/**
+ * @brief Compare two file names for qsort()
+ *
+ * @param a A pointer to a char *
+ * @param b A pointer to a char *
+ * @return the strcmp() of the two names
+ */
+static int compareNames(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/**
+ * @brief Write a 32 bit integer to a file, big-endian
+ *
+ * @param val The value to write
+ * @param fp The file to write to
+ */
+static void putU32(uint32_t val, FILE *fp)
+{
+	putc(HI_BYTE(val >> 16), fp);
+	putc(LO_BYTE(val >> 16), fp);
+	putc(HI_BYTE(val), fp);
+	putc(LO_BYTE(val), fp);
+}
+
+/**
+ * @brief Pack every file in the output directory into a single asset pack with
+ * a sorted index, so that the firmware can load them all with one read. The
+ * pack is rebuilt every time because any of its files may have changed. It is
+ * written outside the output directory, which becomes the SPIFFS image, so it
+ * isn't flashed twice
+ *
+ * @param outdir The directory of processed files
+ * @param packPath The path of the pack to write
+ * @param maxSize The size of the partition the pack is flashed to, or 0 for
+ *                no limit
+ * @return true if the pack was written and fits, false otherwise
+ */
+bool process_pack(const char *outdir, const char *packPath, uint32_t maxSize)
+{
+	/* Older builds wrote the pack into the output directory. Don't flash it
+	 * to SPIFFS or pack it into itself */
+	const char *packname = strrchr(packPath, '/');
+	packname = (NULL == packname) ? packPath : (packname + 1);
+	char stalePath[512];
+	snprintf(stalePath, sizeof(stalePath), "%s/%s", outdir, packname);
+	remove(stalePath);
+
+	DIR *dir = opendir(outdir);
+	if (NULL == dir)
+	{
+		fprintf(stderr, "Failed to open %s\n", outdir);
+		return false;
+	}
+
+	/* Collect the names of all regular files */
+	char **names = NULL;
+	uint32_t numNames = 0;
+	struct dirent *ent;
+	while (NULL != (ent = readdir(dir)))
+	{
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", outdir, ent->d_name);
+		struct stat st;
+		if ((0 != stat(path, &st)) || !S_ISREG(st.st_mode))
+		{
+			continue;
+		}
+		if (strlen(ent->d_name) >= PACK_NAME_LEN)
+		{
+			fprintf(stderr, "%s is too long a name to pack, skipping\n", ent->d_name);
+			continue;
+		}
+		names = realloc(names, sizeof(char *) * (numNames + 1));
+		names[numNames] = malloc(strlen(ent->d_name) + 1);
+		strcpy(names[numNames++], ent->d_name);
+	}
+	closedir(dir);
+
+	/* The firmware binary searches the index, so it must be sorted */
+	qsort(names, numNames, sizeof(char *), compareNames);
+
+	FILE *packFile = fopen(packPath, "wb");
+	if (NULL == packFile)
+	{
+		fprintf(stderr, "Failed to write %s\n", packPath);
+		for (uint32_t i = 0; i < numNames; i++)
+		{
+			free(names[i]);
+		}
+		free(names);
+		return false;
+	}
+
+	/* Write the header */
+	fwrite(PACK_MAGIC, 4, 1, packFile);
+	putc(HI_BYTE(PACK_VERSION), packFile);
+	putc(LO_BYTE(PACK_VERSION), packFile);
+	putc(HI_BYTE(numNames), packFile);
+	putc(LO_BYTE(numNames), packFile);
+
+	/* Write the index, the data follows it */
+	uint32_t offset = PACK_ALIGN(PACK_HEADER_LEN + (numNames * PACK_ENTRY_LEN));
+	for (uint32_t i = 0; i < numNames; i++)
+	{
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", outdir, names[i]);
+		uint32_t len = getFileSize(path);
+
+		char nameField[PACK_NAME_LEN] = {0};
+		strncpy(nameField, names[i], PACK_NAME_LEN - 1);
+		fwrite(nameField, PACK_NAME_LEN, 1, packFile);
+		putU32(offset, packFile);
+		putU32(len, packFile);
+
+		offset = PACK_ALIGN(offset + len);
+	}
+
+	/* Write the data for each file */
+	bool ok = true;
+	for (uint32_t i = 0; i < numNames; i++)
+	{
+		/* Pad to the alignment */
+		while (ftell(packFile) != PACK_ALIGN(ftell(packFile)))
+		{
+			putc(0, packFile);
+		}
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", outdir, names[i]);
+		FILE *fp = fopen(path, "rb");
+		if (NULL == fp)
+		{
+			fprintf(stderr, "Failed to read %s\n", path);
+			ok = false;
+		}
+		else
+		{
+			int c;
+			while (EOF != (c = getc(fp)))
+			{
+				putc(c, packFile);
+			}
+			fclose(fp);
+		}
+		free(names[i]);
+	}
+	free(names);
+	fclose(packFile);
+
+	/* Print results */
+	long packSize = getFileSize(packPath);
+	printf("%s:\n  Files packed: %d\n  Pack  file size: %ld\n",
+		   packPath, numNames, packSize);
+
+	/* A pack which doesn't fit its partition would be cut off when flashed */
+	if ((0 != maxSize) && (packSize > (long)maxSize))
+	{
+		fprintf(stderr, "%s is %ld bytes, larger than its %u byte partition\n",
+				packPath, packSize, maxSize);
+		ok = false;
+	}
+
+	if (!ok)
+	{
+		remove(packPath);
+	}
+	return ok;
+}
@@ -0,0 +1,9 @@
+#ifndef _PACK_PROCESSOR_H_
+#define _PACK_PROCESSOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool process_pack(const char *outdir, const char *packPath, uint32_t maxSize);
+
+#endif
@@ -13,6 +13,8 @@
 #include "image_processor.h"
 #include "font_processor.h"
 #include "json_processor.h"
+#include "fighter_processor.h"
+#include "pack_processor.h"
 
 const char * outDirName = NULL;
 
@@ -22,7 +24,7 @@ const char * outDirName = NULL;
  */
 void print_usage(void)
 {
-    printf("Usage:\n  spiffs_file_preprocessor\n    -i INPUT_DIRECTORY\n    -o OUTPUT_DIRECTORY\n");
+    printf("Usage:\n  spiffs_file_preprocessor\n    -i INPUT_DIRECTORY\n    -o OUTPUT_DIRECTORY\n    [-p PACK_FILE]\n    [-m MAX_PACK_SIZE]\n");
 }
 
 /**
@@ -65,7 +67,17 @@ static int processFile(const char * fpath, const struct stat * st __attribute__(
             }
             else if(endsWith(fpath, ".json"))
             {
-                process_json(fpath, outDirName);
+                // Fighter data is compiled, anything else is copied. Fighter
+                // data which can't be compiled fails the build
+                fighterResult_t result = process_fighters(fpath, outDirName);
+                if(FIGHTERS_FAILED == result)
+                {
+                    return -1;
+                }
+                else if(NOT_FIGHTERS == result)
+                {
+                    process_json(fpath, outDirName);
+                }
             }
             break;
         }
@@ -95,9 +107,11 @@ int main(int argc, char ** argv)
 {
     int c;
     const char * inDirName = NULL;
+    const char * packName = NULL;
+    uint32_t maxPackSize = 0;
 
     opterr = 0;
-    while ((c = getopt (argc, argv, "i:o:")) != -1)
+    while ((c = getopt (argc, argv, "i:o:p:m:")) != -1)
     {
         switch (c)
         {
@@ -109,6 +123,14 @@ int main(int argc, char ** argv)
                 outDirName = optarg;
                 break;
             }
+        case 'p': {
+                packName = optarg;
+                break;
+            }
+        case 'm': {
+                maxPackSize = strtoul(optarg, NULL, 0);
+                break;
+            }
         default: {
                 fprintf(stderr, "Invalid argument %c\n", c);
                 print_usage();
@@ -139,5 +161,14 @@ int main(int argc, char ** argv)
         return -1;
     }
 
+    // Pack all the processed files together, if asked to
+    if(NULL != packName)
+    {
+        if(!process_pack(outDirName, packName, maxPackSize))
+        {
+            return -1;
+        }
+    }
+
     return 0;
 }